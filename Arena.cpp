@@ -0,0 +1,167 @@
+// Bump pointer arena allocator
+#include "stdafx.h"
+#include "Arena.h"
+
+void *Arena::alloc(size_t size, size_t align)
+{
+    m_stats.allocs++;
+    m_stats.bytes += size;
+
+    while (TRUE)
+    {
+        if (m_block < m_blocks.size())
+        {
+            BLOCK &b = m_blocks[m_block];
+            size_t start = ((m_used + (align - 1)) & ~(align - 1));
+            if ((start + size) <= b.size)
+            {
+                m_used = (start + size);
+                size_t used = inUse();
+                if (used > m_stats.peak)
+                    m_stats.peak = used;
+                return(m_last = (b.base + start));
+            }
+
+            // Doesn't fit, move on to the next block
+            if ((m_block + 1) < m_blocks.size())
+            {
+                m_block++;
+                m_used = 0;
+                continue;
+            }
+        }
+
+        // Need a new block, big enough for oversized requests too
+        size_t blockSize = (std::max)(m_blockSize, (size + align));
+        BYTE *base = (BYTE *) malloc(blockSize);
+        if (!base)
+            throw std::bad_alloc();
+        m_stats.heapBlocks++;
+        m_blocks.push_back({ base, blockSize });
+        m_block = (m_blocks.size() - 1);
+        m_used = 0;
+    };
+}
+
+LPSTR Arena::strdup(LPCSTR str)
+{
+    size_t size = (strlen(str) + 1);
+    LPSTR copy = alloc<char>(size);
+    memcpy(copy, str, size);
+    return copy;
+}
+
+void *Arena::grow(void *ptr, size_t oldSize, size_t newSize)
+{
+    // Most recent allocation with room left in its block? Just extend it.
+    if (ptr && (ptr == m_last) && (m_block < m_blocks.size()))
+    {
+        BLOCK &b = m_blocks[m_block];
+        size_t start = (size_t) ((BYTE *) ptr - b.base);
+        if ((start + newSize) <= b.size)
+        {
+            m_stats.bytes += (newSize - oldSize);
+            m_used = (start + newSize);
+            size_t used = inUse();
+            if (used > m_stats.peak)
+                m_stats.peak = used;
+            return ptr;
+        }
+    }
+
+    void *newPtr = alloc(newSize, 1);
+    if (ptr)
+        memcpy(newPtr, ptr, oldSize);
+    return newPtr;
+}
+
+void Arena::rewind(const MARK &mark)
+{
+    m_block = mark.block;
+    m_used = mark.used;
+    m_last = NULL;
+    m_stats.rewinds++;
+}
+
+void Arena::release()
+{
+    for (BLOCK &b: m_blocks)
+        free(b.base);
+    m_blocks.clear();
+    m_block = m_used = 0;
+    m_last = NULL;
+}
+
+// Bytes in use up to the current position
+size_t Arena::inUse() const
+{
+    size_t used = m_used;
+    for (size_t i = 0; i < m_block; i++)
+        used += m_blocks[i].size;
+    return used;
+}
+
+
+// ================================================================================================
+
+ArenaString::ArenaString(Arena &arena, size_t capacity) : m_arena(arena), m_length(0), m_capacity(capacity)
+{
+    m_str = m_arena.alloc<char>(m_capacity);
+    m_str[0] = 0;
+}
+
+// Make room for a string of the given length plus terminator
+void ArenaString::reserve(size_t length)
+{
+    if ((length + 1) > m_capacity)
+    {
+        size_t capacity = (std::max)((m_capacity * 2), (length + 1));
+        m_str = (LPSTR) m_arena.grow(m_str, (m_length + 1), capacity);
+        m_capacity = capacity;
+    }
+}
+
+void ArenaString::append(LPCSTR str)
+{
+    size_t len = strlen(str);
+    reserve(m_length + len);
+    memcpy(m_str + m_length, str, (len + 1));
+    m_length += len;
+}
+
+void ArenaString::vappendf(LPCSTR format, va_list va)
+{
+    va_list va2;
+    va_copy(va2, va);
+    int len = vsnprintf((m_str + m_length), (m_capacity - m_length), format, va);
+    if ((len >= 0) && ((m_length + len) >= m_capacity))
+    {
+        // Didn't fit, grow and print it again
+        reserve(m_length + len);
+        len = vsnprintf((m_str + m_length), (m_capacity - m_length), format, va2);
+    }
+    va_end(va2);
+
+    if (len > 0)
+        m_length += len;
+    else
+        m_str[m_length] = 0;
+}
+
+void ArenaString::appendf(LPCSTR format, ...)
+{
+    va_list va;
+    va_start(va, format);
+    vappendf(format, va);
+    va_end(va);
+}
+
+void ArenaString::format(LPCSTR format, ...)
+{
+    m_length = 0;
+    m_str[0] = 0;
+    va_list va;
+    va_start(va, format);
+    vappendf(format, va);
+    va_end(va);
+}
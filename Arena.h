@@ -0,0 +1,95 @@
+// Bump pointer arena allocator
+#pragma once
+
+// Serves short lived temporaries from a few large heap blocks.
+// Allocation is a pointer bump, and everything allocated since a mark is released at once by rewinding to it.
+// Blocks are kept for reuse until release(). Not for types that need their destructors run.
+class Arena
+{
+public:
+    Arena(size_t blockSize = (64 * 1024)) : m_blockSize(blockSize), m_block(0), m_used(0), m_last(NULL) { clearStats(); }
+    ~Arena() { release(); }
+
+    void *alloc(size_t size, size_t align = sizeof(void *));
+    template <class T> T *alloc(size_t count = 1) { return (T *) alloc((sizeof(T) * count), alignof(T)); }
+    LPSTR strdup(LPCSTR str);
+
+    // Grow an allocation, in place when it's the most recent one
+    void *grow(void *ptr, size_t oldSize, size_t newSize);
+
+    // Allocation position to rewind to
+    struct MARK
+    {
+        size_t block, used;
+    };
+    MARK mark() const { return { m_block, m_used }; }
+    void rewind(const MARK &mark);
+
+    // Rewind to the start, keeping the blocks for reuse
+    void reset() { rewind({ 0, 0 }); }
+
+    // Free the blocks
+    void release();
+
+    // Instrumentation counters
+    struct STATS
+    {
+        UINT64 allocs;      // Allocations served
+        UINT64 bytes;       // Total bytes served
+        UINT32 heapBlocks;  // Heap allocations made for blocks
+        UINT32 rewinds;     // Scope resets
+        size_t peak;        // Peak bytes in use
+    };
+    const STATS &stats() const { return m_stats; }
+    void clearStats() { ZeroMemory(&m_stats, sizeof(m_stats)); }
+
+    // Rewinds to the mark taken on construction when it goes out of scope
+    class Scope
+    {
+    public:
+        Scope(Arena &arena) : m_arena(arena), m_mark(arena.mark()) {}
+        ~Scope() { m_arena.rewind(m_mark); }
+
+    private:
+        Arena &m_arena;
+        MARK m_mark;
+    };
+
+private:
+    struct BLOCK
+    {
+        BYTE *base;
+        size_t size;
+    };
+
+    size_t inUse() const;
+
+    std::vector<BLOCK> m_blocks;
+    size_t m_blockSize;
+    size_t m_block, m_used;  // Current block and bytes used in it
+    void *m_last;            // Most recent allocation
+    STATS m_stats;
+};
+
+// Growable string in an arena, for building text with out heap churn
+class ArenaString
+{
+public:
+    ArenaString(Arena &arena, size_t capacity = 256);
+
+    void append(LPCSTR str);
+    void appendf(LPCSTR format, ...);
+    void format(LPCSTR format, ...);
+    void truncate(size_t length) { if (length < m_length) m_str[m_length = length] = 0; }
+
+    LPCSTR c_str() const { return m_str; }
+    size_t length() const { return m_length; }
+
+private:
+    void vappendf(LPCSTR format, va_list va);
+    void reserve(size_t length);
+
+    Arena &m_arena;
+    LPSTR m_str;
+    size_t m_length, m_capacity;
+};
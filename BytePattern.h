@@ -0,0 +1,120 @@
+// Compiled wildcard byte patterns
+#pragma once
+
+// Byte pattern compiled from IDA style hex text, I.E. "68 ?? ?? ?? ?? 68", at compile time when constexpr.
+// "??" (or a single '?') is a wildcard byte.
+struct BYTEPATTERN
+{
+    static const UINT32 MAX_SIZE = 48;
+
+    BYTE bytes[MAX_SIZE];
+    BYTE mask[MAX_SIZE];    // 0xFF for a literal byte, 0 for a wildcard
+    UINT32 size;
+    UINT32 anchor;          // Index of the first literal byte, what the matcher buckets on
+
+    template <size_t N> constexpr BYTEPATTERN(const char (&text)[N]) : bytes(), mask(), size(0), anchor(MAX_SIZE)
+    {
+        for (size_t i = 0; (i < (N - 1)) && text[i];)
+        {
+            if (text[i] == ' ')
+            {
+                i++;
+                continue;
+            }
+            if (size >= MAX_SIZE)
+                throw "BYTEPATTERN: pattern too long";
+
+            if (text[i] == '?')
+            {
+                bytes[size] = 0;
+                mask[size] = 0;
+                i += ((text[i + 1] == '?') ? 2 : 1);
+            }
+            else
+            {
+                bytes[size] = (BYTE) ((hexNibble(text[i]) << 4) | hexNibble(text[i + 1]));
+                mask[size] = 0xFF;
+                if (anchor == MAX_SIZE)
+                    anchor = size;
+                i += 2;
+            }
+            size++;
+        }
+        if (anchor == MAX_SIZE)
+            throw "BYTEPATTERN: pattern needs at least one literal byte";
+    }
+
+    // Return TRUE if the pattern matches at 'data', which has at least 'size' bytes
+    BOOL matches(const BYTE *data) const
+    {
+        for (UINT32 i = 0; i < size; i++)
+        {
+            if ((data[i] & mask[i]) != bytes[i])
+                return FALSE;
+        }
+        return TRUE;
+    }
+
+private:
+    static constexpr BYTE hexNibble(char c)
+    {
+        return (((c >= '0') && (c <= '9')) ? (BYTE) (c - '0') :
+                ((c >= 'A') && (c <= 'F')) ? (BYTE) ((c - 'A') + 10) :
+                ((c >= 'a') && (c <= 'f')) ? (BYTE) ((c - 'a') + 10) :
+                throw "BYTEPATTERN: bad hex digit");
+    }
+};
+
+// Runs a set of patterns over a byte buffer in a single pass.
+// Patterns are bucketed by the value of their first literal byte, so each buffer position only gets compared with
+// the few patterns that could start there regardless of how many patterns are in the set.
+class PatternMatcher
+{
+public:
+    // Add a pattern, its index is the order added
+    void add(const BYTEPATTERN &pattern)
+    {
+        UINT16 index = (UINT16) m_patterns.size();
+        m_patterns.push_back(&pattern);
+        m_buckets[pattern.bytes[pattern.anchor]].push_back(index);
+        if (pattern.size > m_maxSize)
+            m_maxSize = pattern.size;
+    }
+
+    void clear()
+    {
+        m_patterns.clear();
+        for (auto &bucket: m_buckets)
+            bucket.clear();
+        m_maxSize = 0;
+    }
+
+    BOOL empty() const { return m_patterns.empty(); }
+    UINT32 maxSize() const { return m_maxSize; }
+
+    // Call 'f(patternIndex, offset)' for each match in the buffer, in ascending anchor position order.
+    // Return FALSE from 'f' to stop the scan.
+    template <class F> void scan(const BYTE *data, size_t size, F f) const
+    {
+        for (size_t pos = 0; pos < size; pos++)
+        {
+            for (UINT16 index: m_buckets[data[pos]])
+            {
+                const BYTEPATTERN &pattern = *m_patterns[index];
+                if (pos < pattern.anchor)
+                    continue;
+                size_t start = (pos - pattern.anchor);
+                if (((start + pattern.size) <= size) && pattern.matches(data + start))
+                {
+                    if (!f((UINT32) index, start))
+                        return;
+                }
+            }
+        }
+    }
+
+private:
+    std::vector<const BYTEPATTERN *> m_patterns;
+    std::vector<UINT16> m_buckets[256];
+    UINT32 m_maxSize = 0;
+};
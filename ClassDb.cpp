@@ -0,0 +1,574 @@
+// Cross IDB class database
+// No IDA or plugin headers, this file is also built into the standalone tool
+#include "ClassDb.h"
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <unordered_map>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static const char CDB_MAGIC[8] = { "CLASSDB" };
+static const uint32_t DEFAULT_BUCKETS = (1 << 18);      // 2MB index, short chains into the millions of names
+static const uint32_t MAX_BUCKETS = (1 << 28);
+static const uint64_t GROW_GRANULARITY = (1 << 20);
+static const uint32_t FIRST_POSTINGS = 4;                // Hits in a name's first chunk
+static const uint32_t MAX_POSTINGS = 4096;               // Chunk size doubling stops here
+
+static inline uint64_t align8(uint64_t size) { return ((size + 7) & ~7ull); }
+
+// FNV-1a
+uint32_t ClassDb::hash(const char *str, size_t length)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+        h = ((h ^ (uint8_t) str[i]) * 16777619u);
+    return h;
+}
+
+// Close with the reason, plus the OS error for a failed system call
+bool ClassDb::fail(const char *reason, bool system)
+{
+    m_error = reason;
+    if (system)
+    {
+        m_error += " (";
+        #ifdef _WIN32
+        m_error += std::to_string(GetLastError());
+        #else
+        m_error += strerror(errno);
+        #endif
+        m_error += ')';
+    }
+    close();
+    return false;
+}
+
+
+bool ClassDb::open(const char *path, bool write)
+{
+    close();
+    m_error.clear();
+    m_write = write;
+    uint64_t size = 0;
+
+    #ifdef _WIN32
+    // Write access is only shared with readers, that keeps it to one writer
+    HANDLE file = CreateFileA(path, (write ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ), (write ? FILE_SHARE_READ : (FILE_SHARE_READ | FILE_SHARE_WRITE)),
+                              NULL, (write ? OPEN_ALWAYS : OPEN_EXISTING), FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return fail(write ? "Can't open for writing, it may be in use" : "Can't open");
+    m_file = file;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize))
+        return fail("Can't get size");
+    size = (uint64_t) fileSize.QuadPart;
+    #else
+    if ((m_file = ::open(path, (write ? (O_RDWR | O_CREAT) : O_RDONLY), 0644)) < 0)
+        return fail("Can't open");
+    if (write && (flock(m_file, (LOCK_EX | LOCK_NB)) != 0))
+        return fail("In use by another writer");
+    struct stat st;
+    if (fstat(m_file, &st) != 0)
+        return fail("Can't get size");
+    size = (uint64_t) st.st_size;
+    #endif
+
+    if (size == 0)
+    {
+        if (!write)
+            return fail("Empty file", false);
+        return create();
+    }
+
+    if (!map(size) || !validate())
+        return false;
+
+    // Finish linking a batch an earlier writer was interrupted in
+    if (write && header()->pending)
+    {
+        linkBatch(header()->pending);
+        headerw()->pending = 0;
+        flush();
+    }
+    return true;
+}
+
+void ClassDb::close()
+{
+    if (m_base && m_write)
+        flush();
+    unmap();
+
+    #ifdef _WIN32
+    if (m_file)
+    {
+        CloseHandle((HANDLE) m_file);
+        m_file = NULL;
+    }
+    #else
+    if (m_file >= 0)
+    {
+        ::close(m_file);    // Also releases the flock()
+        m_file = -1;
+    }
+    #endif
+    m_dataStart = ~0ull;
+}
+
+
+bool ClassDb::map(uint64_t size)
+{
+    #ifdef _WIN32
+    HANDLE mapping = CreateFileMappingA((HANDLE) m_file, NULL, (m_write ? PAGE_READWRITE : PAGE_READONLY), (DWORD) (size >> 32), (DWORD) size, NULL);
+    if (!mapping)
+        return fail("Can't create mapping");
+    m_mapping = mapping;
+    m_base = (uint8_t *) MapViewOfFile(mapping, (m_write ? FILE_MAP_WRITE : FILE_MAP_READ), 0, 0, (SIZE_T) size);
+    #else
+    void *base = mmap(NULL, (size_t) size, (PROT_READ | (m_write ? PROT_WRITE : 0)), MAP_SHARED, m_file, 0);
+    m_base = ((base != MAP_FAILED) ? (uint8_t *) base : NULL);
+    #endif
+    if (!m_base)
+        return fail("Can't map");
+    m_size = size;
+    return true;
+}
+
+void ClassDb::unmap()
+{
+    #ifdef _WIN32
+    if (m_base)
+        UnmapViewOfFile(m_base);
+    if (m_mapping)
+    {
+        CloseHandle((HANDLE) m_mapping);
+        m_mapping = NULL;
+    }
+    #else
+    if (m_base)
+        munmap(m_base, (size_t) m_size);
+    #endif
+    m_base = NULL;
+    m_size = 0;
+}
+
+// Extend the file to at least size bytes and remap it
+bool ClassDb::grow(uint64_t size)
+{
+    size = std::max(size, (m_size + (m_size / 2)));
+    size = (((size + (GROW_GRANULARITY - 1)) / GROW_GRANULARITY) * GROW_GRANULARITY);
+    unmap();
+
+    #ifdef _WIN32
+    LARGE_INTEGER position;
+    position.QuadPart = (LONGLONG) size;
+    if (!SetFilePointerEx((HANDLE) m_file, position, NULL, FILE_BEGIN) || !SetEndOfFile((HANDLE) m_file))
+        return fail("Can't extend");
+    #else
+    if (ftruncate(m_file, (off_t) size) != 0)
+        return fail("Can't extend");
+    #endif
+
+    return map(size);
+}
+
+void ClassDb::flush()
+{
+    #ifdef _WIN32
+    FlushViewOfFile(m_base, 0);
+    FlushFileBuffers((HANDLE) m_file);
+    #else
+    msync(m_base, (size_t) m_size, MS_SYNC);
+    #endif
+}
+
+
+bool ClassDb::create()
+{
+    uint64_t dataStart = (sizeof(CDB_HEADER) + ((uint64_t) DEFAULT_BUCKETS * sizeof(uint64_t)));
+    if (!grow(dataStart + GROW_GRANULARITY))
+        return false;
+
+    // New file space reads as zero, the buckets included
+    CDB_HEADER *hdr = headerw();
+    memcpy(hdr->magic, CDB_MAGIC, sizeof(hdr->magic));
+    hdr->version = CDB_VERSION;
+    hdr->bucketCount = DEFAULT_BUCKETS;
+    hdr->used = dataStart;
+    m_dataStart = dataStart;
+    flush();
+    return true;
+}
+
+bool ClassDb::validate()
+{
+    const CDB_HEADER *hdr = header();
+    if ((m_size < sizeof(CDB_HEADER)) || (memcmp(hdr->magic, CDB_MAGIC, sizeof(CDB_MAGIC)) != 0))
+        return fail("Not a class database", false);
+    if (hdr->version != CDB_VERSION)
+        return fail("Unsupported class database version", false);
+
+    uint64_t dataStart = (sizeof(CDB_HEADER) + ((uint64_t) hdr->bucketCount * sizeof(uint64_t)));
+    if (!hdr->bucketCount || (hdr->bucketCount > MAX_BUCKETS) || (hdr->bucketCount & (hdr->bucketCount - 1)) ||
+        (hdr->used < dataStart) || (hdr->used > m_size) || (hdr->used & 7))
+        return fail("Damaged class database header", false);
+    m_dataStart = dataStart;
+    return true;
+}
+
+
+// Directory chunk of an entry, and the index of the chunk's first entry
+static uint32_t getDirectoryChunk(uint32_t index, uint32_t *first = NULL)
+{
+    uint64_t n = ((index / CDB_DIRECTORY_FIRST) + 1);
+    uint32_t chunk = 0;
+    while (n >>= 1)
+        chunk++;
+    if (first)
+        *first = (uint32_t) (CDB_DIRECTORY_FIRST * ((1ull << chunk) - 1));
+    return chunk;
+}
+
+const CDB_BINARY *ClassDb::directoryEntry(uint32_t index) const
+{
+    uint32_t first;
+    uint32_t chunk = getDirectoryChunk(index, &first);
+    if (chunk >= CDB_DIRECTORY_CHUNKS)
+        return NULL;
+    uint64_t offset = header()->directory[chunk];
+    if (!inside<CDB_BINARY>(offset, ((uint64_t) CDB_DIRECTORY_FIRST << chunk)))
+        return NULL;
+    return((const CDB_BINARY *) (m_base + offset) + (index - first));
+}
+
+const CDB_BINARY *ClassDb::binary(uint32_t index) const
+{
+    if (!m_base || (index >= header()->binaryCount))
+        return NULL;
+    return directoryEntry(index);
+}
+
+const CDB_RECORD *ClassDb::records(const CDB_BINARY *bin) const
+{
+    if (!inside<CDB_RECORD>(bin->records, bin->recordCount))
+        return NULL;
+    return (const CDB_RECORD *) (m_base + bin->records);
+}
+
+const CDB_NAME *ClassDb::name(uint64_t offset) const
+{
+    if (!inside<CDB_NAME>(offset))
+        return NULL;
+    const CDB_NAME *entry = (const CDB_NAME *) (m_base + offset);
+    if (!inside<char>((offset + sizeof(CDB_NAME)), ((uint64_t) entry->length + 1)))
+        return NULL;
+    return entry;
+}
+
+const char *ClassDb::nameText(const CDB_NAME *entry) const
+{
+    const char *text = (const char *) (entry + 1);
+    return(text[entry->length] ? "" : text);
+}
+
+const char *ClassDb::fileName(const CDB_BINARY *bin) const
+{
+    if (!inside<CDB_STRING>(bin->fileName))
+        return "";
+    const CDB_STRING *str = (const CDB_STRING *) (m_base + bin->fileName);
+    uint64_t offset = (bin->fileName + sizeof(CDB_STRING));
+    if (((offset + str->length) >= m_size) || m_base[offset + str->length])
+        return "";
+    return (const char *) (m_base + offset);
+}
+
+const CDB_POSTINGS *ClassDb::postings(uint64_t offset) const
+{
+    if (!inside<CDB_POSTINGS>(offset))
+        return NULL;
+    const CDB_POSTINGS *chunk = (const CDB_POSTINGS *) (m_base + offset);
+    if ((chunk->count > chunk->capacity) || !inside<CDB_HIT>((offset + sizeof(CDB_POSTINGS)), chunk->capacity))
+        return NULL;
+    return chunk;
+}
+
+// The last linked hit of a name, NULL if none
+const CDB_HIT *ClassDb::newestHit(const CDB_NAME *entry) const
+{
+    const CDB_POSTINGS *chunk = postings(entry->postings);
+    if (chunk && !chunk->count && (chunk->prev < entry->postings))
+        chunk = postings(chunk->prev);
+    if (!chunk || !chunk->count)
+        return NULL;
+    return((const CDB_HIT *) (chunk + 1) + (chunk->count - 1));
+}
+
+
+const CDB_NAME *ClassDb::findName(const char *str, size_t length) const
+{
+    if (!m_base)
+        return NULL;
+    uint32_t h = hash(str, length);
+    uint64_t offset = buckets()[h & (header()->bucketCount - 1)];
+    while (const CDB_NAME *entry = name(offset))
+    {
+        if ((entry->hash == h) && (entry->length == length) && (memcmp((entry + 1), str, length) == 0))
+            return entry;
+        if (entry->next >= offset)
+            break;
+        offset = entry->next;
+    }
+    return NULL;
+}
+
+const CDB_NAME *ClassDb::findName(const char *str) const
+{
+    return findName(str, strlen(str));
+}
+
+
+bool ClassDb::addBinary(const char *fileName, const uint8_t sha256[32], uint64_t imageBase, const std::vector<ENTRY> &entries)
+{
+    if (!m_base || !m_write)
+    {
+        m_error = "Not open for writing";
+        return false;
+    }
+
+    uint64_t batch = header()->used;
+    uint32_t index = (uint32_t) header()->binaryCount;
+    uint32_t recordCount = (uint32_t) entries.size();
+    uint64_t recordStart = (batch + sizeof(CDB_BATCH));
+    uint64_t stringStart = (recordStart + ((uint64_t) recordCount * sizeof(CDB_RECORD)));
+    size_t fileNameLength = strlen(fileName);
+    uint64_t end = align8(stringStart + sizeof(CDB_STRING) + fileNameLength + 1);
+
+    // Directory space
+    uint32_t chunk = getDirectoryChunk(index);
+    if (chunk >= CDB_DIRECTORY_CHUNKS)
+    {
+        m_error = "Binary directory full";
+        return false;
+    }
+    uint64_t newDirectoryChunk = 0;
+    if (!header()->directory[chunk])
+    {
+        newDirectoryChunk = end;
+        end += (((uint64_t) CDB_DIRECTORY_FIRST << chunk) * sizeof(CDB_BINARY));
+    }
+
+    // Place the names not in the index, and the hits in their names' newest chunk while it has room
+    struct PLAN
+    {
+        uint64_t name;          // CDB_NAME, existing or new
+        uint64_t chunk;         // Newest CDB_POSTINGS
+        uint32_t capacity, free;
+        uint32_t needed;
+        uint64_t newChunk;
+        uint32_t newCapacity;
+    };
+    std::unordered_map<std::string, PLAN> plans;
+    plans.reserve(entries.size());
+    std::vector<PLAN *> recordPlans(entries.size());
+    std::vector<const std::string *> newNames;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const std::string &str = entries[i].name;
+        auto it = plans.emplace(str, PLAN());
+        PLAN &plan = it.first->second;
+        if (it.second)
+        {
+            if (const CDB_NAME *entry = findName(str.c_str(), str.length()))
+            {
+                plan.name = offsetOf(entry);
+                if (const CDB_POSTINGS *old = postings(entry->postings))
+                {
+                    plan.chunk = entry->postings;
+                    plan.capacity = old->capacity;
+                    plan.free = (old->capacity - old->count);
+                }
+            }
+            else
+            {
+                plan.name = end;
+                end = align8(end + sizeof(CDB_NAME) + str.length() + 1);
+                newNames.push_back(&it.first->first);
+            }
+        }
+        plan.needed++;
+        recordPlans[i] = &plan;
+    }
+    for (auto &it: plans)
+    {
+        PLAN &plan = it.second;
+        if (plan.needed > plan.free)
+        {
+            plan.newCapacity = std::max((plan.needed - plan.free), std::min(MAX_POSTINGS, std::max(FIRST_POSTINGS, (plan.capacity * 2))));
+            plan.newChunk = end;
+            end += (sizeof(CDB_POSTINGS) + ((uint64_t) plan.newCapacity * sizeof(CDB_HIT)));
+        }
+    }
+
+    if ((end > m_size) && !grow(end))
+        return false;
+
+    // Past "used" may hold an unlinked batch from an interrupted write
+    memset((m_base + batch), 0, (size_t) (end - batch));
+
+    CDB_BATCH *batchInfo = getw<CDB_BATCH>(batch);
+    batchInfo->directoryChunk = newDirectoryChunk;
+    batchInfo->index = index;
+    CDB_BINARY &bin = batchInfo->binary;
+    bin.records = recordStart;
+    bin.fileName = stringStart;
+    bin.imageBase = imageBase;
+    bin.timeStamp = (uint64_t) time(NULL);
+    memcpy(bin.sha256, sha256, sizeof(bin.sha256));
+    bin.recordCount = recordCount;
+
+    CDB_RECORD *rec = getw<CDB_RECORD>(recordStart);
+    for (size_t i = 0; i < entries.size(); i++, rec++)
+    {
+        PLAN &plan = *recordPlans[i];
+        rec->name = plan.name;
+        if (plan.free)
+        {
+            rec->postings = plan.chunk;
+            plan.free--;
+        }
+        else
+            rec->postings = plan.newChunk;
+        rec->vft = entries[i].vft;
+        rec->methods = entries[i].methods;
+        rec->flags = entries[i].flags;
+    }
+
+    CDB_STRING *str = getw<CDB_STRING>(stringStart);
+    str->length = (uint32_t) fileNameLength;
+    memcpy((str + 1), fileName, fileNameLength);
+
+    for (const std::string *text: newNames)
+    {
+        CDB_NAME *entry = getw<CDB_NAME>(plans[*text].name);
+        entry->hash = hash(text->c_str(), text->length());
+        entry->length = (uint32_t) text->length();
+        memcpy((entry + 1), text->c_str(), text->length());
+    }
+
+    for (auto &it: plans)
+    {
+        if (it.second.newChunk)
+        {
+            CDB_POSTINGS *chunk = getw<CDB_POSTINGS>(it.second.newChunk);
+            chunk->prev = it.second.chunk;
+            chunk->capacity = it.second.newCapacity;
+        }
+    }
+    flush();
+
+    // Commit the batch, then link it
+    headerw()->used = end;
+    headerw()->pending = batch;
+    flush();
+    linkBatch(batch);
+    headerw()->pending = 0;
+    flush();
+    return true;
+}
+
+// Link a committed batch into the directory, index, and hit chunks. Each step checks if it's already done so a batch
+// that was partly linked when interrupted can be linked again.
+void ClassDb::linkBatch(uint64_t batch)
+{
+    if (!inside<CDB_BATCH>(batch))
+        return;
+    const CDB_BATCH *batchInfo = getw<CDB_BATCH>(batch);
+    const CDB_BINARY &bin = batchInfo->binary;
+    uint32_t index = batchInfo->index;
+    if (!inside<CDB_RECORD>(bin.records, bin.recordCount) || (index > headerw()->binaryCount))
+        return;
+
+    // Directory entry, published by the count at the end
+    uint32_t chunk = getDirectoryChunk(index);
+    if (chunk >= CDB_DIRECTORY_CHUNKS)
+        return;
+    if (batchInfo->directoryChunk && !headerw()->directory[chunk])
+        headerw()->directory[chunk] = batchInfo->directoryChunk;
+    CDB_BINARY *entry = (CDB_BINARY *) directoryEntry(index);
+    if (!entry)
+        return;
+    if (index == headerw()->binaryCount)
+        *entry = bin;
+
+    // Mark earlier binaries of the same input file replaced
+    for (uint32_t i = 0; i < index; i++)
+    {
+        CDB_BINARY *older = (CDB_BINARY *) directoryEntry(i);
+        if (older && (memcmp(older->sha256, bin.sha256, sizeof(bin.sha256)) == 0))
+            older->flags |= CDB_BF_REPLACED;
+    }
+
+    CDB_RECORD *rec = getw<CDB_RECORD>(bin.records);
+    for (uint32_t i = 0; i < bin.recordCount; i++, rec++)
+    {
+        if (!name(rec->name) || !postings(rec->postings))
+            continue;
+        CDB_NAME *entry = getw<CDB_NAME>(rec->name);
+
+        // Index a name new in this batch
+        if ((rec->name > batch) && (findName(nameText(entry), entry->length) != entry))
+        {
+            uint64_t &bucket = buckets()[entry->hash & (headerw()->bucketCount - 1)];
+            entry->next = bucket;
+            bucket = rec->name;
+        }
+
+        // Start a new chunk once the one before it is full
+        CDB_POSTINGS *target = getw<CDB_POSTINGS>(rec->postings);
+        if ((rec->postings != entry->postings) && (target->prev == entry->postings))
+            entry->postings = rec->postings;
+
+        // Add the hit, then publish it by the count
+        const CDB_HIT *newest = newestHit(entry);
+        if ((!newest || (newest->binary < index) || ((newest->binary == index) && (newest->record < i))) && (target->count < target->capacity))
+        {
+            CDB_HIT &hit = ((CDB_HIT *) (target + 1))[target->count];
+            hit.binary = index;
+            hit.record = i;
+            hit.vft = rec->vft;
+            hit.methods = rec->methods;
+            hit.flags = rec->flags;
+            target->count++;
+        }
+    }
+
+    if (headerw()->binaryCount == index)
+    {
+        // A new name's first record is the one that started its chunk
+        uint64_t newNames = 0;
+        rec = getw<CDB_RECORD>(bin.records);
+        for (uint32_t i = 0; i < bin.recordCount; i++, rec++)
+        {
+            if ((rec->name > batch) && postings(rec->postings) && (getw<CDB_POSTINGS>(rec->postings)->prev == 0) &&
+                (((const CDB_HIT *) (getw<CDB_POSTINGS>(rec->postings) + 1))->record == i))
+                newNames++;
+        }
+
+        CDB_HEADER *hdr = headerw();
+        hdr->nameCount += newNames;
+        hdr->recordCount += bin.recordCount;
+        hdr->binaryCount = (index + 1);
+    }
+}
@@ -0,0 +1,226 @@
+// Cross IDB class database
+#pragma once
+
+// An append only, memory mapped file of the classes found in many binaries, for "which builds have class X and where"
+// lookups. Shared by the plugin and the standalone "tools/cidb" command line tool so it uses no IDA or Windows types.
+//
+// File layout, all offsets are from the file start and every record is 8 byte aligned:
+//   CDB_HEADER
+//   uint64_t buckets[bucketCount]  Hash index of class name to the CDB_NAME chain
+//   Batches, one per added binary:
+//     CDB_BATCH                    The binary's directory entry and where it goes
+//     CDB_RECORD[recordCount]      The binary's record table
+//     CDB_STRING                   Input file name
+//     CDB_NAME...                  String pool entries for class names not seen before
+//     CDB_POSTINGS...              New hit chunks for the names, and a new binary directory chunk if needed
+//
+// A class name lookup only touches the index, the name, its hit chunks, and the binary directory. The hits are kept
+// close together in per name chunks that double in size, so a name found in thousands of binaries takes a handful of
+// chunks, rather than a record in every batch. The binary directory is chunked the same way.
+//
+// A batch is written past the committed end, then "used" is advanced over it, then it's linked in. Linking fills free
+// hit slots of existing chunks in place and publishes them by count. The header "pending" field holds the batch while
+// it's being linked so an interrupted link is finished the next time the file is opened for writing.
+// A reader maps the file as it was when opened, so it's reopened per query to see later batches.
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+const uint32_t CDB_DIRECTORY_CHUNKS = 24;
+
+#pragma pack(push, 1)
+struct CDB_HEADER
+{
+    char magic[8];          // "CLASSDB"
+    uint32_t version;
+    uint32_t bucketCount;   // Power of 2
+    uint64_t used;          // Committed bytes, the file may be longer
+    uint64_t binaryCount;   // Directory entries
+    uint64_t nameCount;
+    uint64_t recordCount;
+    uint64_t pending;       // CDB_BATCH being linked, else 0
+    uint64_t directory[CDB_DIRECTORY_CHUNKS];  // CDB_BINARY chunks, chunk N holds (CDB_DIRECTORY_FIRST << N) entries
+};
+
+// Class name string pool entry, chained per hash bucket
+struct CDB_NAME
+{
+    uint64_t next;          // Next CDB_NAME in the bucket
+    uint64_t postings;      // Newest CDB_POSTINGS chunk
+    uint32_t hash;
+    uint32_t length;
+    // char text[length + 1]
+};
+
+// A vftable of a class in a binary
+struct CDB_HIT
+{
+    uint32_t binary;        // Directory index
+    uint32_t record;        // The binary's record table index
+    uint64_t vft;
+    uint32_t methods;
+    uint32_t flags;         // Result table row flags
+};
+
+// Chunk of a name's hits, oldest first
+struct CDB_POSTINGS
+{
+    uint64_t prev;          // Older chunk
+    uint32_t capacity;
+    uint32_t count;         // Filled in place as batches are linked
+    // CDB_HIT hits[capacity]
+};
+
+struct CDB_STRING
+{
+    uint32_t length;
+    // char text[length + 1]
+};
+
+// Binary directory entry
+struct CDB_BINARY
+{
+    uint64_t records;       // CDB_RECORD table
+    uint64_t fileName;      // CDB_STRING
+    uint64_t imageBase;
+    uint64_t timeStamp;     // Time added, seconds since 1970
+    uint8_t  sha256[32];    // Input file hash
+    uint32_t recordCount;
+    uint32_t flags;         // CDB_BF_*
+};
+
+struct CDB_BATCH
+{
+    uint64_t directoryChunk;    // New directory chunk for the entry, else 0
+    uint32_t index;             // Directory index
+    uint32_t reserved;
+    CDB_BINARY binary;
+};
+
+struct CDB_RECORD
+{
+    uint64_t name;          // CDB_NAME
+    uint64_t postings;      // CDB_POSTINGS chunk the hit goes in
+    uint64_t vft;
+    uint32_t methods;
+    uint32_t flags;
+};
+#pragma pack(pop)
+
+static_assert((sizeof(CDB_HEADER) % 8) == 0);
+static_assert((sizeof(CDB_NAME) % 8) == 0);
+static_assert((sizeof(CDB_HIT) % 8) == 0);
+static_assert((sizeof(CDB_POSTINGS) % 8) == 0);
+static_assert((sizeof(CDB_BINARY) % 8) == 0);
+static_assert((sizeof(CDB_BATCH) % 8) == 0);
+static_assert((sizeof(CDB_RECORD) % 8) == 0);
+
+const uint32_t CDB_VERSION = 1;
+const uint32_t CDB_DIRECTORY_FIRST = 64;
+const uint32_t CDB_BF_REPLACED = (1 << 0);  // A later binary has the same input file hash
+
+
+class ClassDb
+{
+public:
+    // A class to add for a binary
+    struct ENTRY
+    {
+        std::string name;
+        uint64_t vft;
+        uint32_t methods;
+        uint32_t flags;
+    };
+
+    ClassDb() {}
+    ~ClassDb() { close(); }
+    ClassDb(const ClassDb &) = delete;
+    ClassDb &operator=(const ClassDb &) = delete;
+
+    // Open for reading, or for appending where the file is created if it doesn't exist and locked against other
+    // writers. Returns false on failure with the reason in error().
+    bool open(const char *path, bool write);
+    void close();
+    const std::string &error() const { return m_error; }
+
+    // Append a binary's classes. A binary with the same hash added before is marked CDB_BF_REPLACED.
+    bool addBinary(const char *fileName, const uint8_t sha256[32], uint64_t imageBase, const std::vector<ENTRY> &entries);
+
+    // Class name lookup, NULL if not found
+    const CDB_NAME *findName(const char *name, size_t length) const;
+    const CDB_NAME *findName(const char *name) const;
+
+    // Bounds checked access, NULL or "" if invalid
+    const CDB_HEADER *header() const { return (const CDB_HEADER *) m_base; }
+    const CDB_BINARY *binary(uint32_t index) const;
+    const CDB_RECORD *records(const CDB_BINARY *binary) const;
+    const CDB_NAME *name(uint64_t offset) const;
+    const char *nameText(const CDB_NAME *name) const;
+    const char *fileName(const CDB_BINARY *binary) const;
+
+    // Call f(const CDB_HIT *, const CDB_BINARY *) for each hit of a name, newest first, skipping replaced binaries.
+    // Chunks only link to older, lower offsets, which also stops a damaged file from looping.
+    template <class F> void forEachHit(const CDB_NAME *name, F f) const
+    {
+        for (uint64_t offset = name->postings; const CDB_POSTINGS *chunk = postings(offset); offset = chunk->prev)
+        {
+            const CDB_HIT *hits = (const CDB_HIT *) (chunk + 1);
+            for (uint32_t i = chunk->count; i > 0; i--)
+            {
+                const CDB_BINARY *bin = binary(hits[i - 1].binary);
+                if (bin && !(bin->flags & CDB_BF_REPLACED))
+                    f(&hits[i - 1], bin);
+            }
+            if (chunk->prev >= offset)
+                break;
+        }
+    }
+
+    // Call f(uint32_t index, const CDB_BINARY *) for each binary, newest first, including replaced ones
+    template <class F> void forEachBinary(F f) const
+    {
+        for (uint64_t i = header()->binaryCount; i > 0; i--)
+        {
+            if (const CDB_BINARY *bin = binary((uint32_t) (i - 1)))
+                f((uint32_t) (i - 1), bin);
+        }
+    }
+
+    static uint32_t hash(const char *str, size_t length);
+
+private:
+    template <class T> bool inside(uint64_t offset, uint64_t count = 1) const
+    {
+        return(!(offset & 7) && (offset >= m_dataStart) && (offset <= m_size) && (count <= ((m_size - offset) / sizeof(T))));
+    }
+    const CDB_POSTINGS *postings(uint64_t offset) const;
+    const CDB_BINARY *directoryEntry(uint32_t index) const;
+    template <class T> T *getw(uint64_t offset) { return (T *) (m_base + offset); }
+    uint64_t offsetOf(const void *p) const { return (uint64_t) ((const uint8_t *) p - m_base); }
+    uint64_t *buckets() { return (uint64_t *) (m_base + sizeof(CDB_HEADER)); }
+    const uint64_t *buckets() const { return (const uint64_t *) (m_base + sizeof(CDB_HEADER)); }
+    CDB_HEADER *headerw() { return (CDB_HEADER *) m_base; }
+    const CDB_HIT *newestHit(const CDB_NAME *name) const;
+
+    bool create();
+    bool validate();
+    bool map(uint64_t size);
+    void unmap();
+    bool grow(uint64_t size);
+    void flush();
+    void linkBatch(uint64_t batch);
+    bool fail(const char *reason, bool system = true);
+
+    #ifdef _WIN32
+    void *m_file = NULL;
+    void *m_mapping = NULL;
+    #else
+    int m_file = -1;
+    #endif
+    uint8_t *m_base = NULL;
+    uint64_t m_size = 0;            // Mapped bytes
+    uint64_t m_dataStart = ~0ull;   // First batch offset
+    bool m_write = false;
+    std::string m_error;
+};
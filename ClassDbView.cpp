@@ -0,0 +1,215 @@
+// Cross IDB class database plugin side
+#include "stdafx.h"
+#include "Main.h"
+#include "RTTI.h"
+#include "ResultTable.h"
+#include "ClassDb.h"
+#include "ClassDbView.h"
+
+static const char CLASSDB_DIR[] = { "ClassInformer" };
+static const char CLASSDB_FILE[] = { "classes.cidb" };
+static const char CLASSDB_ACTION_NAME[] = { "ClassInformer:ClassDb" };
+static const char CLASSDB_MENU_PATH[] = { "Search/" };
+
+// Makes the directory if needed
+static void getClassDbPath(__out qstring &path)
+{
+    char buffer[QMAXPATH];
+    qmakepath(buffer, sizeof(buffer), get_user_idadir(), CLASSDB_DIR, NULL);
+    qmkdir(buffer, 0777);
+    qmakepath(buffer, sizeof(buffer), get_user_idadir(), CLASSDB_DIR, CLASSDB_FILE, NULL);
+    path = buffer;
+}
+
+void addResultToClassDb()
+{
+    BYTE hash[32];
+    useStoredTable();
+    if (g_resultTable.empty() || !retrieve_input_file_sha256(hash))
+        return;
+
+    TIMESTAMP startTime = GetTimeStamp();
+    std::vector<ClassDb::ENTRY> entries;
+    UINT32 rows = g_resultTable.size();
+    entries.reserve(rows);
+    for (UINT32 row = 0; row < rows; row++)
+        entries.push_back({ g_resultTable.type(row), (UINT64) g_resultTable.vft(row), g_resultTable.methods(row), (UINT32) (g_resultTable.flags(row) & ~TBL_DIRTY) });
+
+    char fileName[QMAXPATH];
+    if (get_root_filename(fileName, sizeof(fileName)) <= 0)
+        strcpy(fileName, "?");
+
+    qstring path;
+    getClassDbPath(path);
+    ClassDb db;
+    if (db.open(path.c_str(), true) && db.addBinary(fileName, hash, (UINT64) get_imagebase(), entries))
+    {
+        char buffer[32];
+        msg("Added %s vftables to the class database \"%s\" in %s.\n", NumberCommaString(rows, buffer), path.c_str(), TimeString(GetTimeStamp() - startTime));
+    }
+    else
+        msg("** Failed to add to the class database \"%s\": %s **\n", path.c_str(), db.error().c_str());
+}
+
+
+// Class database query chooser, a row per vftable of the class in each binary
+static const UINT32 DBCOLUMNCOUNT = 6;
+static const int DBWIDTHS[DBCOLUMNCOUNT] = { 24, 16, (16 | CHCOL_HEX), (4 | CHCOL_DEC), 3, 19 };
+static const char *const DBHEADER[DBCOLUMNCOUNT] =
+{
+	"Binary",
+	"SHA-256",
+	"Vftable",
+	"Methods",
+	"Flags",
+	"Added"
+};
+
+class classdb_chooser : public chooser_t
+{
+public:
+	struct ROW
+	{
+		qstring fileName;
+		BYTE sha256[32];
+		UINT64 imageBase;
+		UINT64 vft;
+		UINT32 methods;
+		UINT32 flags;
+		UINT64 timeStamp;
+	};
+
+	classdb_chooser(LPCSTR className) : chooser_t(0, DBCOLUMNCOUNT, DBWIDTHS, DBHEADER)
+	{
+		titleText.sprnt("[Class Informer] Binaries with \"%s\"", className);
+		title = titleText.c_str();
+	}
+
+	qvector<ROW> rows;
+
+	virtual size_t get_count() const { return rows.size(); }
+
+	virtual void get_row(qstrvec_t *cols_, int *icon_, chooser_item_attrs_t *attributes, size_t n) const
+	{
+		try
+		{
+			if (n < rows.size())
+			{
+				const ROW &row = rows[n];
+				qstrvec_t &cols = *cols_;
+				cols[0] = row.fileName;
+				cols[1].qclear();
+				for (UINT32 i = 0; i < 8; i++)
+					cols[1].cat_sprnt("%02X", row.sha256[i]);
+				cols[2].sprnt("%llX", row.vft);
+				cols[3].sprnt("%u", row.methods);
+				cols[4].qclear();
+				if (row.flags & RTTI::CHD_MULTINH)   cols[4] += 'M';
+				if (row.flags & RTTI::CHD_VIRTINH)   cols[4] += 'V';
+				if (row.flags & RTTI::CHD_AMBIGUOUS) cols[4] += 'A';
+				char buffer[32];
+				qstrftime64(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", make_qtime64((time_t) row.timeStamp));
+				cols[5] = buffer;
+				*icon_ = 191;
+
+				if (!(row.flags & RTTI::IS_TOP_LEVEL))
+					attributes->color = NOT_PARENT_COLOR;
+			}
+		}
+		CATCH()
+	}
+
+	// Jump to the vftable if the row is this IDB's binary
+	virtual cbret_t enter(size_t n)
+	{
+		if (n < rows.size())
+		{
+			BYTE hash[32];
+			const ROW &row = rows[n];
+			if (retrieve_input_file_sha256(hash) && (memcmp(hash, row.sha256, sizeof(hash)) == 0))
+				jumpto((ea_t) ((row.vft - row.imageBase) + (UINT64) get_imagebase()));
+			else
+				msg("Class Informer: That vftable is in \"%s\", not this IDB's binary.\n", row.fileName.c_str());
+		}
+		return cbret_t();
+	}
+
+private:
+	qstring titleText;
+};
+
+
+static void queryClassDb()
+{
+    try
+    {
+        static qstring className;
+        if (!ask_str(&className, HIST_IDENT, "Class Informer class database\nClass name:"))
+            return;
+        className.trim2();
+        if (className.empty())
+            return;
+
+        qstring path;
+        getClassDbPath(path);
+        ClassDb db;
+        if (!qfileexist(path.c_str()) || !db.open(path.c_str(), false))
+        {
+            msg("Class Informer: No class database to query \"%s\": %s\n", path.c_str(), (db.error().empty() ? "Run the plugin with \"Add result to class database\" set first." : db.error().c_str()));
+            return;
+        }
+
+        // Copy the hits out so the file can be closed
+        TIMESTAMP startTime = GetTimeStamp();
+        classdb_chooser *chooser = new classdb_chooser(className.c_str());
+        if (const CDB_NAME *name = db.findName(className.c_str(), className.length()))
+        {
+            db.forEachHit(name, [&](const CDB_HIT *hit, const CDB_BINARY *bin)
+            {
+                classdb_chooser::ROW &row = chooser->rows.push_back();
+                row.fileName = db.fileName(bin);
+                memcpy(row.sha256, bin->sha256, sizeof(row.sha256));
+                row.imageBase = bin->imageBase;
+                row.vft = hit->vft;
+                row.methods = hit->methods;
+                row.flags = hit->flags;
+                row.timeStamp = bin->timeStamp;
+            });
+        }
+        db.close();
+
+        char buffer[32];
+        msg("Class Informer: \"%s\" has %s vftables in the class database, found in %s.\n", className.c_str(), NumberCommaString((UINT32) chooser->rows.size(), buffer), TimeString(GetTimeStamp() - startTime));
+        if (chooser->rows.empty())
+            delete chooser;
+        else
+            chooser->choose();
+    }
+    CATCH()
+}
+
+
+struct classdb_handler_t: public action_handler_t
+{
+    virtual int idaapi activate(action_activation_ctx_t *ctx)
+    {
+        queryClassDb();
+        return 0;
+    }
+
+    virtual action_state_t idaapi update(action_update_ctx_t *ctx) { return AST_ENABLE_ALWAYS; }
+};
+static classdb_handler_t classDbHandler;
+
+void registerClassDbAction()
+{
+    const action_desc_t desc = ACTION_DESC_LITERAL(CLASSDB_ACTION_NAME, "Class Informer class database...", &classDbHandler, NULL, "Find the binaries in the Class Informer class database with a class", -1);
+    if (register_action(desc))
+        attach_action_to_menu(CLASSDB_MENU_PATH, CLASSDB_ACTION_NAME, SETMENU_APP);
+}
+
+void unregisterClassDbAction()
+{
+    detach_action_from_menu(CLASSDB_MENU_PATH, CLASSDB_ACTION_NAME);
+    unregister_action(CLASSDB_ACTION_NAME);
+}
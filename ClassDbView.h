@@ -0,0 +1,9 @@
+// Cross IDB class database plugin side
+#pragma once
+
+// Add the stored vftable list to the user class database, "<user IDA dir>/ClassInformer/classes.cidb"
+void addResultToClassDb();
+
+// "Search" menu action to list the binaries in the class database with a class
+void registerClassDbAction();
+void unregisterClassDbAction();
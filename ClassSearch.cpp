@@ -0,0 +1,191 @@
+// Class name search index
+#include "stdafx.h"
+#include "ResultTable.h"
+#include "ClassSearch.h"
+#include <algorithm>
+#include <numeric>
+
+ClassSearch g_classSearch;
+
+static inline UINT32 trigram(LPCSTR str)
+{
+    return(((UINT32) (BYTE) tolower((BYTE) str[0]) << 16) | ((UINT32) (BYTE) tolower((BYTE) str[1]) << 8) | (UINT32) (BYTE) tolower((BYTE) str[2]));
+}
+
+// Return TRUE if 'str' contains the lower case 'needle' of 'len', ignoring case
+static BOOL containsNoCase(LPCSTR str, LPCSTR needle, size_t len)
+{
+    for (; *str; str++)
+    {
+        size_t i = 0;
+        while ((i < len) && str[i] && ((char) tolower((BYTE) str[i]) == needle[i]))
+            i++;
+        if (i == len)
+            return TRUE;
+    }
+    return(len == 0);
+}
+
+
+void ClassSearch::clear()
+{
+    m_trigrams.clear();
+    m_typeRows.clear();
+    m_baseRows.clear();
+    m_poolCount = m_rowCount = 0;
+    m_editGeneration = (UINT32) -1;
+}
+
+void ClassSearch::update()
+{
+    // Anything but appended rows can drop or renumber rows and pool strings
+    if (m_editGeneration != g_resultTable.editGeneration())
+    {
+        clear();
+        m_editGeneration = g_resultTable.editGeneration();
+    }
+
+    UINT32 poolCount = g_resultTable.poolCount();
+    m_typeRows.resize(poolCount);
+    m_baseRows.resize(poolCount);
+    for (; m_poolCount < poolCount; m_poolCount++)
+        addName(m_poolCount);
+
+    UINT32 rows = g_resultTable.size();
+    for (; m_rowCount < rows; m_rowCount++)
+        addRow(m_rowCount);
+}
+
+// Pool IDs go in ascending order, keeping each posting list sorted
+void ClassSearch::addName(UINT32 id)
+{
+    LPCSTR name = g_resultTable.poolText(id);
+    size_t len = strlen(name);
+    if (len < 3)
+        return;
+
+    std::vector<UINT32> keys;
+    keys.reserve(len - 2);
+    for (size_t i = 0; i < (len - 2); i++)
+        keys.push_back(trigram(name + i));
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    for (UINT32 key: keys)
+        m_trigrams[key].push_back(id);
+}
+
+void ClassSearch::addRow(UINT32 row)
+{
+    UINT32 type = g_resultTable.typeId(row);
+    m_typeRows[type].push_back(row);
+
+    // The hierarchy names other than the class's own head entry, which can have a "struct " prefix the type lacks
+    LPCSTR typeName = g_resultTable.poolText(type);
+    UINT32 count = g_resultTable.hierarchyCount(row);
+    for (UINT32 i = 0; i < count; i++)
+    {
+        UINT32 id = g_resultTable.hierarchyId(row, i);
+        if (id == type)
+            continue;
+        if (i == 0)
+        {
+            LPCSTR head = g_resultTable.poolText(id);
+            if ((strncmp(head, "struct ", SIZESTR("struct ")) == 0) && (strcmp((head + SIZESTR("struct ")), typeName) == 0))
+                continue;
+        }
+
+        // A virtual base can be listed more than once
+        std::vector<UINT32> &rows = m_baseRows[id];
+        if (rows.empty() || (rows.back() != row))
+            rows.push_back(row);
+    }
+}
+
+// Pool IDs of the names containing 'text'
+void ClassSearch::findNames(LPCSTR text, __out std::vector<UINT32> &ids) const
+{
+    ids.clear();
+    std::string needle(text);
+    for (char &c: needle)
+        c = (char) tolower((BYTE) c);
+    size_t len = needle.length();
+
+    // Too short for a trigram, check every unique name
+    if (len < 3)
+    {
+        for (UINT32 id = 0; id < m_poolCount; id++)
+        {
+            if (containsNoCase(g_resultTable.poolText(id), needle.c_str(), len))
+                ids.push_back(id);
+        }
+        return;
+    }
+
+    // Intersect the needle's trigram posting lists, smallest first
+    std::vector<const std::vector<UINT32> *> lists;
+    for (size_t i = 0; i < (len - 2); i++)
+    {
+        auto it = m_trigrams.find(trigram(needle.c_str() + i));
+        if (it == m_trigrams.end())
+            return;
+        lists.push_back(&it->second);
+    }
+    std::sort(lists.begin(), lists.end(), [](const std::vector<UINT32> *a, const std::vector<UINT32> *b) { return(a->size() < b->size()); });
+    lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+
+    ids = *lists[0];
+    std::vector<UINT32> next;
+    for (size_t i = 1; (i < lists.size()) && !ids.empty(); i++)
+    {
+        next.clear();
+        std::set_intersection(ids.begin(), ids.end(), lists[i]->begin(), lists[i]->end(), std::back_inserter(next));
+        ids.swap(next);
+    }
+
+    // The trigrams match in any order, check the names left for the whole text
+    ids.erase(std::remove_if(ids.begin(), ids.end(), [&needle, len](UINT32 id) { return !containsNoCase(g_resultTable.poolText(id), needle.c_str(), len); }), ids.end());
+}
+
+// Union of the posting lists of 'ids'
+void ClassSearch::getRows(const std::vector<std::vector<UINT32>> &postings, const std::vector<UINT32> &ids, __out std::vector<UINT32> &rows)
+{
+    rows.clear();
+    for (UINT32 id: ids)
+        rows.insert(rows.end(), postings[id].begin(), postings[id].end());
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+}
+
+void ClassSearch::find(LPCSTR name, LPCSTR base, __out std::vector<UINT32> &rows)
+{
+    update();
+    rows.clear();
+    BOOL byName = (name && name[0]);
+    BOOL byBase = (base && base[0]);
+    if (!byName && !byBase)
+    {
+        rows.resize(m_rowCount);
+        std::iota(rows.begin(), rows.end(), 0);
+        return;
+    }
+
+    std::vector<UINT32> ids, nameRows, baseRows;
+    if (byName)
+    {
+        findNames(name, ids);
+        getRows(m_typeRows, ids, nameRows);
+        if (!byBase || nameRows.empty())
+        {
+            rows.swap(nameRows);
+            return;
+        }
+    }
+
+    findNames(base, ids);
+    getRows(m_baseRows, ids, baseRows);
+    if (byName)
+        std::set_intersection(nameRows.begin(), nameRows.end(), baseRows.begin(), baseRows.end(), std::back_inserter(rows));
+    else
+        rows.swap(baseRows);
+}
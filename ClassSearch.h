@@ -0,0 +1,34 @@
+// Class name search index
+#pragma once
+#include <unordered_map>
+
+// Trigram inverted index over the result table's demangled class and base class names for substring search.
+// The names are indexed once per unique string pool entry, and each entry keeps the rows that use it as their type
+// or as a base class, so a search intersects a few posting lists and then only checks the names they leave.
+// Kept current with the table incrementally while rows are only appended, as by a running scan.
+class ClassSearch
+{
+public:
+    // Rows, in table order, whose class name contains 'name' and that derive from a class with a name containing
+    // 'base'. Case insensitive, an empty or NULL string doesn't filter.
+    void find(LPCSTR name, LPCSTR base, __out std::vector<UINT32> &rows);
+
+    // Index the table rows and names added since the last call, or all of them after other table changes
+    void update();
+    void clear();
+
+private:
+    void addName(UINT32 id);
+    void addRow(UINT32 row);
+    void findNames(LPCSTR text, __out std::vector<UINT32> &ids) const;
+    static void getRows(const std::vector<std::vector<UINT32>> &postings, const std::vector<UINT32> &ids, __out std::vector<UINT32> &rows);
+
+    std::unordered_map<UINT32, std::vector<UINT32>> m_trigrams; // Lower case trigram to ascending pool IDs
+    std::vector<std::vector<UINT32>> m_typeRows;                // Ascending rows per type pool ID
+    std::vector<std::vector<UINT32>> m_baseRows;                // Ascending rows per base class pool ID
+    UINT32 m_poolCount = 0;                                     // Pool strings and rows indexed
+    UINT32 m_rowCount = 0;
+    UINT32 m_editGeneration = (UINT32) -1;
+};
+
+extern ClassSearch g_classSearch;
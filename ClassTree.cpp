@@ -0,0 +1,582 @@
+// Class hierarchy tree dock
+#include "stdafx.h"
+#include "Main.h"
+#include "RTTI.h"
+#include "ResultTable.h"
+#include "ClassTree.h"
+#include <algorithm>
+#include <memory>
+
+#include <QtCore/QAbstractItemModel>
+#include <QtCore/QTimer>
+#include <QtWidgets/QTreeView>
+#include <QtWidgets/QVBoxLayout>
+
+static const char CLASSTREE_TITLE[] = { "Class Informer class tree" };
+static const char CLASSTREE_ACTION_NAME[] = { "ClassInformer:ClassTree" };
+static const char CLASSTREE_MENU_PATH[] = { "View/Open subviews/" };
+
+static const int COLUMN_COUNT = 3;
+static const char *const COLUMN_HEADER[COLUMN_COUNT] = { "Class", "Vftables", "Methods" };
+static const int COLUMN_WIDTH[COLUMN_COUNT - 1] = { 420, 300 };
+static const UINT32 MAX_LISTED = 4;         // Vftables listed on a class node
+static const UINT32 MAX_INSERTS = 256;      // New classes inserted in place on a refresh, more resets the tree
+static const int REFRESH_MS = 1000;         // Check for table changes, like the rows added by a running scan
+
+// Tree model over the result table.
+// The top level is a node per class, from the table rows grouped by their type pool ID. A class node's vftable,
+// base and derived class nodes are made only when it's first expanded, from the RTTI base class array of the
+// class's COL, so the tree never holds more than what has been opened.
+class ClassTreeModel : public QAbstractItemModel
+{
+public:
+    ClassTreeModel(QObject *parent) : QAbstractItemModel(parent) { reset(); }
+
+    virtual QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+    virtual QModelIndex parent(const QModelIndex &child) const;
+    virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    virtual int columnCount(const QModelIndex &parent = QModelIndex()) const { return COLUMN_COUNT; }
+    virtual bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+    virtual bool canFetchMore(const QModelIndex &parent) const;
+    virtual void fetchMore(const QModelIndex &parent);
+    virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+    // Vftable of a vftable node, BADADDR for the other nodes
+    ea_t vftable(const QModelIndex &index) const;
+
+    // Pick up table changes
+    void refresh();
+
+private:
+    enum: BYTE
+    {
+        NK_ROOT,
+        NK_CLASS,       // 'id' is the type pool ID, NO_POOL_ID if the name isn't in the pool
+        NK_VFTABLE,     // 'id' is the table row
+        NK_BASES,
+        NK_DERIVED
+    };
+    struct NODE
+    {
+        NODE *parent = NULL;
+        std::vector<NODE *> children;
+        qstring name;           // Class name not in the pool
+        UINT32 id = 0;
+        int row = 0;            // Index in the parent's children
+        BYTE kind = NK_ROOT;
+        BOOL fetched = TRUE;    // Children made
+    };
+
+    NODE *node(const QModelIndex &index) const { return(index.isValid() ? (NODE *) index.internalPointer() : (NODE *) &m_root); }
+    NODE *newNode(NODE *parent, BYTE kind, UINT32 id);
+    void reset();
+    void indexRows();
+    BOOL insertClasses(const std::vector<UINT32> &ids);
+    void expandClass(NODE *node, __out std::vector<NODE *> &children);
+    template <class W> BOOL getDirectBases(UINT32 row, __out qvector<qstring> &names) const;
+    template <class W> void getRelations(const NODE *node, __out qvector<qstring> &bases, __out std::vector<UINT32> &derived) const;
+    LPCSTR className(const NODE *node) const { return((node->id != ResultTable::NO_POOL_ID) ? g_resultTable.poolText(node->id) : node->name.c_str()); }
+
+    // Table rows of a type pool ID
+    UINT32 classRowCount(UINT32 id) const { return((id < (UINT32) (m_rowStart.size() - 1)) ? (m_rowStart[id + 1] - m_rowStart[id]) : 0); }
+    const UINT32 *classRows(UINT32 id) const { return &m_rows[m_rowStart[id]]; }
+
+    NODE m_root;
+    std::vector<std::unique_ptr<NODE>> m_nodes;
+    std::vector<UINT32> m_rowStart;     // First 'm_rows' index per type pool ID, plus an end entry
+    std::vector<UINT32> m_rows;         // Table rows grouped by type
+    char m_addressFormat[20] = { 0 };
+    UINT32 m_tableRows = 0;             // Table rows looked at
+    UINT32 m_flagChanges = 0;           // Table flag change log entries looked at
+    UINT32 m_generation = 0;
+    UINT32 m_editGeneration = 0;
+};
+
+ClassTreeModel::NODE *ClassTreeModel::newNode(NODE *parent, BYTE kind, UINT32 id)
+{
+    m_nodes.emplace_back(new NODE());
+    NODE *node = m_nodes.back().get();
+    node->parent = parent;
+    node->kind = kind;
+    node->id = id;
+    node->fetched = (kind != NK_CLASS);
+    return node;
+}
+
+// Group the table rows by type, a counting sort over the type pool IDs
+void ClassTreeModel::indexRows()
+{
+    UINT32 rows = g_resultTable.size();
+    m_rowStart.assign((g_resultTable.poolCount() + 1), 0);
+    for (UINT32 row = 0; row < rows; row++)
+        m_rowStart[g_resultTable.typeId(row) + 1]++;
+    for (size_t i = 1; i < m_rowStart.size(); i++)
+        m_rowStart[i] += m_rowStart[i - 1];
+
+    m_rows.resize(rows);
+    std::vector<UINT32> next(m_rowStart.begin(), (m_rowStart.end() - 1));
+    for (UINT32 row = 0; row < rows; row++)
+        m_rows[next[g_resultTable.typeId(row)]++] = row;
+}
+
+void ClassTreeModel::reset()
+{
+    m_root.children.clear();
+    m_nodes.clear();
+    indexRows();
+
+    // Top level classes by name
+    std::vector<UINT32> ids;
+    for (UINT32 id = 0; id < g_resultTable.poolCount(); id++)
+    {
+        if (classRowCount(id))
+            ids.push_back(id);
+    }
+    std::sort(ids.begin(), ids.end(), [](UINT32 a, UINT32 b) { return(_stricmp(g_resultTable.poolText(a), g_resultTable.poolText(b)) < 0); });
+
+    m_root.children.reserve(ids.size());
+    for (UINT32 id: ids)
+    {
+        NODE *node = newNode(&m_root, NK_CLASS, id);
+        node->row = (int) m_root.children.size();
+        m_root.children.push_back(node);
+    }
+
+    GetEaFormatString(g_resultTable.maxVft(), m_addressFormat);
+    m_tableRows = g_resultTable.size();
+    m_flagChanges = g_resultTable.flagChangeCount();
+    m_generation = g_resultTable.generation();
+    m_editGeneration = g_resultTable.editGeneration();
+}
+
+// Insert new top level classes at their sorted place, keeping what has been expanded.
+// Returns FALSE if there are too many to insert one by one.
+BOOL ClassTreeModel::insertClasses(const std::vector<UINT32> &ids)
+{
+    if (ids.size() > MAX_INSERTS)
+        return FALSE;
+
+    for (UINT32 id: ids)
+    {
+        LPCSTR name = g_resultTable.poolText(id);
+        auto it = std::lower_bound(m_root.children.begin(), m_root.children.end(), name, [](const NODE *node, LPCSTR name) { return(_stricmp(g_resultTable.poolText(node->id), name) < 0); });
+        int row = (int) (it - m_root.children.begin());
+
+        beginInsertRows(QModelIndex(), row, row);
+        m_root.children.insert(it, newNode(&m_root, NK_CLASS, id));
+        for (size_t i = row; i < m_root.children.size(); i++)
+            m_root.children[i]->row = (int) i;
+        endInsertRows();
+    }
+    return TRUE;
+}
+
+void ClassTreeModel::refresh()
+{
+    if (m_generation == g_resultTable.generation())
+        return;
+
+    if (m_editGeneration == g_resultTable.editGeneration())
+    {
+        // Flags changed, repaint the vftable nodes made for those rows
+        UINT32 changes = g_resultTable.flagChangeCount();
+        if (m_flagChanges < changes)
+        {
+            std::vector<BYTE> changed(m_tableRows);
+            for (UINT32 i = m_flagChanges; i < changes; i++)
+            {
+                UINT32 row = g_resultTable.flagChangeRow(i);
+                if (row < m_tableRows)
+                    changed[row] = TRUE;
+            }
+
+            for (const std::unique_ptr<NODE> &node: m_nodes)
+            {
+                if ((node->kind == NK_VFTABLE) && (node->id < m_tableRows) && changed[node->id])
+                    emit dataChanged(createIndex(node->row, 0, node.get()), createIndex(node->row, (COLUMN_COUNT - 1), node.get()));
+            }
+            m_flagChanges = changes;
+        }
+
+        if (g_resultTable.size() == m_tableRows)
+        {
+            m_generation = g_resultTable.generation();
+            return;
+        }
+
+        // Rows appended, as by a running scan. Classes already expanded keep the children they were made with.
+        std::vector<BYTE> had(g_resultTable.poolCount());
+        for (UINT32 id = 0; id < (UINT32) had.size(); id++)
+            had[id] = (classRowCount(id) != 0);
+        indexRows();
+
+        std::vector<UINT32> ids;
+        for (UINT32 id = 0; id < (UINT32) had.size(); id++)
+        {
+            if (!had[id] && classRowCount(id))
+                ids.push_back(id);
+        }
+
+        if (insertClasses(ids))
+        {
+            // The vftable lists of the existing classes can have grown too
+            if (!m_root.children.empty())
+                emit dataChanged(index(0, 1), index((int) (m_root.children.size() - 1), 2));
+            GetEaFormatString(g_resultTable.maxVft(), m_addressFormat);
+            m_tableRows = g_resultTable.size();
+            m_generation = g_resultTable.generation();
+            return;
+        }
+    }
+
+    beginResetModel();
+    reset();
+    endResetModel();
+}
+
+QModelIndex ClassTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+    NODE *node = this->node(parent);
+    if ((row < 0) || (row >= (int) node->children.size()) || (column < 0) || (column >= COLUMN_COUNT))
+        return QModelIndex();
+    return createIndex(row, column, node->children[row]);
+}
+
+QModelIndex ClassTreeModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid())
+        return QModelIndex();
+    NODE *parent = node(child)->parent;
+    if (parent == &m_root)
+        return QModelIndex();
+    return createIndex(parent->row, 0, parent);
+}
+
+int ClassTreeModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.column() > 0)
+        return 0;
+    return (int) node(parent)->children.size();
+}
+
+bool ClassTreeModel::hasChildren(const QModelIndex &parent) const
+{
+    if (parent.column() > 0)
+        return false;
+    NODE *node = this->node(parent);
+    return(!node->fetched || !node->children.empty());
+}
+
+bool ClassTreeModel::canFetchMore(const QModelIndex &parent) const
+{
+    return(parent.isValid() && !node(parent)->fetched);
+}
+
+// Make a class node's children on it's first expand
+void ClassTreeModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent))
+        return;
+
+    try
+    {
+        NODE *node = this->node(parent);
+        node->fetched = TRUE;
+
+        std::vector<NODE *> children;
+        expandClass(node, children);
+        if (!children.empty())
+        {
+            for (size_t i = 0; i < children.size(); i++)
+                children[i]->row = (int) i;
+            beginInsertRows(createIndex(node->row, 0, node), 0, (int) (children.size() - 1));
+            node->children.swap(children);
+            endInsertRows();
+        }
+    }
+    CATCH()
+}
+
+// Direct bases of the class of a vftable row. The base class array is in preorder with the class itself first, so the
+// direct bases are the entries that follow each other's contained bases.
+template <class W> BOOL ClassTreeModel::getDirectBases(UINT32 row, __out qvector<qstring> &names) const
+{
+    names.clear();
+    ea_t col = W::getEa(g_resultTable.vft(row) - W::ptrSize);
+    qvector<RTTI::BASECLASS> bases;
+    UINT32 count = (col ? RTTI::getBaseClasses<W>(col, bases) : 0);
+    for (UINT32 i = 1; i < count; i += (bases[i].numContainedBases + 1))
+        names.push_back(bases[i].name);
+    return(count != 0);
+}
+
+template <class W> void ClassTreeModel::getRelations(const NODE *node, __out qvector<qstring> &bases, __out std::vector<UINT32> &derived) const
+{
+    UINT32 id = node->id;
+    LPCSTR name = className(node);
+    if (classRowCount(id))
+        getDirectBases<W>(classRows(id)[0], bases);
+
+    // Derived class candidates are the rows with the name in their hierarchy, as is or with a "struct " prefix,
+    // found by pool ID alone. Each candidate class is confirmed by it's own direct bases.
+    qstring structName;
+    structName.sprnt("struct %s", name);
+    UINT32 plainId = g_resultTable.poolId(name);
+    UINT32 structId = g_resultTable.poolId(structName.c_str());
+    if ((plainId == ResultTable::NO_POOL_ID) && (structId == ResultTable::NO_POOL_ID))
+        return;
+
+    std::vector<UINT32> candidates;
+    UINT32 rows = g_resultTable.size();
+    for (UINT32 row = 0; row < rows; row++)
+    {
+        UINT32 type = g_resultTable.typeId(row);
+        if (type == id)
+            continue;
+
+        UINT32 count = g_resultTable.hierarchyCount(row);
+        for (UINT32 i = 0; i < count; i++)
+        {
+            UINT32 hid = g_resultTable.hierarchyId(row, i);
+            if ((hid == plainId) || (hid == structId))
+            {
+                candidates.push_back(type);
+                break;
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    qvector<qstring> names;
+    for (UINT32 type: candidates)
+    {
+        if (getDirectBases<W>(classRows(type)[0], names) && names.has(qstring(name)))
+            derived.push_back(type);
+    }
+    std::sort(derived.begin(), derived.end(), [](UINT32 a, UINT32 b) { return(_stricmp(g_resultTable.poolText(a), g_resultTable.poolText(b)) < 0); });
+}
+
+void ClassTreeModel::expandClass(NODE *node, __out std::vector<NODE *> &children)
+{
+    // The class's own vftables
+    if (UINT32 count = classRowCount(node->id))
+    {
+        const UINT32 *rows = classRows(node->id);
+        for (UINT32 i = 0; i < count; i++)
+            children.push_back(newNode(node, NK_VFTABLE, rows[i]));
+    }
+
+    qvector<qstring> bases;
+    std::vector<UINT32> derived;
+    // From the IDB, 'plat' is only configured once the plugin runs
+    if (inf_is_64bit())
+        getRelations<RTTI::PTR64>(node, bases, derived);
+    else
+        getRelations<RTTI::PTR32>(node, bases, derived);
+
+    if (!bases.empty())
+    {
+        NODE *group = newNode(node, NK_BASES, 0);
+        for (const qstring &base: bases)
+        {
+            NODE *child = newNode(group, NK_CLASS, g_resultTable.poolId(base.c_str()));
+            if (child->id == ResultTable::NO_POOL_ID)
+                child->name = base;
+            child->row = (int) group->children.size();
+            group->children.push_back(child);
+        }
+        children.push_back(group);
+    }
+
+    if (!derived.empty())
+    {
+        NODE *group = newNode(node, NK_DERIVED, 0);
+        for (UINT32 id: derived)
+        {
+            NODE *child = newNode(group, NK_CLASS, id);
+            child->row = (int) group->children.size();
+            group->children.push_back(child);
+        }
+        children.push_back(group);
+    }
+}
+
+QVariant ClassTreeModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid())
+        return QVariant();
+    NODE *node = this->node(index);
+
+    if (role == Qt::DisplayRole)
+    {
+        char buffer[32];
+        switch (node->kind)
+        {
+            case NK_CLASS:
+            {
+                if (index.column() == 0)
+                    return QString::fromUtf8(className(node));
+
+                // Its vftable addresses or method counts
+                UINT32 count = classRowCount(node->id);
+                if (!count)
+                    return QVariant();
+                const UINT32 *rows = classRows(node->id);
+                qstring text;
+                for (UINT32 i = 0; i < std::min(count, MAX_LISTED); i++)
+                {
+                    if (i)
+                        text += ", ";
+                    if (index.column() == 1)
+                        _snprintf_s(buffer, sizeof(buffer), SIZESTR(buffer), m_addressFormat, g_resultTable.vft(rows[i]));
+                    else
+                        _snprintf_s(buffer, sizeof(buffer), SIZESTR(buffer), "%u", g_resultTable.methods(rows[i]));
+                    text += buffer;
+                }
+                if (count > MAX_LISTED)
+                    text.cat_sprnt(" +%u more", (count - MAX_LISTED));
+                return QString::fromUtf8(text.c_str());
+            }
+
+            case NK_VFTABLE:
+            {
+                UINT32 row = node->id;
+                if (row >= g_resultTable.size())
+                    return QVariant();
+                switch (index.column())
+                {
+                    // The hierarchy tells which part of the class the vftable is for
+                    case 0:
+                    {
+                        qstring text;
+                        g_resultTable.getHierarchy(row, text);
+                        return QString::fromUtf8(text.c_str());
+                    }
+
+                    case 1:
+                        _snprintf_s(buffer, sizeof(buffer), SIZESTR(buffer), m_addressFormat, g_resultTable.vft(row));
+                        return QString::fromLatin1(buffer);
+
+                    case 2:
+                    {
+                        if (UINT32 methods = g_resultTable.methods(row))
+                            return QString::number(methods);
+                        return QString("???");
+                    }
+                };
+                break;
+            }
+
+            case NK_BASES:
+            case NK_DERIVED:
+            {
+                if (index.column() == 0)
+                {
+                    _snprintf_s(buffer, sizeof(buffer), SIZESTR(buffer), ((node->kind == NK_BASES) ? "Base classes (%u)" : "Derived classes (%u)"), (UINT32) node->children.size());
+                    return QString::fromLatin1(buffer);
+                }
+                break;
+            }
+        };
+    }
+    else
+    // Indicate a vftable that's not for the top/parent level by color, like the list
+    if ((role == Qt::BackgroundRole) && (node->kind == NK_VFTABLE) && (node->id < g_resultTable.size()))
+    {
+        if (!(g_resultTable.flags(node->id) & RTTI::IS_TOP_LEVEL))
+            return QBrush(QColor((NOT_PARENT_COLOR & 0xFF), ((NOT_PARENT_COLOR >> 8) & 0xFF), ((NOT_PARENT_COLOR >> 16) & 0xFF)));
+    }
+
+    return QVariant();
+}
+
+QVariant ClassTreeModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if ((role == Qt::DisplayRole) && (orientation == Qt::Horizontal) && (section >= 0) && (section < COLUMN_COUNT))
+        return QString(COLUMN_HEADER[section]);
+    return QVariant();
+}
+
+ea_t ClassTreeModel::vftable(const QModelIndex &index) const
+{
+    NODE *node = this->node(index);
+    if (index.isValid() && (node->kind == NK_VFTABLE) && (node->id < g_resultTable.size()))
+        return g_resultTable.vft(node->id);
+    return BADADDR;
+}
+
+
+void showClassTree()
+{
+    try
+    {
+        if (TWidget *widget = find_widget(CLASSTREE_TITLE))
+        {
+            activate_widget(widget, true);
+            return;
+        }
+
+        TWidget *widget = create_empty_widget(CLASSTREE_TITLE);
+        QWidget *parent = (QWidget *) widget;
+        QTreeView *view = new QTreeView(parent);
+        ClassTreeModel *model = new ClassTreeModel(view);
+        view->setModel(model);
+
+        // Uniform row heights, so the view never measures rows
+        view->setUniformRowHeights(true);
+        view->header()->setSectionResizeMode(QHeaderView::Interactive);
+        view->header()->setStretchLastSection(true);
+        for (int column = 0; column < (COLUMN_COUNT - 1); column++)
+            view->setColumnWidth(column, COLUMN_WIDTH[column]);
+        view->setSelectionBehavior(QAbstractItemView::SelectRows);
+        view->setSelectionMode(QAbstractItemView::SingleSelection);
+        view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+        // Double click expands a class, and jumps to a vftable
+        QObject::connect(view, &QAbstractItemView::doubleClicked, [model](const QModelIndex &index)
+        {
+            ea_t vft = model->vftable(index);
+            if (vft != BADADDR)
+                jumpto(vft);
+        });
+
+        QTimer *timer = new QTimer(view);
+        QObject::connect(timer, &QTimer::timeout, [model]() { model->refresh(); });
+        timer->start(REFRESH_MS);
+
+        QVBoxLayout *layout = new QVBoxLayout(parent);
+        layout->setContentsMargins(0, 0, 0, 0);
+        layout->addWidget(view);
+        display_widget(widget, (WOPN_DP_TAB | WOPN_RESTORE));
+    }
+    CATCH()
+}
+
+
+struct classtree_handler_t: public action_handler_t
+{
+    virtual int idaapi activate(action_activation_ctx_t *ctx)
+    {
+        useStoredTable();
+        showClassTree();
+        return 0;
+    }
+
+    virtual action_state_t idaapi update(action_update_ctx_t *ctx) { return AST_ENABLE_ALWAYS; }
+};
+static classtree_handler_t classTreeHandler;
+
+void registerClassTreeAction()
+{
+    const action_desc_t desc = ACTION_DESC_LITERAL(CLASSTREE_ACTION_NAME, "Class Informer class tree", &classTreeHandler, NULL, "Browse the Class Informer classes by their base and derived classes", -1);
+    if (register_action(desc))
+        attach_action_to_menu(CLASSTREE_MENU_PATH, CLASSTREE_ACTION_NAME, SETMENU_APP);
+}
+
+void unregisterClassTreeAction()
+{
+    detach_action_from_menu(CLASSTREE_MENU_PATH, CLASSTREE_ACTION_NAME);
+    unregister_action(CLASSTREE_ACTION_NAME);
+}
@@ -0,0 +1,10 @@
+// Class hierarchy tree dock
+#pragma once
+
+// Dockable tree of the classes with their vftables, direct base classes and directly derived classes.
+// A node's children are only looked up when it's expanded.
+void showClassTree();
+
+// "View/Open subviews" action to open it
+void registerClassTreeAction();
+void unregisterClassTreeAction();
@@ -0,0 +1,436 @@
+// Class browser dock
+#include "stdafx.h"
+#include "Main.h"
+#include "RTTI.h"
+#include "ResultTable.h"
+#include "ClassSearch.h"
+#include "ClassView.h"
+#include <algorithm>
+#include <numeric>
+
+#include <QtCore/QAbstractTableModel>
+#include <QtCore/QTimer>
+#include <QtWidgets/QHBoxLayout>
+#include <QtWidgets/QLineEdit>
+#include <QtWidgets/QVBoxLayout>
+
+static const char CLASSVIEW_TITLE[] = { "Class Informer classes" };
+static const char CLASSVIEW_ACTION_NAME[] = { "ClassInformer:ClassView" };
+static const char CLASSVIEW_MENU_PATH[] = { "View/Open subviews/" };
+
+static const int COLUMN_COUNT = 5;
+static const char *const COLUMN_HEADER[COLUMN_COUNT] = { "Vftable", "Methods", "Flags", "Type", "Hierarchy" };
+static const int ROW_HEIGHT = 24;
+static const int WIDTH_SAMPLES = 256;       // Rows measured for the column widths
+static const int MAX_COLUMN_WIDTH = 600;
+static const int REFRESH_MS = 1000;         // Check for table changes, like the rows added by a running scan
+
+// Table model straight over the result table columns.
+// Rows are formatted only as the view asks for them, and sorting works on an integer key per row: the address or
+// count, or for the names their rank among the sorted unique pool strings, so no row text is compared.
+// The rows can be filtered by class and base class name through the trigram index.
+class ClassModel : public QAbstractTableModel
+{
+public:
+    ClassModel(QObject *parent) : QAbstractTableModel(parent) { reset(); }
+
+    virtual int rowCount(const QModelIndex &parent = QModelIndex()) const { return(parent.isValid() ? 0 : (int) m_order.size()); }
+    virtual int columnCount(const QModelIndex &parent = QModelIndex()) const { return(parent.isValid() ? 0 : COLUMN_COUNT); }
+    virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+    virtual void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+
+    // Table row of a view row, NOT_ROW if none
+    static const UINT32 NOT_ROW = (UINT32) -1;
+    UINT32 tableRow(int row) const
+    {
+        if ((row >= 0) && (row < (int) m_order.size()) && (m_order[row] < g_resultTable.size()))
+            return m_order[row];
+        return NOT_ROW;
+    }
+
+    // Pick up table changes
+    void refresh();
+
+    // Show only the rows of classes with a name containing 'name' that derive from one containing 'base'
+    void setFilter(const QString &name, const QString &base);
+
+private:
+    BOOL isFiltered() const { return(!m_filterName.empty() || !m_filterBase.empty()); }
+    void reset();
+    void sortRows();
+    void buildRanks();
+    UINT64 sortKey(UINT32 row) const;
+
+    std::vector<UINT32> m_order;        // Table row per view row
+    std::vector<UINT32> m_rank;         // Sorted rank per pool string ID
+    std::string m_filterName, m_filterBase;
+    UINT32 m_tableRows = 0;             // Table rows looked at
+    UINT32 m_flagChanges = 0;           // Table flag change log entries looked at
+    char m_addressFormat[20] = { 0 };
+    UINT32 m_generation = 0;
+    UINT32 m_editGeneration = 0;
+    UINT32 m_rankEditGeneration = (UINT32) -1;
+    int m_sortColumn = -1;
+    Qt::SortOrder m_sortOrder = Qt::AscendingOrder;
+};
+
+void ClassModel::reset()
+{
+    UINT32 count = g_resultTable.size();
+    if (isFiltered())
+        g_classSearch.find(m_filterName.c_str(), m_filterBase.c_str(), m_order);
+    else
+    {
+        m_order.resize(count);
+        std::iota(m_order.begin(), m_order.end(), 0);
+    }
+    m_tableRows = count;
+    sortRows();
+    GetEaFormatString(g_resultTable.maxVft(), m_addressFormat);
+    m_flagChanges = g_resultTable.flagChangeCount();
+    m_generation = g_resultTable.generation();
+    m_editGeneration = g_resultTable.editGeneration();
+}
+
+// Appended rows and flag changes update the view in place, keeping its selection and scroll position
+void ClassModel::refresh()
+{
+    if (m_generation == g_resultTable.generation())
+        return;
+
+    if (m_editGeneration != g_resultTable.editGeneration())
+    {
+        beginResetModel();
+        reset();
+        endResetModel();
+        return;
+    }
+
+    // Repaint the rows with changed flags, their background and flags text
+    UINT32 changes = g_resultTable.flagChangeCount();
+    if ((m_flagChanges < changes) && !m_order.empty())
+    {
+        std::vector<UINT32> viewRow(m_tableRows, NOT_ROW);
+        for (UINT32 i = 0; i < (UINT32) m_order.size(); i++)
+            viewRow[m_order[i]] = i;
+
+        for (UINT32 i = m_flagChanges; i < changes; i++)
+        {
+            UINT32 row = g_resultTable.flagChangeRow(i);
+            if ((row < m_tableRows) && (viewRow[row] != NOT_ROW))
+                emit dataChanged(index((int) viewRow[row], 0), index((int) viewRow[row], (COLUMN_COUNT - 1)));
+        }
+
+        if (m_sortColumn == 2)
+        {
+            emit layoutAboutToBeChanged();
+            sortRows();
+            emit layoutChanged();
+        }
+    }
+    m_flagChanges = changes;
+
+    UINT32 count = g_resultTable.size();
+    if (count > m_tableRows)
+    {
+        // Rows appended, the ones that pass the filter go at the end then move into the sort order
+        std::vector<UINT32> added;
+        if (isFiltered())
+        {
+            g_classSearch.find(m_filterName.c_str(), m_filterBase.c_str(), added);
+            added.erase(added.begin(), std::lower_bound(added.begin(), added.end(), m_tableRows));
+        }
+        else
+        {
+            added.resize(count - m_tableRows);
+            std::iota(added.begin(), added.end(), m_tableRows);
+        }
+        m_tableRows = count;
+
+        if (!added.empty())
+        {
+            UINT32 have = (UINT32) m_order.size();
+            beginInsertRows(QModelIndex(), (int) have, (int) (have + added.size() - 1));
+            m_order.insert(m_order.end(), added.begin(), added.end());
+            endInsertRows();
+
+            if (m_sortColumn >= 0)
+            {
+                emit layoutAboutToBeChanged();
+                sortRows();
+                emit layoutChanged();
+            }
+        }
+
+        char addressFormat[20];
+        GetEaFormatString(g_resultTable.maxVft(), addressFormat);
+        if ((strcmp(addressFormat, m_addressFormat) != 0) && !m_order.empty())
+        {
+            strcpy(m_addressFormat, addressFormat);
+            emit dataChanged(index(0, 0), index((int) (m_order.size() - 1), 0));
+        }
+    }
+    m_generation = g_resultTable.generation();
+}
+
+void ClassModel::setFilter(const QString &name, const QString &base)
+{
+    std::string filterName = name.trimmed().toUtf8().constData();
+    std::string filterBase = base.trimmed().toUtf8().constData();
+    if ((filterName == m_filterName) && (filterBase == m_filterBase))
+        return;
+
+    beginResetModel();
+    m_filterName = filterName;
+    m_filterBase = filterBase;
+    reset();
+    endResetModel();
+}
+
+QVariant ClassModel::data(const QModelIndex &index, int role) const
+{
+    UINT32 row = tableRow(index.row());
+    if (row == NOT_ROW)
+        return QVariant();
+
+    if (role == Qt::DisplayRole)
+    {
+        char buffer[32];
+        switch (index.column())
+        {
+            case 0:
+                _snprintf_s(buffer, sizeof(buffer), SIZESTR(buffer), m_addressFormat, g_resultTable.vft(row));
+                return QString::fromLatin1(buffer);
+
+            case 1:
+            {
+                if (UINT32 methods = g_resultTable.methods(row))
+                    return QString::number(methods);
+                return QString("???");
+            }
+
+            case 2:
+            {
+                WORD flags = g_resultTable.flags(row);
+                int len = 0;
+                if (flags & RTTI::CHD_MULTINH)   buffer[len++] = 'M';
+                if (flags & RTTI::CHD_VIRTINH)   buffer[len++] = 'V';
+                if (flags & RTTI::CHD_AMBIGUOUS) buffer[len++] = 'A';
+                buffer[len] = 0;
+                return QString::fromLatin1(buffer);
+            }
+
+            case 3:
+                return QString::fromUtf8(g_resultTable.type(row));
+
+            case 4:
+            {
+                qstring text;
+                g_resultTable.getHierarchy(row, text);
+                return QString::fromUtf8(text.c_str());
+            }
+        };
+    }
+    else
+    // Indicate entry is not a top/parent level by color
+    if (role == Qt::BackgroundRole)
+    {
+        if (!(g_resultTable.flags(row) & RTTI::IS_TOP_LEVEL))
+            return QBrush(QColor((NOT_PARENT_COLOR & 0xFF), ((NOT_PARENT_COLOR >> 8) & 0xFF), ((NOT_PARENT_COLOR >> 16) & 0xFF)));
+    }
+
+    return QVariant();
+}
+
+QVariant ClassModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if ((role == Qt::DisplayRole) && (orientation == Qt::Horizontal) && (section >= 0) && (section < COLUMN_COUNT))
+        return QString(COLUMN_HEADER[section]);
+    return QVariant();
+}
+
+void ClassModel::sort(int column, Qt::SortOrder order)
+{
+    emit layoutAboutToBeChanged();
+    m_sortColumn = column;
+    m_sortOrder = order;
+    sortRows();
+    emit layoutChanged();
+}
+
+// Rank every pool string by text once, the names sort by it
+void ClassModel::buildRanks()
+{
+    UINT32 count = g_resultTable.poolCount();
+    if ((m_rank.size() == count) && (m_rankEditGeneration == g_resultTable.editGeneration()))
+        return;
+
+    std::vector<UINT32> ids(count);
+    std::iota(ids.begin(), ids.end(), 0);
+    std::sort(ids.begin(), ids.end(), [](UINT32 a, UINT32 b) { return(_stricmp(g_resultTable.poolText(a), g_resultTable.poolText(b)) < 0); });
+    m_rank.resize(count);
+    for (UINT32 i = 0; i < count; i++)
+        m_rank[ids[i]] = i;
+    m_rankEditGeneration = g_resultTable.editGeneration();
+}
+
+UINT64 ClassModel::sortKey(UINT32 row) const
+{
+    switch (m_sortColumn)
+    {
+        case 0: return (UINT64) g_resultTable.vft(row);
+        case 1: return g_resultTable.methods(row);
+        case 2: return (g_resultTable.flags(row) & (RTTI::CHD_MULTINH | RTTI::CHD_VIRTINH | RTTI::CHD_AMBIGUOUS));
+        case 3: return m_rank[g_resultTable.typeId(row)];
+
+        // The hierarchy by its first two names
+        case 4:
+        {
+            UINT32 count = g_resultTable.hierarchyCount(row);
+            UINT64 key = (count ? ((UINT64) m_rank[g_resultTable.hierarchyId(row, 0)] << 32) : 0);
+            if (count > 1)
+                key |= m_rank[g_resultTable.hierarchyId(row, 1)];
+            return key;
+        }
+    };
+    return row;
+}
+
+void ClassModel::sortRows()
+{
+    if ((m_sortColumn < 0) || m_order.empty())
+        return;
+    if (m_sortColumn >= 3)
+        buildRanks();
+
+    // Ties keep the table order
+    struct KEY { UINT64 key; UINT32 row; };
+    std::vector<KEY> keys(m_order.size());
+    for (size_t i = 0; i < keys.size(); i++)
+        keys[i] = { sortKey(m_order[i]), m_order[i] };
+
+    if (m_sortOrder == Qt::AscendingOrder)
+        std::sort(keys.begin(), keys.end(), [](const KEY &a, const KEY &b) { return((a.key < b.key) || ((a.key == b.key) && (a.row < b.row))); });
+    else
+        std::sort(keys.begin(), keys.end(), [](const KEY &a, const KEY &b) { return((a.key > b.key) || ((a.key == b.key) && (a.row < b.row))); });
+
+    for (size_t i = 0; i < keys.size(); i++)
+        m_order[i] = keys[i].row;
+}
+
+
+// Column widths from a sample of rows spread over the table instead of measuring all of them
+static void estimateColumnWidths(QTableView *view, const ClassModel *model)
+{
+    QFontMetrics metrics(view->font());
+    int rows = model->rowCount();
+    int step = std::max(1, (rows / WIDTH_SAMPLES));
+    for (int column = 0; column < (COLUMN_COUNT - 1); column++)
+    {
+        int width = metrics.horizontalAdvance(QString(COLUMN_HEADER[column]));
+        for (int row = 0; row < rows; row += step)
+            width = std::max(width, metrics.horizontalAdvance(model->data(model->index(row, column)).toString()));
+        view->setColumnWidth(column, std::min((width + 16), MAX_COLUMN_WIDTH));
+    }
+}
+
+void showClassView()
+{
+    try
+    {
+        if (TWidget *widget = find_widget(CLASSVIEW_TITLE))
+        {
+            activate_widget(widget, true);
+            return;
+        }
+
+        // Index the class names for the filter
+        g_classSearch.update();
+
+        TWidget *widget = create_empty_widget(CLASSVIEW_TITLE);
+        QWidget *parent = (QWidget *) widget;
+        QTableView *view = new QTableView(parent);
+        ClassModel *model = new ClassModel(view);
+        view->setModel(model);
+
+        // Fixed uniform row height, so the view never measures rows
+        view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+        view->verticalHeader()->setDefaultSectionSize(ROW_HEIGHT);
+        view->verticalHeader()->setVisible(false);
+        view->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
+        view->horizontalHeader()->setStretchLastSection(true);
+        view->setSelectionBehavior(QAbstractItemView::SelectRows);
+        view->setSelectionMode(QAbstractItemView::SingleSelection);
+        view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        view->setWordWrap(false);
+        view->setShowGrid(false);
+        estimateColumnWidths(view, model);
+
+        // Sort by type name like the chooser
+        view->setSortingEnabled(true);
+        view->sortByColumn(3, Qt::DescendingOrder);
+
+        QObject::connect(view, &QAbstractItemView::doubleClicked, [model](const QModelIndex &index)
+        {
+            UINT32 row = model->tableRow(index.row());
+            if (row != ClassModel::NOT_ROW)
+                jumpto(g_resultTable.vft(row));
+        });
+
+        QTimer *timer = new QTimer(view);
+        QObject::connect(timer, &QTimer::timeout, [model]() { model->refresh(); });
+        timer->start(REFRESH_MS);
+
+        // Name filters, the search is quick enough to run on every edit
+        QLineEdit *nameFilter = new QLineEdit(parent);
+        nameFilter->setPlaceholderText("Class name contains");
+        nameFilter->setClearButtonEnabled(true);
+        QLineEdit *baseFilter = new QLineEdit(parent);
+        baseFilter->setPlaceholderText("Derives from");
+        baseFilter->setClearButtonEnabled(true);
+        auto filter = [model, nameFilter, baseFilter]() { model->setFilter(nameFilter->text(), baseFilter->text()); };
+        QObject::connect(nameFilter, &QLineEdit::textChanged, filter);
+        QObject::connect(baseFilter, &QLineEdit::textChanged, filter);
+
+        QHBoxLayout *filterLayout = new QHBoxLayout();
+        filterLayout->setContentsMargins(0, 0, 0, 0);
+        filterLayout->addWidget(nameFilter);
+        filterLayout->addWidget(baseFilter);
+
+        QVBoxLayout *layout = new QVBoxLayout(parent);
+        layout->setContentsMargins(0, 0, 0, 0);
+        layout->setSpacing(2);
+        layout->addLayout(filterLayout);
+        layout->addWidget(view);
+        display_widget(widget, (WOPN_DP_TAB | WOPN_RESTORE));
+    }
+    CATCH()
+}
+
+
+struct classview_handler_t: public action_handler_t
+{
+    virtual int idaapi activate(action_activation_ctx_t *ctx)
+    {
+        useStoredTable();
+        showClassView();
+        return 0;
+    }
+
+    virtual action_state_t idaapi update(action_update_ctx_t *ctx) { return AST_ENABLE_ALWAYS; }
+};
+static classview_handler_t classViewHandler;
+
+void registerClassViewAction()
+{
+    const action_desc_t desc = ACTION_DESC_LITERAL(CLASSVIEW_ACTION_NAME, "Class Informer classes", &classViewHandler, NULL, "Browse the Class Informer vftable list in a dockable table", -1);
+    if (register_action(desc))
+        attach_action_to_menu(CLASSVIEW_MENU_PATH, CLASSVIEW_ACTION_NAME, SETMENU_APP);
+}
+
+void unregisterClassViewAction()
+{
+    detach_action_from_menu(CLASSVIEW_MENU_PATH, CLASSVIEW_ACTION_NAME);
+    unregister_action(CLASSVIEW_ACTION_NAME);
+}
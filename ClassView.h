@@ -0,0 +1,9 @@
+// Class browser dock
+#pragma once
+
+// Dockable Qt table view of the vftable list, for result sets too large for the chooser to open and sort quickly
+void showClassView();
+
+// "View/Open subviews" action to open it
+void registerClassViewAction();
+void unregisterClassViewAction();
@@ -0,0 +1,528 @@
+// Vftable result export
+#include "stdafx.h"
+#include "Main.h"
+#include "RTTI.h"
+#include "ResultTable.h"
+#include "Export.h"
+#include <WaitBoxEx.h>
+
+static const char EXPORT_ACTION_NAME[] = { "ClassInformer:Export" };
+static const char EXPORT_MENU_PATH[] = { "File/Produce file/" };
+static const size_t FILE_BUFFER_SIZE = (1024 * 1024);
+
+enum EXPORT_FORMAT
+{
+    EF_JSONL,
+    EF_CSV,
+    EF_COLUMNAR
+};
+
+// Columnar binary format.
+// A CIXHEADER, then the sections it lists, each starting 8 byte aligned. Fixed size per row sections are plain
+// arrays. Variable length ones have an index section of rows + 1 UINT64 start positions, row N's items are
+// [index[N], index[N + 1]). Text sections are null terminated strings indexed by byte offset.
+enum CIX_SECTION
+{
+    CS_VFT,         // UINT64 vftable address
+    CS_COL,         // UINT64 COL address
+    CS_METHODS,     // UINT32 method count
+    CS_FLAGS,       // UINT16 CHD_* attribute flags, plus IS_TOP_LEVEL
+    CS_TYPE_TEXT,   // Class names
+    CS_TYPE_INDEX,  // UINT64 CS_TYPE_TEXT offsets
+    CS_BASES,       // CIXBASE records in hierarchy order, the class itself first
+    CS_BASE_TEXT,   // Base class names
+    CS_BASE_INDEX,  // UINT64 CS_BASES record indexes
+    CS_SLOTS,       // UINT64 vftable slot targets
+    CS_SLOT_INDEX,  // UINT64 CS_SLOTS indexes
+
+    CS_COUNT
+};
+
+#pragma pack(push, 1)
+struct CIXSECTION
+{
+    UINT64 offset, size;
+};
+
+struct CIXHEADER
+{
+    char magic[8];  // "CIXCOLS"
+    UINT32 version;
+    UINT32 is64;
+    UINT64 rows;
+    CIXSECTION sections[CS_COUNT];
+};
+
+struct CIXBASE
+{
+    UINT64 name;    // CS_BASE_TEXT offset
+    INT32 mdisp, pdisp, vdisp;
+    UINT32 attributes;
+    UINT32 numContainedBases;
+    UINT32 reserved;
+};
+#pragma pack(pop)
+static_assert((sizeof(CIXBASE) % 8) == 0);
+
+static const char CIX_MAGIC[8] = { "CIXCOLS" };
+static const UINT32 CIX_VERSION = 1;
+
+
+// Export output file. Write errors are sticky and reported on close.
+class ExportFile
+{
+public:
+    ~ExportFile() { close(); }
+
+    BOOL open(LPCSTR path, LPCSTR mode = "wb")
+    {
+        if ((m_fp = qfopen(path, mode)) != NULL)
+        {
+            setvbuf(m_fp, NULL, _IOFBF, FILE_BUFFER_SIZE);
+            m_path = path;
+            m_size = 0;
+            m_error = FALSE;
+            m_temp = FALSE;
+        }
+        return(m_fp != NULL);
+    }
+
+    // Temporary spill file for a section written along with another, deleted on close
+    BOOL openTemp()
+    {
+        char path[QMAXPATH];
+        if (!qtmpnam(path, sizeof(path)) || !open(path, "w+b"))
+            return FALSE;
+        m_temp = TRUE;
+        return TRUE;
+    }
+
+    void write(const void *data, size_t size)
+    {
+        if (size && !m_error)
+        {
+            m_error = (qfwrite(m_fp, data, size) != (ssize_t) size);
+            m_size += size;
+        }
+    }
+    void write(const qstring &str) { write(str.c_str(), str.length()); }
+    template <class T> void put(T value) { write(&value, sizeof(T)); }
+
+    // Pad to the next 8 byte boundary
+    void align()
+    {
+        static const BYTE zero[8] = { 0 };
+        write(zero, (size_t) ((8 - (m_size & 7)) & 7));
+    }
+
+    // Write over the start of the file
+    void rewriteHeader(const void *data, size_t size)
+    {
+        if (!m_error)
+        {
+            fflush(m_fp);
+            m_error = ((qfseek(m_fp, 0, SEEK_SET) != 0) || (qfwrite(m_fp, data, size) != (ssize_t) size));
+        }
+    }
+
+    // Append this file's content to another, then delete it
+    void appendTo(ExportFile &out)
+    {
+        if (!m_error && m_size)
+        {
+            fflush(m_fp);
+            qfseek(m_fp, 0, SEEK_SET);
+            std::vector<BYTE> buffer(FILE_BUFFER_SIZE);
+            for (UINT64 left = m_size; left && !out.m_error;)
+            {
+                size_t size = (size_t) std::min((UINT64) buffer.size(), left);
+                if (qfread(m_fp, buffer.data(), size) != (ssize_t) size)
+                {
+                    m_error = TRUE;
+                    break;
+                }
+                out.write(buffer.data(), size);
+                left -= size;
+            }
+        }
+        out.m_error |= m_error;
+        close();
+    }
+
+    BOOL close()
+    {
+        if (m_fp)
+        {
+            m_error |= (qfclose(m_fp) != 0);
+            m_fp = NULL;
+            if (m_temp)
+                qunlink(m_path.c_str());
+        }
+        return !m_error;
+    }
+
+    UINT64 size() const { return m_size; }
+    BOOL error() const { return m_error; }
+    void setError() { m_error = TRUE; }
+
+private:
+    FILE *m_fp = NULL;
+    qstring m_path;
+    UINT64 m_size = 0;
+    BOOL m_error = FALSE;
+    BOOL m_temp = FALSE;
+};
+
+
+// Progress over a number of passes over the rows. Returns TRUE if canceled.
+static BOOL updateProgress(UINT32 pass, UINT32 passes, UINT32 row, UINT32 rows)
+{
+    if (WaitBox::isUpdateTime())
+        return WaitBox::updateAndCancelCheck((int) ((((UINT64) pass * rows + row) * 100) / ((UINT64) passes * rows)));
+    return FALSE;
+}
+
+// The flag letters the chooser shows
+static void getFlagText(WORD flags, __out char text[4])
+{
+    int pos = 0;
+    if (flags & RTTI::CHD_MULTINH)   text[pos++] = 'M';
+    if (flags & RTTI::CHD_VIRTINH)   text[pos++] = 'V';
+    if (flags & RTTI::CHD_AMBIGUOUS) text[pos++] = 'A';
+    text[pos] = 0;
+}
+
+static void appendJsonString(qstring &out, LPCSTR str)
+{
+    out += '"';
+    for (; *str; str++)
+    {
+        BYTE c = (BYTE) *str;
+        switch (c)
+        {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+            {
+                if (c < 0x20)
+                    out.cat_sprnt("\\u%04X", c);
+                else
+                    out += (char) c;
+            }
+            break;
+        };
+    }
+    out += '"';
+}
+
+static void appendCsvString(qstring &out, LPCSTR str)
+{
+    out += '"';
+    for (; *str; str++)
+    {
+        if (*str == '"')
+            out += '"';
+        out += *str;
+    }
+    out += '"';
+}
+
+
+// JSON Lines or CSV, one line per row. Returns TRUE if canceled.
+template <class W> static BOOL exportText(ExportFile &file, EXPORT_FORMAT format)
+{
+    qvector<RTTI::BASECLASS> bases;
+    qstring line;
+    UINT32 rows = g_resultTable.size();
+
+    if (format == EF_CSV)
+    {
+        line = "vftable,col,methods,flags,type,bases,slots\r\n";
+        file.write(line);
+    }
+
+    for (UINT32 row = 0; (row < rows) && !file.error(); row++)
+    {
+        ea_t vft = g_resultTable.vft(row);
+        ea_t col = W::getEa(vft - W::ptrSize);
+        UINT32 methods = g_resultTable.methods(row);
+        WORD flags = g_resultTable.flags(row);
+        UINT32 baseCount = (col ? RTTI::getBaseClasses<W>(col, bases) : 0);
+        char flagText[4];
+        getFlagText(flags, flagText);
+
+        line.qclear();
+        if (format == EF_JSONL)
+        {
+            line.cat_sprnt("{\"vftable\":\"0x%llX\",\"col\":\"0x%llX\",\"methods\":%u,\"flags\":\"%s\",\"attributes\":%u,\"topLevel\":%s,\"type\":",
+                (UINT64) vft, (UINT64) col, methods, flagText, (flags & 0xF), ((flags & RTTI::IS_TOP_LEVEL) ? "true" : "false"));
+            appendJsonString(line, g_resultTable.type(row));
+
+            line += ",\"bases\":[";
+            for (UINT32 i = 0; i < baseCount; i++)
+            {
+                const RTTI::BASECLASS &bc = bases[i];
+                line += (i ? ",{\"name\":" : "{\"name\":");
+                appendJsonString(line, bc.name.c_str());
+                line.cat_sprnt(",\"mdisp\":%d,\"pdisp\":%d,\"vdisp\":%d,\"attributes\":%u,\"contained\":%u}", bc.pmd.mdisp, bc.pmd.pdisp, bc.pmd.vdisp, bc.attributes, bc.numContainedBases);
+            }
+
+            line += "],\"slots\":[";
+            for (UINT32 i = 0; i < methods; i++)
+                line.cat_sprnt((i ? ",\"0x%llX\"" : "\"0x%llX\""), (UINT64) W::getEa(vft + ((ea_t) i * W::ptrSize)));
+            line += "]}\n";
+        }
+        else
+        {
+            line.cat_sprnt("0x%llX,0x%llX,%u,%s,", (UINT64) vft, (UINT64) col, methods, flagText);
+            appendCsvString(line, g_resultTable.type(row));
+
+            // "name(mdisp pdisp vdisp attributes);.."
+            qstring field;
+            for (UINT32 i = 0; i < baseCount; i++)
+            {
+                const RTTI::BASECLASS &bc = bases[i];
+                field.cat_sprnt("%s%s(%d %d %d 0x%X)", (i ? ";" : ""), bc.name.c_str(), bc.pmd.mdisp, bc.pmd.pdisp, bc.pmd.vdisp, bc.attributes);
+            }
+            line += ',';
+            appendCsvString(line, field.c_str());
+
+            line += ",\"";
+            for (UINT32 i = 0; i < methods; i++)
+                line.cat_sprnt((i ? " 0x%llX" : "0x%llX"), (UINT64) W::getEa(vft + ((ea_t) i * W::ptrSize)));
+            line += "\"\r\n";
+        }
+        file.write(line);
+
+        if (updateProgress(0, 1, row, rows))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+
+// Columnar binary. Each section is one pass over the rows; the index of a variable length section and the base
+// class names are spilled to temporary files during their data pass and appended after it. Returns TRUE if canceled.
+template <class W> static BOOL exportColumnar(ExportFile &file)
+{
+    const UINT32 PASSES = 4;
+    UINT32 rows = g_resultTable.size();
+    CIXHEADER header;
+    ZeroMemory(&header, sizeof(header));
+    memcpy(header.magic, CIX_MAGIC, sizeof(header.magic));
+    header.version = CIX_VERSION;
+    header.is64 = W::is64;
+    header.rows = rows;
+    file.write(&header, sizeof(header));
+    file.align();
+
+    // Start/end a section
+    auto begin = [&](CIX_SECTION id) { header.sections[id].offset = file.size(); };
+    auto end = [&](CIX_SECTION id) { header.sections[id].size = (file.size() - header.sections[id].offset); file.align(); };
+
+    // Append a spilled section
+    auto appendSection = [&](CIX_SECTION id, ExportFile &temp)
+    {
+        begin(id);
+        temp.appendTo(file);
+        end(id);
+    };
+
+    // Fixed size columns
+    begin(CS_VFT);
+    for (UINT32 row = 0; row < rows; row++)
+        file.put<UINT64>(g_resultTable.vft(row));
+    end(CS_VFT);
+
+    begin(CS_COL);
+    for (UINT32 row = 0; row < rows; row++)
+    {
+        file.put<UINT64>(W::getEa(g_resultTable.vft(row) - W::ptrSize));
+        if (updateProgress(0, PASSES, row, rows))
+            return TRUE;
+    }
+    end(CS_COL);
+
+    begin(CS_METHODS);
+    for (UINT32 row = 0; row < rows; row++)
+        file.put<UINT32>(g_resultTable.methods(row));
+    end(CS_METHODS);
+
+    begin(CS_FLAGS);
+    for (UINT32 row = 0; row < rows; row++)
+        file.put<UINT16>((UINT16) (g_resultTable.flags(row) & ~TBL_DIRTY));
+    end(CS_FLAGS);
+
+    // Class names
+    // A spill file that won't open fails the export like a write error would
+    ExportFile index;
+    if (!index.openTemp())
+    {
+        file.setError();
+        return FALSE;
+    }
+    begin(CS_TYPE_TEXT);
+    UINT64 position = 0;
+    for (UINT32 row = 0; row < rows; row++)
+    {
+        LPCSTR type = g_resultTable.type(row);
+        size_t size = (strlen(type) + 1);
+        index.put<UINT64>(position);
+        file.write(type, size);
+        position += size;
+        if (updateProgress(1, PASSES, row, rows))
+            return TRUE;
+    }
+    index.put<UINT64>(position);
+    end(CS_TYPE_TEXT);
+    appendSection(CS_TYPE_INDEX, index);
+
+    // Base classes
+    ExportFile names;
+    if (!index.openTemp() || !names.openTemp())
+    {
+        file.setError();
+        return FALSE;
+    }
+    qvector<RTTI::BASECLASS> bases;
+    begin(CS_BASES);
+    UINT64 record = 0, nameOffset = 0;
+    for (UINT32 row = 0; row < rows; row++)
+    {
+        index.put<UINT64>(record);
+        ea_t col = W::getEa(g_resultTable.vft(row) - W::ptrSize);
+        UINT32 baseCount = (col ? RTTI::getBaseClasses<W>(col, bases) : 0);
+        for (UINT32 i = 0; i < baseCount; i++)
+        {
+            const RTTI::BASECLASS &bc = bases[i];
+            CIXBASE cb = { nameOffset, bc.pmd.mdisp, bc.pmd.pdisp, bc.pmd.vdisp, bc.attributes, bc.numContainedBases, 0 };
+            file.put(cb);
+            names.write(bc.name.c_str(), (bc.name.length() + 1));
+            nameOffset += (bc.name.length() + 1);
+        }
+        record += baseCount;
+        if (updateProgress(2, PASSES, row, rows))
+            return TRUE;
+    }
+    index.put<UINT64>(record);
+    end(CS_BASES);
+    appendSection(CS_BASE_TEXT, names);
+    appendSection(CS_BASE_INDEX, index);
+
+    // Slot targets
+    if (!index.openTemp())
+    {
+        file.setError();
+        return FALSE;
+    }
+    begin(CS_SLOTS);
+    UINT64 slot = 0;
+    for (UINT32 row = 0; row < rows; row++)
+    {
+        index.put<UINT64>(slot);
+        ea_t vft = g_resultTable.vft(row);
+        UINT32 methods = g_resultTable.methods(row);
+        for (UINT32 i = 0; i < methods; i++)
+            file.put<UINT64>(W::getEa(vft + ((ea_t) i * W::ptrSize)));
+        slot += methods;
+        if (updateProgress(3, PASSES, row, rows))
+            return TRUE;
+    }
+    index.put<UINT64>(slot);
+    end(CS_SLOTS);
+    appendSection(CS_SLOT_INDEX, index);
+
+    file.rewriteHeader(&header, sizeof(header));
+    return FALSE;
+}
+
+
+static void exportResults()
+{
+    try
+    {
+        useStoredTable();
+        UINT32 rows = g_resultTable.size();
+        if (!rows)
+        {
+            msg("Class Informer: No stored result to export, run the plugin first.\n");
+            return;
+        }
+
+        LPCSTR path = ask_file(TRUE, "*.jsonl", "FILTER JSON Lines|*.jsonl|CSV|*.csv|Columnar binary|*.cix\nExport Class Informer vftable list");
+        if (!path)
+            return;
+        qstring outPath = path;
+
+        EXPORT_FORMAT format = EF_JSONL;
+        LPCSTR ext = strrchr(outPath.c_str(), '.');
+        if (ext && (_stricmp(ext, ".csv") == 0))
+            format = EF_CSV;
+        else
+        if (ext && (_stricmp(ext, ".cix") == 0))
+            format = EF_COLUMNAR;
+
+        ExportFile file;
+        if (!file.open(outPath.c_str()))
+        {
+            msg("** Class Informer: Failed to create export file \"%s\"! **\n", outPath.c_str());
+            return;
+        }
+
+        WaitBox::show("Class Informer", "Exporting..", "url(" QT_RES_PATH "progress-style.qss)", QT_RES_PATH "icon.png");
+        WaitBox::updateAndCancelCheck(-1);
+        TIMESTAMP startTime = GetTimeStamp();
+        BOOL canceled;
+        if (format == EF_COLUMNAR)
+            canceled = (inf_is_64bit() ? exportColumnar<RTTI::PTR64>(file) : exportColumnar<RTTI::PTR32>(file));
+        else
+            canceled = (inf_is_64bit() ? exportText<RTTI::PTR64>(file, format) : exportText<RTTI::PTR32>(file, format));
+        UINT64 size = file.size();
+        BOOL written = file.close();
+        WaitBox::hide();
+
+        if (canceled || !written)
+        {
+            qunlink(outPath.c_str());
+            if (canceled)
+                msg("Class Informer: Export canceled.\n");
+            else
+                msg("** Class Informer: Failed writing export file \"%s\"! **\n", outPath.c_str());
+        }
+        else
+        {
+            char buffer[32];
+            msg("Class Informer: Exported %s vftables to \"%s\", %s in %s.\n", NumberCommaString(rows, buffer), outPath.c_str(), byteSizeString(size), TimeString(GetTimeStamp() - startTime));
+        }
+    }
+    CATCH()
+}
+
+
+struct export_handler_t: public action_handler_t
+{
+    virtual int idaapi activate(action_activation_ctx_t *ctx)
+    {
+        exportResults();
+        return 0;
+    }
+
+    virtual action_state_t idaapi update(action_update_ctx_t *ctx) { return AST_ENABLE_FOR_IDB; }
+};
+static export_handler_t exportHandler;
+
+void registerExportAction()
+{
+    const action_desc_t desc = ACTION_DESC_LITERAL(EXPORT_ACTION_NAME, "Class Informer vftable list...", &exportHandler, NULL, "Export the Class Informer vftable list as JSON Lines, CSV or columnar binary", -1);
+    if (register_action(desc))
+        attach_action_to_menu(EXPORT_MENU_PATH, EXPORT_ACTION_NAME, SETMENU_APP);
+}
+
+void unregisterExportAction()
+{
+    detach_action_from_menu(EXPORT_MENU_PATH, EXPORT_ACTION_NAME);
+    unregister_action(EXPORT_ACTION_NAME);
+}
@@ -0,0 +1,8 @@
+// Vftable result export
+#pragma once
+
+// Streams the stored vftable list to a file as JSON Lines, CSV or a memory mappable columnar binary, picked by
+// the file extension. Rows are written as they are read so memory use stays constant for any row count.
+// Registered as a "File/Produce file" menu action.
+void registerExportAction();
+void unregisterExportAction();
@@ -3,47 +3,51 @@
 #include "Main.h"
 #include "Vftable.h"
 #include "RTTI.h"
+#include "RttiStore.h"
+#include "RttiNameIndex.h"
+#include "ResultTable.h"
+#include "ClassSearch.h"
+#include "ResultCache.h"
+#include "Export.h"
+#include "ClassDbView.h"
+#include "ClassView.h"
+#include "ClassTree.h"
+#include "ScanWorker.h"
+#include "BytePattern.h"
 #include "MainDialog.h"
 #include <map>
+#include <unordered_map>
 //
 #include <WaitBoxEx.h>
 #include <IdaOgg.h>
 
 // Netnode constants
 const static char NETNODE_NAME[] = {"$ClassInformer_node"};
-const char NN_DATA_TAG  = 'A';
-const char NN_TABLE_TAG = 'S';
+const char NN_DATA_TAG   = 'A';
+const char NN_TABLE_TAG  = 'S';  // Pre 7.0 format per row supvals, only deleted now
+const char NN_TYPE_TAG   = 'T';  // Cached RTTI type IDs, kept apart so they survive a table reset
+const char NN_RESULT_TAG[2] = { 'R', 'r' };  // ResultTable blob, double buffered
+const char NN_PRINT_TAG  = 'F';  // Scanned segment fingerprints
 
 // Our netnode value indexes
 enum NETINDX
 {
     NIDX_VERSION,   // ClassInformer version
-    NIDX_COUNT      // Table entry count
+    NIDX_SLOT,      // Active NN_RESULT_TAG[] blob
 };
 
-// VFTable entry container (fits in a netnode MAXSPECSIZE size)
-#pragma pack(push, 1)
-struct TBLENTRY
-{
-    ea_t vft;
-    WORD methods;
-    WORD flags;
-    WORD strSize;
-    char str[MAXSPECSIZE - (sizeof(ea_t) + (sizeof(WORD) * 3))]; // Note: IDA MAXSTR = 1024
-};
-#pragma pack(pop)
-static_assert(sizeof(TBLENTRY) == MAXSPECSIZE);
-
-// Line background color for non parent/top level hierarchy lines
-// TOOD: Assumes text background is white. A way to make these user theme/style color aware?
-#define GRAY(v) RGB(v,v,v)
-static const bgcolor_t NOT_PARENT_COLOR = GRAY(235);
-
 // === Function Prototypes ===
 static void cacheSegments();
 static BOOL processStaticTables();
 static void showEndStats();
-static BOOL gatherRttiDataSet(SegSelect::segments &segs);
+static BOOL gatherKnownTypes();
+static BOOL startScan(SegSelect::segments &segs);
+static void endScan(BOOL aborted, BOOL closing = FALSE);
+static void cancelScan(BOOL closing);
+static void showResultList(BOOL evenIfEmpty);
+static void trackTableEdits(BOOL enable);
+static void prepareSegmentScan(SegSelect::segments &segs, BOOL incremental);
+static BOOL isUnchangedSegment(const segment_t *seg);
 
 // === Data ===
 static TIMESTAMP s_startTime = 0;
@@ -54,24 +58,72 @@ static BOOL initResourcesOnce = FALSE;
 static int chooserIcon = 0;
 static netnode *netNode = NULL;
 static std::vector<SEGMENT> segmentCache;
-static eaList colList;
-
-extern eaSet superSet, colSet, vftSet;
 
-#define IN_SUPER(_addr) (superSet.find(_addr) != superSet.end())
+// Segment cache page table, two levels of 64KB pages keyed by the address offset from 'segmentPageBase'.
+// Each entry is the segment cache index + 1 of the only segment touching the page, zero for none, or
+// PAGE_MIXED for pages shared by more than one segment (resolved by binary search).
+static const UINT32 PAGE_SHIFT = 16;
+static const UINT32 PAGE_DIR_SHIFT = 16;
+static const UINT32 PAGE_DIR_LIMIT = 4096;
+static const UINT16 PAGE_MIXED = 0xFFFF;
+static ea_t segmentPageBase = 0;
+static std::vector<std::vector<UINT16>> segmentPageDir;
+static eaList colList;
+static ScanWorker scanWorker;
 
 // "_initterm*" Static ctor/dtor pattern container
 struct INITTERM_ARGPAT
 {
-	LPCSTR pattern;
+	BYTEPATTERN pattern;
 	UINT32 start, end;
 };
-std::vector<INITTERM_ARGPAT> initTermArgPatterns;
+
+// _initterm argument patterns, the fallback for when the argument decode fails
+// TODO: Add more patterns as they are located
+static constexpr INITTERM_ARGPAT initTermArgPatterns64[] =
+{
+    { "48 8D 15 ?? ?? ?? ?? 48 8D 0D", 3, 3 }  // lea rdx,s, lea rcx,e
+};
+static constexpr INITTERM_ARGPAT initTermArgPatterns32[] =
+{
+    { "68 ?? ?? ?? ?? 68", 6, 1 },         // push offset s, push offset e
+    { "B8 ?? ?? ?? ?? C7 04 24", 8, 1 },   // mov [esp+4+var_4], offset s, mov eax, offset e
+    { "68 ?? ?? ?? ?? B8", 6, 1 }          // mov eax, offset s, push offset e
+};
+static const INITTERM_ARGPAT *initTermArgPatterns = NULL;
+static PatternMatcher initTermArgMatcher;
 
 // Options
 BOOL g_optionPlaceStructs  = TRUE;
 BOOL g_optionProcessStatic = TRUE;
 BOOL g_optionAudioOnDone   = TRUE;
+BOOL g_optionResultCache   = TRUE;
+BOOL g_optionClassDb       = TRUE;
+
+// Queued name and comment edit
+enum ANNOTATION_KIND: BYTE
+{
+    AK_NAME,
+    AK_COMMENT,
+    AK_RPT_COMMENT,
+    AK_ANTERIOR
+};
+struct ANNOTATION
+{
+    ea_t ea;
+    UINT32 order;  // Queue order, the later edit wins
+    UINT32 text;   // Offset into 'annotationText'
+    BYTE kind;
+    BYTE ifNone;   // Only if the address has none at commit time
+};
+static std::vector<ANNOTATION> annotationQueue;
+static std::vector<char> annotationText;
+
+// Pending edit kinds by address for the has*() checks
+const BYTE PENDING_NAME     = (1 << 0);
+const BYTE PENDING_COMMENT  = (1 << 1);
+const BYTE PENDING_ANTERIOR = (1 << 2);
+static std::unordered_map<ea_t, BYTE> annotationPending;
 
 static void freeWorkingData()
 {
@@ -80,7 +132,12 @@ static void freeWorkingData()
         RTTI::freeWorkingData();
         colList.clear();
         segmentCache.clear();
-        initTermArgPatterns.clear();
+        segmentPageDir.clear();
+        initTermArgPatterns = NULL;
+        initTermArgMatcher.clear();
+        annotationQueue.clear();
+        annotationText.clear();
+        annotationPending.clear();
 
         if (netNode)
         {
@@ -98,6 +155,12 @@ plugmod_t* idaapi init()
     if(inf_get_procname(procName, sizeof(procName)) && (strncmp(procName, "metapc", IDAINFO_PROCNAME_SIZE) == 0))
 	{
 		GetModuleHandleEx((GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT | GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS), (LPCTSTR) &init, &myModuleHandle);
+        g_rttiNameIndex.hook();
+        trackTableEdits(TRUE);
+        registerExportAction();
+        registerClassDbAction();
+        registerClassViewAction();
+        registerClassTreeAction();
 		return PLUGIN_KEEP;
 	}
 
@@ -110,8 +173,15 @@ void idaapi term()
 {
 	try
 	{
+        cancelScan(TRUE);
 		OggPlay::endPlay();
 		freeWorkingData();
+        g_rttiNameIndex.unhook();
+        trackTableEdits(FALSE);
+        unregisterExportAction();
+        unregisterClassDbAction();
+        unregisterClassViewAction();
+        unregisterClassTreeAction();
 
 		if (initResourcesOnce)
 		{
@@ -129,42 +199,458 @@ void idaapi term()
 }
 
 
+// Result table loaded from the netnode blob for this database
+static BOOL resultTableLoaded = FALSE;
+static TIMESTAMP lastTableSave = 0;
+
 // Init new netnode storage
-#define DB_FORMAT_VERSION MAKEWORD(6, 0)
+#define DB_FORMAT_VERSION MAKEWORD(7, 0)
 static void newNetnodeStore()
 {
     // Kill any existing store data first
     netNode->altdel_all(NN_DATA_TAG);
     netNode->supdel_all(NN_TABLE_TAG);
+    netNode->delblob(0, NN_RESULT_TAG[0]);
+    netNode->delblob(0, NN_RESULT_TAG[1]);
+    netNode->delblob(0, NN_PRINT_TAG);
+    g_resultTable.clear();
+    resultTableLoaded = TRUE;
 
     // Init defaults
     netNode->altset_idx8(NIDX_VERSION, DB_FORMAT_VERSION, NN_DATA_TAG);
-    netNode->altset_idx8(NIDX_COUNT, 0, NN_DATA_TAG);
+    lastTableSave = GetTimeStamp();
 }
 
 static WORD getStoreVersion(){ return((WORD) netNode->altval_idx8(NIDX_VERSION, NN_DATA_TAG)); }
-static UINT32 getTableCount(){ return(netNode->altval_idx8(NIDX_COUNT, NN_DATA_TAG)); }
-static BOOL setTableCount(UINT32 count){ return(netNode->altset_idx8(NIDX_COUNT, count, NN_DATA_TAG)); }
-static BOOL getTableEntry(TBLENTRY &entry, UINT32 index){ return(netNode->supval(index, &entry, sizeof(TBLENTRY), NN_TABLE_TAG) > 0); }
-static BOOL setTableEntry(TBLENTRY &entry, UINT32 index){ return(netNode->supset(index, &entry, (offsetof(TBLENTRY, str) + entry.strSize), NN_TABLE_TAG)); }
+static UINT32 getTableCount(){ return(g_resultTable.size()); }
+
+// Load the stored result table with a single blob read, once per database
+void loadResultTable()
+{
+    if (!resultTableLoaded)
+    {
+        resultTableLoaded = TRUE;
+        netnode node(NETNODE_NAME);
+        bytevec_t blob;
+        if ((node == BADNODE) || ((WORD) node.altval_idx8(NIDX_VERSION, NN_DATA_TAG) != DB_FORMAT_VERSION) ||
+            (node.getblob(&blob, 0, NN_RESULT_TAG[node.altval_idx8(NIDX_SLOT, NN_DATA_TAG) & 1]) <= 0) || !g_resultTable.deserialize(blob))
+            g_resultTable.clear();
+    }
+}
+
+// Write the result table back as one blob if it changed.
+// The blob goes to the inactive slot first and the single slot index write makes it current, so a crash or abort
+// part way through leaves the last complete table in place.
+static void saveResultTable()
+{
+    if (resultTableLoaded && g_resultTable.isModified())
+    {
+        netnode node(NETNODE_NAME, SIZESTR(NETNODE_NAME), TRUE);
+        bytevec_t blob;
+        g_resultTable.serialize(blob);
+
+        UINT32 active = (UINT32) (node.altval_idx8(NIDX_SLOT, NN_DATA_TAG) & 1);
+        node.delblob(0, NN_RESULT_TAG[active ^ 1]);
+        if (node.setblob(blob.begin(), blob.size(), 0, NN_RESULT_TAG[active ^ 1]))
+        {
+            node.altset_idx8(NIDX_SLOT, (active ^ 1), NN_DATA_TAG);
+            node.delblob(0, NN_RESULT_TAG[active]);
+            g_resultTable.clearModified();
+        }
+        else
+            msg("** Failed to save the vftable result table! **\n");
+    }
+    lastTableSave = GetTimeStamp();
+}
+
+// Periodic save of the table during a scan
+static const TIMESTAMP TABLE_CHECKPOINT_TIME = (TIMESTAMP) 30.0;
+static void checkpointResultTable()
+{
+    if ((GetTimeStamp() - lastTableSave) >= TABLE_CHECKPOINT_TIME)
+        saveResultTable();
+}
+
+static void unloadResultTable()
+{
+    g_resultTable.clear();
+    g_classSearch.clear();
+    resultTableLoaded = FALSE;
+}
+
+// Cached RTTI type ID access, zero if none
+nodeidx_t getCachedTypeValue(UINT32 index){ return(netNode ? netNode->altval_idx8(index, NN_TYPE_TAG) : 0); }
+void setCachedTypeValue(UINT32 index, nodeidx_t value){ if (netNode) netNode->altset_idx8(index, value, NN_TYPE_TAG); }
+
+// Row addTableEntry() writes over instead of appending, for the revalidation of a stored row
+static UINT32 replaceRow = (UINT32) -1;
+static BOOL rowReplaced = FALSE;
 
 // Add an entry to the vftable list
-void addTableEntry(UINT32 flags, ea_t vft, int methodCount, LPCSTR format, ...)
-{
-	TBLENTRY e;
-	e.vft = vft;
-	e.methods = methodCount;
-	e.flags = flags;
-
-	va_list vl;
-	va_start(vl, format);
-	vsnprintf_s(e.str, sizeof(e.str), SIZESTR(e.str), format, vl);
-	va_end(vl);
-	e.strSize = (WORD) (strlen(e.str) + 1);
-
-	UINT32 count = getTableCount();
-	setTableEntry(e, count);
-	setTableCount(++count);
+void addTableEntry(UINT32 flags, ea_t vft, int methodCount, LPCSTR type, LPCSTR hierarchy)
+{
+    if (replaceRow != (UINT32) -1)
+    {
+        g_resultTable.set(replaceRow, vft, methodCount, (WORD) flags, type, hierarchy);
+        rowReplaced = TRUE;
+        return;
+    }
+
+    g_resultTable.add(vft, methodCount, (WORD) flags, type, hierarchy);
+}
+
+// ================================================================================================
+
+// Stored table change tracking.
+// IDB edits over a stored vftable (rename, undefine, re-create, patch) mark its row dirty through an address interval
+// index of the row extents. Dirty rows are revalidated the next time the stored result is used, so the list stays
+// current without a rescan.
+struct ROWSPAN
+{
+    ea_t start, end;  // COL pointer through the last method pointer
+    UINT32 row;
+};
+
+class TableTracker: public event_listener_t
+{
+public:
+    void hook() { if (!m_hooked) m_hooked = hook_event_listener(HT_IDB, this, NULL); }
+    void unhook()
+    {
+        if (m_hooked)
+        {
+            unhook_event_listener(HT_IDB, this);
+            m_hooked = FALSE;
+        }
+        reset();
+    }
+
+    // Drop the index, it gets rebuilt from the stored table on the next edit
+    void reset()
+    {
+        m_spans.clear();
+        m_maxEnd.clear();
+        m_built = FALSE;
+    }
+
+    // Our own edits during a scan or revalidation are not user changes
+    void suspend(BOOL state) { m_suspended = state; }
+
+    virtual ssize_t idaapi on_event(ssize_t code, va_list va);
+
+private:
+    void build();
+    void markRange(ea_t start, ea_t end);
+    void moveRange(ea_t from, ea_t to, asize_t size);
+
+    std::vector<ROWSPAN> m_spans;  // Sorted by start
+    std::vector<ea_t> m_maxEnd;    // Running max of 'end' for the interval queries
+    BOOL m_hooked = FALSE;
+    BOOL m_built = FALSE;
+    BOOL m_suspended = FALSE;
+};
+static TableTracker tableTracker;
+
+static void trackTableEdits(BOOL enable)
+{
+    if (enable)
+        tableTracker.hook();
+    else
+        tableTracker.unhook();
+}
+
+void TableTracker::build()
+{
+    reset();
+    m_built = TRUE;
+    loadResultTable();
+    UINT32 count = g_resultTable.size();
+    if (!count)
+        return;
+
+    UINT32 ptrSize = (inf_is_64bit() ? sizeof(UINT64) : sizeof(UINT32));
+    m_spans.reserve(count);
+    for (UINT32 i = 0; i < count; i++)
+    {
+        ea_t vft = g_resultTable.vft(i);
+        m_spans.push_back({ (vft - ptrSize), (vft + ((ea_t) g_resultTable.methods(i) * ptrSize)), i });
+    }
+
+    std::sort(m_spans.begin(), m_spans.end(), [](const ROWSPAN &a, const ROWSPAN &b) { return(a.start < b.start); });
+    m_maxEnd.resize(m_spans.size());
+    ea_t maxEnd = 0;
+    for (size_t i = 0; i < m_spans.size(); i++)
+        m_maxEnd[i] = maxEnd = std::max(maxEnd, m_spans[i].end);
+}
+
+// Flag the stored rows overlapping the range as dirty
+void TableTracker::markRange(ea_t start, ea_t end)
+{
+    if (!m_built)
+        build();
+
+    // Walk back from the last span starting before the range end while any earlier span could still reach it
+    auto it = std::lower_bound(m_spans.begin(), m_spans.end(), end, [](const ROWSPAN &s, ea_t ea) { return(s.start < ea); });
+    for (size_t i = (size_t) (it - m_spans.begin()); (i > 0) && (m_maxEnd[i - 1] > start); i--)
+    {
+        const ROWSPAN &s = m_spans[i - 1];
+        WORD flags = g_resultTable.flags(s.row);
+        if ((s.end > start) && !(flags & TBL_DIRTY))
+            g_resultTable.setFlags(s.row, (flags | TBL_DIRTY));
+    }
+}
+
+// Segment moved, rebase the stored rows in it and flag them for revalidation
+void TableTracker::moveRange(ea_t from, ea_t to, asize_t size)
+{
+    if (from == to)
+        return;
+
+    loadResultTable();
+    UINT32 count = g_resultTable.size();
+    for (UINT32 i = 0; i < count; i++)
+    {
+        ea_t vft = g_resultTable.vft(i);
+        if ((vft >= from) && (vft < (from + size)))
+        {
+            g_resultTable.setVft(i, ((vft - from) + to));
+            g_resultTable.setFlags(i, (g_resultTable.flags(i) | TBL_DIRTY));
+        }
+    }
+    reset();
+}
+
+ssize_t idaapi TableTracker::on_event(ssize_t code, va_list va)
+{
+    // A scan still running ends with the database
+    if (code == idb_event::closebase)
+        cancelScan(TRUE);
+
+    if (m_suspended)
+        return 0;
+
+    try
+    {
+        switch (code)
+        {
+            case idb_event::renamed:
+            {
+                ea_t ea = va_arg(va, ea_t);
+                markRange(ea, (ea + 1));
+            }
+            break;
+
+            case idb_event::make_data:
+            {
+                ea_t ea = va_arg(va, ea_t);
+                va_arg(va, flags64_t);
+                va_arg(va, tid_t);
+                asize_t len = va_arg(va, asize_t);
+                markRange(ea, (ea + (len ? len : 1)));
+            }
+            break;
+
+            case idb_event::make_code:
+            {
+                const insn_t *insn = va_arg(va, const insn_t *);
+                markRange(insn->ea, (insn->ea + (insn->size ? insn->size : 1)));
+            }
+            break;
+
+            case idb_event::destroyed_items:
+            {
+                ea_t ea1 = va_arg(va, ea_t);
+                ea_t ea2 = va_arg(va, ea_t);
+                markRange(ea1, ea2);
+            }
+            break;
+
+            case idb_event::byte_patched:
+            {
+                ea_t ea = va_arg(va, ea_t);
+                markRange(ea, (ea + 1));
+            }
+            break;
+
+            case idb_event::segm_deleted:
+            {
+                ea_t startEa = va_arg(va, ea_t);
+                ea_t endEa = va_arg(va, ea_t);
+                markRange(startEa, endEa);
+            }
+            break;
+
+            case idb_event::segm_moved:
+            {
+                ea_t from = va_arg(va, ea_t);
+                ea_t to = va_arg(va, ea_t);
+                asize_t size = va_arg(va, asize_t);
+                moveRange(from, to, size);
+            }
+            break;
+
+            case idb_event::allsegs_moved:
+            {
+                const segm_move_infos_t *infos = va_arg(va, const segm_move_infos_t *);
+                for (const segm_move_info_t &mi: *infos)
+                    moveRange(mi.from, mi.to, mi.size);
+            }
+            break;
+
+            // Table edits are kept in memory until the database is saved
+            case idb_event::savebase:
+                saveResultTable();
+                break;
+
+            case idb_event::closebase:
+                reset();
+                unloadResultTable();
+                break;
+        };
+    }
+    CATCH()
+    return 0;
+}
+
+// Recompute the dirty rows of the stored table in place, placing their RTTI structures and dropping the ones no
+// longer a valid vftable. Returns the number of rows revalidated.
+template <class W> static UINT32 revalidateRows(__out UINT32 &dropped)
+{
+    dropped = 0;
+    UINT32 revalidated = 0;
+    UINT32 count = getTableCount();
+    std::vector<BYTE> drop;
+
+    tableTracker.suspend(TRUE);
+
+    // Place the COL structures first, as a scan does, an imported result has none yet
+    for (UINT32 i = 0; i < count; i++)
+    {
+        ea_t col;
+        if ((g_resultTable.flags(i) & TBL_DIRTY) && getVerifyEa<W>((g_resultTable.vft(i) - W::ptrSize), col) && RTTI::_RTTICompleteObjectLocator::isValid<W>(col))
+            RTTI::_RTTICompleteObjectLocator::tryStruct<W>(col);
+    }
+    UINT32 objects, runs, creates;
+    RTTI::flushPlacements(objects, runs, creates);
+
+    for (UINT32 i = 0; i < count; i++)
+    {
+        if (!(g_resultTable.flags(i) & TBL_DIRTY))
+            continue;
+
+        // Rerun the vftable processing for the row, with addTableEntry() writing over it
+        ea_t vft = g_resultTable.vft(i), col;
+        replaceRow = i, rowReplaced = FALSE;
+        if (getVerifyEa<W>((vft - W::ptrSize), col) && RTTI::_RTTICompleteObjectLocator::isValid<W>(col))
+            RTTI::processVftable<W>(vft, col, TRUE);
+        replaceRow = (UINT32) -1;
+
+        if (!rowReplaced)
+        {
+            drop.resize(count);
+            drop[i] = TRUE;
+            dropped++;
+        }
+        revalidated++;
+    }
+    RTTI::flushPlacements(objects, runs, creates);
+    commitAnnotations("Revalidate");
+
+    // Compact the table over any dropped rows
+    if (dropped)
+        g_resultTable.remove(drop);
+    saveResultTable();
+
+    tableTracker.suspend(FALSE);
+    tableTracker.reset();
+    return revalidated;
+}
+
+
+// Add RTTI type definitions to IDA once per session
+static void addDefinitionsOnce()
+{
+    static BOOL createStructsOnce = FALSE;
+    if (g_optionPlaceStructs && !createStructsOnce)
+    {
+        createStructsOnce = TRUE;
+        RTTI::addDefinitionsToIda();
+    }
+}
+
+// Load the stored result table for use outside of a scan, bringing the rows edited in the IDB since up to date
+void useStoredTable()
+{
+    loadResultTable();
+
+    // A running scan owns the working data, its rows get revalidated the next time around
+    if (scanWorker.isRunning())
+        return;
+
+    UINT32 count = getTableCount(), dirty = 0;
+    for (UINT32 i = 0; (i < count) && !dirty; i++)
+        dirty = (g_resultTable.flags(i) & TBL_DIRTY);
+    if (!dirty)
+        return;
+
+    plat.Configure();
+    addDefinitionsOnce();
+    cacheSegments();
+
+    UINT32 dropped;
+    if (UINT32 revalidated = (plat.is64 ? revalidateRows<RTTI::PTR64>(dropped) : revalidateRows<RTTI::PTR32>(dropped)))
+    {
+        char buf1[32], buf2[32];
+        msg("Revalidated %s edited vftable rows, %s no longer valid.\n", NumberCommaString(revalidated, buf1), NumberCommaString(dropped, buf2));
+        refresh_idaview_anyway();
+    }
+    RTTI::freeWorkingData();
+}
+
+// Quick check of a sample of the rows spread over the table for a valid COL before the vftable
+template <class W> static BOOL spotCheckRows()
+{
+    const UINT32 SAMPLES = 32;
+    UINT32 count = g_resultTable.size();
+    UINT32 step = std::max((count / SAMPLES), (UINT32) 1);
+    for (UINT32 i = 0; i < count; i += step)
+    {
+        ea_t col;
+        if (!getVerifyEa<W>((g_resultTable.vft(i) - W::ptrSize), col) || !RTTI::_RTTICompleteObjectLocator::isValid<W>(col))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+// Offer to import the user cache result for the input file, if any. Returns TRUE if imported.
+// The rows are flagged dirty so the stored result revalidation applies them to the IDB.
+static BOOL importCachedResult()
+{
+    qstring path;
+    if (!findCachedResult(path) || (ask_yn(1, "TITLE Class Informer \nHIDECANCEL\nFound a cached result for this input file.\nImport it instead of scanning?        ") != 1))
+        return FALSE;
+
+    newNetnodeStore();
+    if (!loadCachedResult(path.c_str(), g_resultTable))
+    {
+        msg("* Result cache file \"%s\" doesn't match this IDB, must scan *\n", path.c_str());
+        return FALSE;
+    }
+
+    if (!(plat.is64 ? spotCheckRows<RTTI::PTR64>() : spotCheckRows<RTTI::PTR32>()))
+    {
+        msg("* Cached result failed validation, must scan *\n");
+        g_resultTable.clear();
+        return FALSE;
+    }
+
+    UINT32 count = g_resultTable.size();
+    for (UINT32 i = 0; i < count; i++)
+        g_resultTable.setFlags(i, (g_resultTable.flags(i) | TBL_DIRTY));
+
+    char buffer[32];
+    msg("Importing %s vftables from the result cache.\n", NumberCommaString(count, buffer));
+    return TRUE;
 }
 
 
@@ -186,18 +672,6 @@ class rtti_chooser : public chooser_multi_t
 public:
 	rtti_chooser() : chooser_multi_t(CH_QFTYP_DEFAULT, LBCOLUMNCOUNT, LBWIDTHS, LBHEADER, LBTITLE)
 	{
-		// Create a minimal hex address format string w/leading zero
-		UINT32 count = getTableCount();
-		ea_t largestAddres = 0;
-		for (UINT32 i = 0; i < count; i++)
-		{
-			TBLENTRY e; e.vft = 0;
-			getTableEntry(e, i);
-			if (e.vft > largestAddres)
-				largestAddres = e.vft;
-		}
-        GetEaFormatString(largestAddres, addressFormat);
-
 		// Chooser icon
 		icon = chooserIcon;
 	}
@@ -214,58 +688,22 @@ public:
 	{
 		try
 		{
-			if (netNode)
+			if (n < get_count())
 			{
-				// Generate the line
-				TBLENTRY e;
-				getTableEntry(e, (UINT32)n);
+				if (cacheGeneration != g_resultTable.generation())
+					buildCells();
 
-				// vft address
+				// Copy the preformatted cells
 				qstrvec_t &cols = *cols_;
-				cols[0].sprnt(addressFormat, e.vft);
-
-				// Method count
-				if (e.methods > 0)
-					cols[1].sprnt("%u", e.methods); // "%04u"
-				else
-					cols[1].sprnt("???");
-
-				// Flags
-				char flags[4];
-				int pos = 0;
-				if (e.flags & RTTI::CHD_MULTINH)   flags[pos++] = 'M';
-				if (e.flags & RTTI::CHD_VIRTINH)   flags[pos++] = 'V';
-				if (e.flags & RTTI::CHD_AMBIGUOUS) flags[pos++] = 'A';
-				flags[pos++] = 0;
-				cols[2] = flags;
-
-				// Type
-				LPCSTR tag = strchr(e.str, '@');
-				if (tag)
-				{
-					char buffer[MAXSTR];
-					int pos = (tag - e.str);
-					if (pos > SIZESTR(buffer)) pos = SIZESTR(buffer);
-					memcpy(buffer, e.str, pos);
-					buffer[pos] = 0;
-					cols[3] = buffer;
-					++tag;
-				}
-				else
-				{
-					// Can happen when string is MAXSTR and greater
-					cols[3] = "??** MAXSTR overflow!";
-					tag = e.str;
-				}
-
-				// Composition/hierarchy
-				cols[4] = tag;
+				const UINT32 *cell = &cells[n * LBCOLUMNCOUNT];
+				for (UINT32 i = 0; i < LBCOLUMNCOUNT; i++)
+					cols[i] = &cellText[cell[i]];
 
-				//*icon_ = ((e.flags & RTTI::IS_TOP_LEVEL) ? 77 : 191);
+				//*icon_ = ((rowFlags & RTTI::IS_TOP_LEVEL) ? 77 : 191);
 				*icon_ = 191;
 
 				// Indicate entry is not a top/parent level by color
-				if (!(e.flags & RTTI::IS_TOP_LEVEL))
+				if (!(g_resultTable.flags((UINT32) n) & RTTI::IS_TOP_LEVEL))
 					attributes->color = NOT_PARENT_COLOR;
 			}
 		}
@@ -276,21 +714,118 @@ public:
 	{
 		size_t n = sel->front();
 		if (n < get_count())
+			jumpto(g_resultTable.vft((UINT32) n));
+		return NOTHING_CHANGED;
+	}
+
+	// Ctrl+U, and refresh_chooser()
+	virtual cbres_t refresh(sizevec_t *sel)
+	{
+		try
 		{
-			TBLENTRY e;
-			getTableEntry(e, (UINT32)n);
-			jumpto(e.vft);
+			useStoredTable();
 		}
-		return NOTHING_CHANGED;
+		CATCH()
+		return ALL_CHANGED;
 	}
 
 	virtual void closed()
 	{
-		freeWorkingData();
+		// A running scan still needs it
+		if (!scanWorker.isRunning())
+			freeWorkingData();
 	}
 
 private:
-	char addressFormat[20];
+	// Format every row's cells once into the text pool so scrolling only copies strings.
+	// While a scan streams rows in, only the appended ones get formatted, unless the address column got wider.
+	// Rows with just changed flags get their flags cell formatted again, the old text stays in the pool until the
+	// next full rebuild.
+	void buildCells() const
+	{
+		// Create a minimal hex address format string w/leading zero
+		char addressFormat[20];
+		GetEaFormatString(g_resultTable.maxVft(), addressFormat);
+
+		UINT32 count = getTableCount();
+		UINT32 first = 0;
+		BOOL incremental = ((cacheEditGeneration == g_resultTable.editGeneration()) && (cacheRows <= count) && (strcmp(addressFormat, cacheFormat) == 0));
+		if (incremental)
+			first = cacheRows;
+		else
+		{
+			cellText.clear();
+			cellText.reserve((size_t) count * 64);
+		}
+		cells.resize((size_t) count * LBCOLUMNCOUNT);
+		qstring text;
+		auto addCell = [&](UINT32 row, UINT32 column, LPCSTR str, size_t len)
+		{
+			cells[(row * LBCOLUMNCOUNT) + column] = (UINT32) cellText.size();
+			cellText.insert(cellText.end(), str, (str + len + 1));
+		};
+		auto addFlags = [&](UINT32 row)
+		{
+			WORD rowFlags = g_resultTable.flags(row);
+			char buffer[4];
+			size_t len = 0;
+			if (rowFlags & RTTI::CHD_MULTINH)   buffer[len++] = 'M';
+			if (rowFlags & RTTI::CHD_VIRTINH)   buffer[len++] = 'V';
+			if (rowFlags & RTTI::CHD_AMBIGUOUS) buffer[len++] = 'A';
+			buffer[len] = 0;
+			addCell(row, 2, buffer, len);
+		};
+
+		if (incremental)
+		{
+			for (UINT32 i = cacheFlagChanges, changes = g_resultTable.flagChangeCount(); i < changes; i++)
+			{
+				UINT32 row = g_resultTable.flagChangeRow(i);
+				if (row < first)
+					addFlags(row);
+			}
+		}
+
+		for (UINT32 row = first; row < count; row++)
+		{
+			// vft address
+			char buffer[32];
+			int len = _snprintf_s(buffer, sizeof(buffer), SIZESTR(buffer), addressFormat, g_resultTable.vft(row));
+			addCell(row, 0, buffer, len);
+
+			// Method count
+			if (UINT32 methods = g_resultTable.methods(row))
+				len = _snprintf_s(buffer, sizeof(buffer), SIZESTR(buffer), "%u", methods); // "%04u"
+			else
+				len = (int) strlen(strcpy(buffer, "???"));
+			addCell(row, 1, buffer, len);
+
+			// Flags
+			addFlags(row);
+
+			// Type
+			LPCSTR type = g_resultTable.type(row);
+			addCell(row, 3, type, strlen(type));
+
+			// Composition/hierarchy
+			g_resultTable.getHierarchy(row, text);
+			addCell(row, 4, text.c_str(), text.length());
+		}
+		cacheGeneration = g_resultTable.generation();
+		cacheEditGeneration = g_resultTable.editGeneration();
+		cacheFlagChanges = g_resultTable.flagChangeCount();
+		cacheRows = count;
+		strcpy(cacheFormat, addressFormat);
+	}
+
+	// Cell text pool and the per row column offsets into it
+	mutable std::vector<char> cellText;
+	mutable std::vector<UINT32> cells;
+	mutable UINT32 cacheGeneration = (UINT32) -1;
+	mutable UINT32 cacheEditGeneration = (UINT32) -1;
+	mutable UINT32 cacheRows = 0;
+	mutable UINT32 cacheFlagChanges = 0;
+	mutable char cacheFormat[20] = { 0 };
 };
 
 
@@ -336,10 +871,8 @@ void customizeChooseWindow()
             tv->resizeColumnsToContents();
             tv->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
 
-            // Tweak the row height
-            UINT32 count = getTableCount();
-            for (UINT32 row = 0; row < count; row++)
-                tv->setRowHeight(row, 24);
+            // Tweak the row height, the default so it applies to the rows streamed in during a scan too
+            tv->verticalHeader()->setDefaultSectionSize(24);
         }
         else
             msg("** customizeChooseWindow(): \"tchooser_table_widget_t\" not found!\n");
@@ -361,6 +894,14 @@ bool idaapi run(size_t arg)
 		}
         WaitBox::processIdaEvents();
 
+        // One scan at the time
+        if (scanWorker.isRunning())
+        {
+            if (ask_yn(ASKBTN_NO, "TITLE Class Informer\nHIDECANCEL\nA scan is still running in the background.\n\nCancel it?") == ASKBTN_YES)
+                cancelScan(FALSE);
+            return TRUE;
+        }
+
         // Configure platform specifics
         plat.Configure();
 
@@ -382,6 +923,8 @@ bool idaapi run(size_t arg)
         g_optionAudioOnDone   = TRUE;
         g_optionProcessStatic = TRUE;
         g_optionPlaceStructs  = TRUE;
+        g_optionResultCache   = TRUE;
+        g_optionClassDb       = TRUE;
         startingFuncCount   = (UINT32) get_func_qty();
         staticCppCtorCnt = staticCCtorCnt = staticCtorDtorCnt = staticCDtorCnt = 0;
         colList.clear();
@@ -394,27 +937,37 @@ bool idaapi run(size_t arg)
         }
 
 		// Read existing storage if any
-        UINT32 tableCount   = getTableCount();
         WORD storageVersion = getStoreVersion();
-        BOOL storageExists  = (tableCount > 0);
+        BOOL storageExists  = FALSE;
+        BOOL incremental    = FALSE;
 
         // Ask if we should use storage or process again
-		if (storageExists)
+		if (storageVersion != DB_FORMAT_VERSION)
 		{
-			// Version 2.3 didn't change the format
-			if (storageVersion != DB_FORMAT_VERSION)
-			{
+			if (storageVersion)
 				msg("* Storage version mismatch, must rescan *\n");
-                storageExists = FALSE;
-			}
-			else
-				storageExists = (ask_yn(1, "TITLE Class Informer \nHIDECANCEL\nUse previously stored result?        ") == 1);
+		}
+		else
+		{
+            loadResultTable();
+            if (getTableCount() > 0)
+            {
+                // Use it as is, rescan only the segments changed since, or start over
+                int choice = ask_buttons("~U~se stored", "~R~escan changed", "~F~ull rescan", ASKBTN_YES, "TITLE Class Informer \nUse previously stored result?        \n\nOr rescan just the segments that changed since, or all of them.");
+                storageExists = (choice == ASKBTN_YES);
+                incremental   = (choice == ASKBTN_NO);
+            }
 		}
 
+        // With no stored result, one cached from another IDB of the same input file can be imported instead of scanning
+        if (!storageExists && !incremental && (getTableCount() == 0))
+            storageExists = importCachedResult();
+
         BOOL aborted = FALSE;
         if(!storageExists)
         {
-            newNetnodeStore();
+            if (!incremental)
+                newNetnodeStore();
 
             // Only MS Visual C++ targets are known
             comp_t cmp = get_comp(default_compiler());
@@ -431,30 +984,27 @@ bool idaapi run(size_t arg)
 
             // Do UI
 			SegSelect::segments segs;
-            if (doMainDialog(g_optionPlaceStructs, g_optionProcessStatic, g_optionAudioOnDone, segs, version, arg))
+            if (doMainDialog(g_optionPlaceStructs, g_optionProcessStatic, g_optionAudioOnDone, g_optionResultCache, g_optionClassDb, segs, version, arg))
             {
                 msg("- Canceled -\n\n");
 				freeWorkingData();
                 return TRUE;
             }
 
+            tableTracker.suspend(TRUE);
             WaitBox::show("Class Informer", "Please wait..", "url(" QT_RES_PATH "progress-style.qss)", QT_RES_PATH "icon.png");
             WaitBox::updateAndCancelCheck(-1);
             s_startTime = GetTimeStamp();
 
+            BOOL started = FALSE;
 			try
 			{
-                // Add RTTI type definitions to IDA once per session
-                static BOOL createStructsOnce = FALSE;
-                if (g_optionPlaceStructs && !createStructsOnce)
-                {
-                    createStructsOnce = TRUE;
-                    RTTI::addDefinitionsToIda();
-                }
+                addDefinitionsOnce();
 
                 msg("Caching data and code segments:\n");
                 WaitBox::processIdaEvents();
                 cacheSegments();
+                prepareSegmentScan(segs, incremental);
 
                 if(g_optionProcessStatic)
                 {
@@ -462,63 +1012,60 @@ bool idaapi run(size_t arg)
                     msg("\nProcessing C/C++ ctor & dtor tables:\n");
 				    msg("-------------------------------------------------\n");
                     WaitBox::processIdaEvents();
-                    if (!(aborted = processStaticTables()))
+                    aborted = processStaticTables();
+                    commitAnnotations("Static tables");
+                    if (!aborted)
                     {
                         //msg("Processing time: %s.\n", TimeString(GetTimeStamp() - s_startTime));
                     }
                 }
 
-                if (!aborted)
-                {
-                    // Get RTTI data
-                    if (!(aborted = gatherRttiDataSet(segs)))
-                    {
-                        // Optionally play completion sound if processing took more than a few seconds to notify user
-                        if (g_optionAudioOnDone)
-                        {
-                            TIMESTAMP endTime = (GetTimeStamp() - s_startTime);
-                            if (endTime > (TIMESTAMP) 2.4)
-                            {
-                                OggPlay::endPlay();
-                                QFile file(QT_RES_PATH "completed.ogg");
-                                if (file.open(QFile::ReadOnly))
-                                {
-                                    QByteArray ba = file.readAll();
-                                    OggPlay::playFromMemory((const PVOID)ba.constData(), ba.size(), TRUE);
-                                }
-                            }
-                        }
-
-                        showEndStats();                       
-                    }
-                }
+                // Locate the types IDA and the PDB know of, then scan for the rest in the background
+                if (!aborted && !(aborted = gatherKnownTypes()))
+                    started = startScan(segs);
 			}
 			CATCH()
 
 			WaitBox::hide();
-            refresh_idaview_anyway();
-            if (aborted)
+            if (started)
             {
-                msg("- Aborted -\n\n");
-                return TRUE;
+                // The IDB is the user's again while the scan runs, user edits get tracked
+                tableTracker.suspend(FALSE);
+                tableTracker.reset();
             }
+            else
+                endScan(TRUE);
+            return TRUE;
         }
 
-        // Show list result window
-        if (!aborted && (getTableCount() > 0))
-        {
-			// The chooser allocation will free it's self automatically
-			rtti_chooser *chooserPtr = new rtti_chooser();
-			chooserPtr->choose();
-
-			customizeChooseWindow();
-        }
+        // Show list result window, it brings the rows edited since the scan up to date
+        showResultList(FALSE);
     }
 	CATCH()
 
 	return TRUE;
 }
 
+// Show the result list window, or refresh it if it's already open
+static void showResultList(BOOL evenIfEmpty)
+{
+    useStoredTable();
+    if (find_widget(LBTITLE))
+    {
+        refresh_chooser(LBTITLE);
+        customizeChooseWindow();
+    }
+    else
+    if (evenIfEmpty || (getTableCount() > 0))
+    {
+        // The chooser allocation will free it's self automatically
+        rtti_chooser *chooserPtr = new rtti_chooser();
+        chooserPtr->choose();
+
+        customizeChooseWindow();
+    }
+}
+
 // Print out end stats
 static void showEndStats()
 {
@@ -745,8 +1292,7 @@ static void processRegisterInitterm(ea_t start, ea_t end, ea_t call)
 
             msg("    %llX to %llX CTOR table.\n", start, end);
             setIntializerTable(start, end, TRUE);
-			if(!hasComment(call))
-				setComment(call, "_initterm", TRUE);
+			setCommentIfNone(call, "_initterm", TRUE);
         }
         else
             msg("  ** Bad address range of  %llX, %llX for \"_initterm\" type ** <click address>.\n", start, end);
@@ -812,12 +1358,175 @@ static UINT32 doInittermTable(func_t *func, ea_t start, ea_t end, LPCSTR name)
     return(found);
 }
 
-// Process _initterm function
-// Returns TRUE if at least one found
-static BOOL processInitterm(ea_t address, LPCSTR name)
+// x86 register numbers, same for the 64bit wide versions
+enum X86REG
 {
-    msg("%llX process initterm: \"%s\" \n", address, name);
-    UINT32 count = 0;
+    X86_AX = 0,
+    X86_CX = 1,
+    X86_DX = 2,
+    X86_SP = 4
+};
+
+// Return TRUE if operand is a [esp + displacement] stack slot, with the displacement
+static BOOL getStackSlotOperand(const op_t &op, __out ea_t &displacement)
+{
+    // ESP based addressing always has a SIB byte, IDA keeps it in 'specflag2' with 'specflag1' set
+    if (((op.type == o_phrase) || (op.type == o_displ)) && op.specflag1 && ((op.specflag2 & 7) == X86_SP) && (((op.specflag2 >> 3) & 7) == X86_SP))
+    {
+        displacement = ((op.type == o_displ) ? op.addr : 0);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+// Locate the _initterm() style table arguments of a call by decoding back from it.
+// Tracks where each argument comes from: the RCX/RDX registers on 64bit, the stack slots and EAX (the LTCG register
+// variant) on 32bit, following register to register moves, until it gets to a table address load.
+// Returns TRUE if both were located.
+static BOOL extractInittermArgs(ea_t call, const func_t *func, __out ea_t &start, __out ea_t &end)
+{
+    // Argument sources, in argument order; 32bit register arg goes last
+    const UINT32 MAX_BACK = 12, ARG_COUNT = 3;
+    struct ARG
+    {
+        int reg;      // Register the value is in, -1 if not (yet) in one
+        int slot;     // 32bit stack slot index, -1 if not a stack arg
+        ea_t value;
+    } args[ARG_COUNT];
+
+    UINT32 argCount;
+    if (plat.is64)
+    {
+        args[0] = { X86_CX, -1, BADADDR };
+        args[1] = { X86_DX, -1, BADADDR };
+        argCount = 2;
+    }
+    else
+    {
+        args[0] = { -1, 0, BADADDR };
+        args[1] = { -1, 1, BADADDR };
+        args[2] = { X86_AX, -1, BADADDR };
+        argCount = 3;
+    }
+
+    UINT32 pushes = 0;
+    ea_t ea = call;
+    insn_t insn;
+    for (UINT32 i = 0; i < MAX_BACK; i++)
+    {
+        ea = decode_prev_insn(&insn, ea);
+        if ((ea == BADADDR) || (func && (ea < func->start_ea)))
+            break;
+
+        // Past the previous call the registers and stack are something else's
+        UINT16 itype = insn.itype;
+        if ((itype == NN_call) || (itype == NN_callfi) || (itype == NN_callni))
+            break;
+
+        const op_t &op1 = insn.ops[0];
+        const op_t &op2 = insn.ops[1];
+
+        // Value a load instruction puts in its destination, BADADDR if not an address
+        ea_t loaded = BADADDR;
+        int loadedReg = -1;
+        if ((itype == NN_lea) && (op2.type == o_mem))
+            loaded = op2.addr;
+        else
+        if ((itype == NN_mov) && (op2.type == o_imm))
+            loaded = op2.value;
+        else
+        if ((itype == NN_mov) && (op2.type == o_reg))
+            loadedReg = op2.reg;
+
+        // 32bit stack slots
+        if (!plat.is64)
+        {
+            int slot = -1;
+            if (itype == NN_push)
+            {
+                // Pushes closer to the call got seen first and take the lower slots
+                slot = (int) pushes++;
+                if (op1.type == o_imm)
+                    loaded = op1.value;
+                else
+                if (op1.type == o_reg)
+                    loadedReg = op1.reg;
+            }
+            else
+            {
+                ea_t displacement;
+                if ((itype == NN_mov) && getStackSlotOperand(op1, displacement))
+                    slot = (int) ((displacement / sizeof(UINT32)) + pushes);
+            }
+
+            if (slot != -1)
+            {
+                for (UINT32 j = 0; j < argCount; j++)
+                {
+                    if ((args[j].slot == slot) && (args[j].reg == -1) && (args[j].value == BADADDR))
+                    {
+                        if (loaded != BADADDR)
+                            args[j].value = loaded;
+                        else
+                        if (loadedReg != -1)
+                            args[j].reg = loadedReg;
+                        else
+                            return FALSE;
+                    }
+                }
+                continue;
+            }
+        }
+
+        // Register writes
+        if (op1.type == o_reg)
+        {
+            for (UINT32 j = 0; j < argCount; j++)
+            {
+                if ((args[j].reg == op1.reg) && (args[j].value == BADADDR))
+                {
+                    if (loaded != BADADDR)
+                    {
+                        args[j].value = loaded;
+                        args[j].reg = -1;
+                    }
+                    else
+                    if (loadedReg != -1)
+                        args[j].reg = loadedReg;
+                    else
+                        args[j].reg = -2;  // Computed some other way, can't follow it
+                }
+            }
+        }
+
+        if ((args[0].value != BADADDR) && (args[1].value != BADADDR))
+            break;
+    }
+
+    // First two located arguments, table start and end are in argument order except for the 32bit register variants
+    ea_t values[2];
+    UINT32 located = 0;
+    for (UINT32 j = 0; (j < argCount) && (located < 2); j++)
+    {
+        if (args[j].value != BADADDR)
+            values[located++] = args[j].value;
+    }
+    if (located < 2)
+        return FALSE;
+
+    start = values[0];
+    end = values[1];
+    if (start > end)
+        swap_t(start, end);
+    return TRUE;
+}
+
+// Process _initterm function
+// Returns TRUE if at least one found
+static BOOL processInitterm(ea_t address, LPCSTR name)
+{
+    msg("%llX process initterm: \"%s\" \n", address, name);
+    UINT32 count = 0;
 
     // Walk xrefs
     ea_t xref = get_first_fcref_to(address);
@@ -830,6 +1539,17 @@ static BOOL processInitterm(ea_t address, LPCSTR name)
         {
             do
             {
+                // Decode the argument setup
+                func_t *func = get_func(xref);
+                ea_t start, end;
+                if (extractInittermArgs(xref, func, start, end))
+                {
+                    msg("   %llX Arguments decoded\n", xref);
+                    count += doInittermTable(func, start, end, name);
+                    break;
+                }
+
+                // Else fall back to the byte patterns
                 // The most common are two instruction arguments
                 // Back up two instructions
                 ea_t instruction1 = prev_head(xref, 0);
@@ -840,40 +1560,53 @@ static BOOL processInitterm(ea_t address, LPCSTR name)
                     break;
 
                 // Bail instructions are past the function start now
-                func_t *func = get_func(xref);
                 if (func && (instruction2 < func->start_ea))
                 {
                     //msg("    %llX arg2 outside of contained function **\n", func->start_ea);
                     break;
                 }
 
+                // All patterns in one pass over the two instructions, the first pattern in table order wins
                 BOOL matched = FALSE;
-                UINT32 patternCount = (UINT32) initTermArgPatterns.size();
-                for (UINT32 i = 0; (i < patternCount) && !matched; i++)
+                BYTE bytes[64];
+                size_t window = (size_t) (xref - instruction2);
+                size_t size = std::min(sizeof(bytes), (window + initTermArgMatcher.maxSize()));
+                ssize_t got = get_bytes(bytes, size, instruction2);
+                UINT32 best = UINT32_MAX;
+                size_t bestOffset = 0;
+                if (got > 0)
                 {
-					ea_t match = FIND_BINARY(instruction2, xref, initTermArgPatterns[i].pattern);
-					if (match != BADADDR)
-					{
-                        ea_t start, end;
-                        if (!plat.is64)
-                        {
-							start = plat.getEa32(match + initTermArgPatterns[i].start);
-							end = plat.getEa32(match + initTermArgPatterns[i].end);
-                        }
-                        else
-                        {
-							UINT32 startOffset = get_32bit(instruction1 + initTermArgPatterns[i].start);
-							UINT32 endOffset = get_32bit(instruction2 + initTermArgPatterns[i].end);
+                    initTermArgMatcher.scan(bytes, (size_t) got, [&](UINT32 index, size_t offset)
+                    {
+                        if ((offset < window) && (index < best))
+                            best = index, bestOffset = offset;
+                        return TRUE;
+                    });
+                }
 
-							start = (instruction1 + 7 + *((PINT32) &startOffset)); // TODO: 7 is hard coded instruction length, put this in arg2pat table?
-							end = (instruction2 + 7 + *((PINT32) &endOffset));
-                        }
+                if (best != UINT32_MAX)
+                {
+                    const INITTERM_ARGPAT &pe = initTermArgPatterns[best];
+					ea_t match = (instruction2 + bestOffset);
+                    if (!plat.is64)
+                    {
+						start = plat.getEa32(match + pe.start);
+						end = plat.getEa32(match + pe.end);
+                    }
+                    else
+                    {
+						UINT32 startOffset = get_32bit(instruction1 + pe.start);
+						UINT32 endOffset = get_32bit(instruction2 + pe.end);
+
+                        // RIP relative to the end of each instruction
+                        insn_t insn;
+						start = (instruction1 + decode_insn(&insn, instruction1) + *((PINT32) &startOffset));
+						end = (instruction2 + decode_insn(&insn, instruction2) + *((PINT32) &endOffset));
+                    }
 
-						msg("   %llX Two instruction pattern match #%d\n", match, i);
-						count += doInittermTable(func, start, end, name);
-						matched = TRUE;
-						break;
-					}
+					msg("   %llX Two instruction pattern match #%d\n", match, best);
+					count += doInittermTable(func, start, end, name);
+					matched = TRUE;
                 }
 
                 // 3 instruction
@@ -913,6 +1646,44 @@ static BOOL processInitterm(ea_t address, LPCSTR name)
 }
 
 
+// Build the segment cache page table
+static void buildSegmentPageTable()
+{
+    segmentPageDir.clear();
+    segmentPageBase = 0;
+    if (segmentCache.empty() || (segmentCache.size() >= PAGE_MIXED))
+        return;
+
+    segmentPageBase = (segmentCache.front().start & ~((ea_t(1) << PAGE_SHIFT) - 1));
+    UINT64 lastPage = ((UINT64) (segmentCache.back().end - segmentPageBase) >> PAGE_SHIFT);
+    UINT64 dirCount = ((lastPage >> PAGE_DIR_SHIFT) + 1);
+
+    // Sparse address space too wide to be worth it, lookups just use the binary search
+    if (dirCount > PAGE_DIR_LIMIT)
+    {
+        segmentPageBase = 0;
+        return;
+    }
+    segmentPageDir.resize((size_t) dirCount);
+
+    for (size_t i = 0; i < segmentCache.size(); i++)
+    {
+        const SEGMENT &seg = segmentCache[i];
+        UINT64 firstPage = ((UINT64) (seg.start - segmentPageBase) >> PAGE_SHIFT);
+        UINT64 endPage = ((UINT64) (seg.end - segmentPageBase) >> PAGE_SHIFT);
+
+        for (UINT64 page = firstPage; page <= endPage; page++)
+        {
+            std::vector<UINT16> &table = segmentPageDir[(size_t) (page >> PAGE_DIR_SHIFT)];
+            if (table.empty())
+                table.resize((size_t) 1 << PAGE_DIR_SHIFT, 0);
+
+            UINT16 &entry = table[(size_t) (page & ((1 << PAGE_DIR_SHIFT) - 1))];
+            entry = (entry ? PAGE_MIXED : (UINT16) (i + 1));
+        }
+    }
+}
+
 // Cache code and data segments for fast indexing
 static void cacheSegments()
 {
@@ -960,35 +1731,206 @@ static void cacheSegments()
 
     // Ensure sort by ascending address
 	std::sort(segmentCache.begin(), segmentCache.end(), [](const SEGMENT &a, const SEGMENT &b) { return a.start < b.start; });
+    buildSegmentPageTable();
 }
 
 // Segment cache O(log n) binary search lookup
+static const SEGMENT *searchCachedSegment(ea_t addr)
+{
+    // First segment starting above the address, the one before it is the candidate
+    auto it = std::upper_bound(segmentCache.begin(), segmentCache.end(), addr, [](ea_t addr, const SEGMENT &s) { return addr < s.start; });
+    if (it != segmentCache.begin())
+    {
+        const SEGMENT *seg = &*(--it);
+        if (addr <= seg->end)
+            return seg;
+    }
+
+    // Below all regions or in a gap between them
+    return NULL;
+}
+
+// Segment cache O(1) page table lookup
 const SEGMENT *FindCachedSegment(ea_t addr)
 {
-    int left = 0;
-    int right = (int) segmentCache.size();
+    if (!segmentPageDir.empty())
+    {
+        if (addr < segmentPageBase)
+            return NULL;
+
+        UINT64 page = ((UINT64) (addr - segmentPageBase) >> PAGE_SHIFT);
+        size_t dir = (size_t) (page >> PAGE_DIR_SHIFT);
+        if ((dir >= segmentPageDir.size()) || segmentPageDir[dir].empty())
+            return NULL;
+
+        UINT16 entry = segmentPageDir[dir][(size_t) (page & ((1 << PAGE_DIR_SHIFT) - 1))];
+        if (entry == 0)
+            return NULL;
+        if (entry != PAGE_MIXED)
+        {
+            // Sole segment on the page, but it may not cover the whole page
+            const SEGMENT *seg = &segmentCache[entry - 1];
+            return(((addr >= seg->start) && (addr <= seg->end)) ? seg : NULL);
+        }
+    }
+
+    return searchCachedSegment(addr);
+}
+
+// ================================================================================================
 
-    while (left != (right - 1))
+// PE COFF group info, section and subsection (I.E. ".CRT$XCA") name to image RVA and size.
+// Comes from the POGO debug directory entry the MSVC linker emits, so it's there for most modern PE files.
+typedef std::map<std::string, std::pair<UINT32, UINT32>> COFFGROUPS;
+static BOOL getCoffGroups(__out COFFGROUPS &groups)
+{
+    // PE headers from the IDB if IDA loaded them, else from the input file
+    ea_t imageBase = get_imagebase();
+    BYTE header[0x1000];
+    BOOL haveHeader = FALSE;
+    if (is_loaded(imageBase) && (get_word(imageBase) == IMAGE_DOS_SIGNATURE))
+        haveHeader = (get_bytes(header, sizeof(header), imageBase) == sizeof(header));
+    if (!haveHeader)
     {
-        int mid = (left + (right - left) / 2);
-        if (addr <= segmentCache[mid - 1].end)
-            right = mid;
-        else
-        if (addr >= segmentCache[mid].start)
-            left = mid;
-        else
+        char path[QMAXPATH];
+        if (get_input_file_path(path, sizeof(path)) > 0)
         {
-            // Gap between regions
-            return NULL;
+            if (FILE *fp = qfopen(path, "rb"))
+            {
+                haveHeader = (qfread(fp, header, sizeof(header)) == sizeof(header));
+                qfclose(fp);
+            }
+        }
+    }
+    if (!haveHeader)
+        return FALSE;
+
+    PIMAGE_DOS_HEADER dosHeader = (PIMAGE_DOS_HEADER) header;
+    if ((dosHeader->e_magic != IMAGE_DOS_SIGNATURE) || (dosHeader->e_lfanew <= 0) || ((size_t) dosHeader->e_lfanew > (sizeof(header) - sizeof(IMAGE_NT_HEADERS64))))
+        return FALSE;
+    PIMAGE_NT_HEADERS32 ntHeader = (PIMAGE_NT_HEADERS32) (header + dosHeader->e_lfanew);
+    if (ntHeader->Signature != IMAGE_NT_SIGNATURE)
+        return FALSE;
+
+    IMAGE_DATA_DIRECTORY debugDir = { 0 };
+    if (ntHeader->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC)
+    {
+        PIMAGE_NT_HEADERS64 ntHeader64 = (PIMAGE_NT_HEADERS64) ntHeader;
+        if (ntHeader64->OptionalHeader.NumberOfRvaAndSizes > IMAGE_DIRECTORY_ENTRY_DEBUG)
+            debugDir = ntHeader64->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_DEBUG];
+    }
+    else
+    if (ntHeader->OptionalHeader.NumberOfRvaAndSizes > IMAGE_DIRECTORY_ENTRY_DEBUG)
+        debugDir = ntHeader->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_DEBUG];
+    if (!debugDir.VirtualAddress || !debugDir.Size)
+        return FALSE;
+
+    // The debug directory and its POGO data are normally in .rdata
+    UINT32 entryCount = (debugDir.Size / sizeof(IMAGE_DEBUG_DIRECTORY));
+    for (UINT32 i = 0; i < entryCount; i++)
+    {
+        IMAGE_DEBUG_DIRECTORY entry;
+        if (get_bytes(&entry, sizeof(entry), (imageBase + debugDir.VirtualAddress + (i * sizeof(entry)))) != sizeof(entry))
+            break;
+
+        if ((entry.Type == IMAGE_DEBUG_TYPE_POGO) && entry.AddressOfRawData && (entry.SizeOfData > sizeof(UINT32)))
+        {
+            std::vector<BYTE> data(entry.SizeOfData);
+            if (get_bytes(data.data(), entry.SizeOfData, (imageBase + entry.AddressOfRawData)) != (ssize_t) entry.SizeOfData)
+                return FALSE;
+
+            // A signature, then { RVA, size, name } records with the names zero padded to 4 byte alignment
+            size_t pos = sizeof(UINT32);
+            while ((pos + (sizeof(UINT32) * 2)) < data.size())
+            {
+                UINT32 rva = *((PUINT32) &data[pos]);
+                UINT32 size = *((PUINT32) &data[pos + sizeof(UINT32)]);
+                LPCSTR name = (LPCSTR) &data[pos + (sizeof(UINT32) * 2)];
+                size_t len = strnlen(name, (data.size() - (pos + (sizeof(UINT32) * 2))));
+                groups[std::string(name, len)] = { rva, size };
+                pos += ((sizeof(UINT32) * 2) + ((len + 4) & ~3));
+            }
+            return !groups.empty();
         }
+    }
+    return FALSE;
+}
+
+// Address of a CRT table boundary symbol, with or without the 32bit C leading underscore
+static ea_t getCrtSymbol(LPCSTR name)
+{
+    ea_t ea = get_name_ea(BADADDR, name);
+    if ((ea == BADADDR) && !plat.is64)
+    {
+        char decorated[32];
+        sprintf_s(decorated, sizeof(decorated), "_%s", name);
+        ea = get_name_ea(BADADDR, decorated);
+    }
+    return ea;
+}
+
+// Locate the static ctor/dtor tables directly from the PE ".CRT$X?A" to ".CRT$X?Z" COFF groups, or the CRT
+// "__x?_a" and "__x?_z" table boundary symbols.
+// Returns TRUE if any were found, else the code pattern search is needed.
+static BOOL processCrtTables()
+{
+    enum CRTTABLE { CRT_CPP_CTOR, CRT_C_INIT, CRT_TERM };
+    static const struct
+    {
+        char group;
+        LPCSTR first, last;
+        CRTTABLE kind;
+    } tables[] =
+    {
+        { 'C', "__xc_a", "__xc_z", CRT_CPP_CTOR },  // C++ constructors
+        { 'I', "__xi_a", "__xi_z", CRT_C_INIT },    // C initializers
+        { 'P', "__xp_a", "__xp_z", CRT_TERM },      // C pre-terminators
+        { 'T', "__xt_a", "__xt_z", CRT_TERM }       // C terminators
     };
 
-    const SEGMENT *seg = &segmentCache[left];
-    if ((addr >= seg->start) && (addr <= seg->end))
-        return seg;
+    COFFGROUPS groups;
+    BOOL haveGroups = getCoffGroups(groups);
+    ea_t imageBase = get_imagebase();
+    UINT32 found = 0;
 
-    // Below or above all regions
-    return NULL;
+    for (const auto &t: tables)
+    {
+        ea_t start = BADADDR, end = BADADDR;
+        LPCSTR source = "symbols";
+        if (haveGroups)
+        {
+            char first[] = ".CRT$X?A", last[] = ".CRT$X?Z";
+            first[6] = last[6] = t.group;
+            auto a = groups.find(first), z = groups.find(last);
+            if ((a != groups.end()) && (z != groups.end()))
+            {
+                start = (imageBase + a->second.first);
+                end = (imageBase + z->second.first);
+                source = "COFF groups";
+            }
+        }
+        if (start == BADADDR)
+        {
+            start = getCrtSymbol(t.first);
+            end = getCrtSymbol(t.last);
+        }
+
+        // Should be pointers in the same segment, the same checks the pattern path does
+        if ((start == BADADDR) || (end == BADADDR) || (start >= end) || ((end - start) % plat.ptrSize))
+            continue;
+        const SEGMENT *startSeg = FindCachedSegment(start);
+        if (!startSeg || (startSeg != FindCachedSegment(end)))
+            continue;
+
+        msg("  %llX to %llX .CRT$X%c table, from %s.\n", start, end, t.group, source);
+        if (t.kind == CRT_TERM)
+            setTerminatorTable(start, end);
+        else
+            setIntializerTable(start, end, (t.kind == CRT_CPP_CTOR));
+        found++;
+    }
+
+    return(found > 0);
 }
 
 // Process global/static ctor & dtor tables.
@@ -999,6 +1941,10 @@ static BOOL processStaticTables()
 
     try
     {
+        // Table bounds straight from the PE when available, no code scanning needed
+        if (processCrtTables())
+            return(FALSE);
+
         // _cinit()
         func_t *cinitFunc = NULL;
         ea_t cinitFuncEa = get_name_ea(inf_get_min_ea(), "_cinit");
@@ -1045,50 +1991,33 @@ static BOOL processStaticTables()
 			}
         }
 
-		// There are cases there there are local enumerated versions like "_initterm_0", etc., that we could handle
-		// So keeping the loop here for future expansion
-        #if 0
-        UINT32 funcCount = (UINT32) get_func_qty();
-        for (UINT32 i = 0; i < funcCount; i++)
+		// Local enumerated and prefixed versions like "_initterm_0", "__cinit", etc., by the name index suffix match
+        if (g_rttiNameIndex.prepare())
+            return(TRUE);
+        g_rttiNameIndex.forEach(NK_CRT, [&](ea_t ea, BYTE kind)
         {
-            if (func_t *func = getn_func(i))
-            {
-                qstring qstr;
-                if (get_long_name(&qstr, func->start_ea) > 0)
-				{
-                    char name[MAXSTR];
-                    strncpy_s(name, MAXSTR, qstr.c_str(), (MAXSTR - 1));
+            func_t *func = get_func(ea);
+            if (!func || (func->start_ea != ea))
+                return;
 
-                    int len = (int) strlen(name);
-                    if (len >= SIZESTR("_cinit"))
-                    {
-                        if (strcmp((name + (len - SIZESTR("_cinit"))), "_cinit") == 0)
-                        {
-                            // Skip stub functions
-                            if (func->size() > 16)
-                            {
-                                msg("%llX C: \"%s\", %d bytes.\n", func->start_ea, name, func->size());
-                                _ASSERT(cinitFunc == NULL);
-                                cinitFunc = func;
-                            }
-                        }
-                        else
-                        if ((len >= SIZESTR("_initterm")) && (strcmp((name + (len - SIZESTR("_initterm"))), "_initterm") == 0))
-                        {
-                            msg("%llX I: \"%s\", %d bytes.\n", func->start_ea, name, func->size());
-                            inittermMap[func->start_ea] = name;
-                        }
-                        else
-                        if ((len >= SIZESTR("_initterm_e")) && (strcmp((name + (len - SIZESTR("_initterm_e"))), "_initterm_e") == 0))
-                        {
-                            msg("%llX E: \"%s\", %d bytes.\n", func->start_ea, name, func->size());
-                            inittermMap[func->start_ea] = name;
-                        }
-                    }
+            qstring name;
+            get_name(&name, ea);
+            if (kind & NK_CINIT)
+            {
+                // Skip stub functions
+                if (!cinitFunc && (func->size() > 16))
+                {
+                    msg("%llX C: \"%s\", %d bytes.\n", func->start_ea, name.c_str(), (int) func->size());
+                    cinitFunc = func;
                 }
             }
-        }
-        #endif
+            else
+            if (inittermMap.find(func->start_ea) == inittermMap.end())
+            {
+                msg("%llX %c: \"%s\", %d bytes.\n", func->start_ea, ((kind & NK_INITTERM_E) ? 'E' : 'I'), name.c_str(), (int) func->size());
+                inittermMap[func->start_ea] = name.c_str();
+            }
+        });
 
 		if(WaitBox::isUpdateTime())
 			if (WaitBox::updateAndCancelCheck())
@@ -1120,26 +2049,43 @@ static BOOL processStaticTables()
         {
             struct CREPAT
             {
-                LPCSTR pattern;
+                BYTEPATTERN pattern;
                 UINT32 start, end, call;
-            } static const ALIGN(16) pat[] =
+            };
+            static constexpr CREPAT pat[] =
             {
                 // TODO: Add more patterns as they are located
                 { "B8 ?? ?? ?? ?? BE ?? ?? ?? ?? 59 8B F8 3B C6 73 0F 8B 07 85 C0 74 02 FF D0 83 C7 04 3B FE 72 F1", 1, 6, 0x17},
                 { "BE ?? ?? ?? ?? 8B C6 BF ?? ?? ?? ?? 3B C7 59 73 0F 8B 06 85 C0 74 02 FF D0 83 C6 04 3B F7 72 F1", 1, 8, 0x17},
             };
+            static PatternMatcher matcher;
+            if (matcher.empty())
+            {
+                for (const CREPAT &pe: pat)
+                    matcher.add(pe.pattern);
+            }
 
-            for (UINT32 i = 0; i < _countof(pat); i++)
+            // One pass over a snapshot of the function body for all of them.
+            // A match blocks the same pattern for the next 30 bytes as the loop it matched covers them.
+            size_t funcSize = (size_t) (cinitFunc->end_ea - cinitFunc->start_ea);
+            std::vector<BYTE> body(funcSize);
+            ssize_t got = get_bytes(body.data(), funcSize, cinitFunc->start_ea);
+            if (got > 0)
             {
-				ea_t match = FIND_BINARY(cinitFunc->start_ea, cinitFunc->end_ea, pat[i].pattern);
-                while (match != BADADDR)
+                size_t nextAllowed[_countof(pat)] = {};
+                matcher.scan(body.data(), (size_t) got, [&](UINT32 i, size_t offset)
                 {
-                    msg("   %llX Register _initterm(), pattern #%d.\n", match, i);
-                    ea_t start = plat.getEa(match + pat[i].start);
-                    ea_t end   = plat.getEa(match + pat[i].end);
-                    processRegisterInitterm(start, end, (match + pat[i].call));
-					match = FIND_BINARY(match + 30, cinitFunc->end_ea, pat[i].pattern);
-                };
+                    if (offset >= nextAllowed[i])
+                    {
+                        ea_t match = (cinitFunc->start_ea + offset);
+                        msg("   %llX Register _initterm(), pattern #%d.\n", match, i);
+                        ea_t start = plat.getEa(match + pat[i].start);
+                        ea_t end   = plat.getEa(match + pat[i].end);
+                        processRegisterInitterm(start, end, (match + pat[i].call));
+                        nextAllowed[i] = (offset + 30);
+                    }
+                    return TRUE;
+                });
             }
         }
 
@@ -1148,19 +2094,19 @@ static BOOL processStaticTables()
 			if (WaitBox::updateAndCancelCheck())
 				return(TRUE);
 
-        // Generate _initterm argument pattern table
+        // Set up the _initterm argument pattern matcher
+        initTermArgMatcher.clear();
 		if (plat.is64)
 		{
-			// 64bit patterns
-			initTermArgPatterns.push_back({ "48 8D 15 ?? ?? ?? ?? 48 8D 0D", 3, 3 }); // lea rdx,s, lea rcx,e
+            initTermArgPatterns = initTermArgPatterns64;
+            for (const INITTERM_ARGPAT &pe: initTermArgPatterns64)
+                initTermArgMatcher.add(pe.pattern);
 		}
 		else
 		{
-			// 32bit patterns
-            // TODO: Add more patterns as they are located
-			initTermArgPatterns.push_back({ "68 ?? ?? ?? ?? 68", 6, 1 });       // push offset s, push offset e
-			initTermArgPatterns.push_back({ "B8 ?? ?? ?? ?? C7 04 24", 8, 1 }); // mov [esp+4+var_4], offset s, mov eax, offset e
-			initTermArgPatterns.push_back({ "68 ?? ?? ?? ?? B8", 6, 1 });       // mov eax, offset s, push offset e
+            initTermArgPatterns = initTermArgPatterns32;
+            for (const INITTERM_ARGPAT &pe: initTermArgPatterns32)
+                initTermArgMatcher.add(pe.pattern);
 		}
 
         // Process _initterm references
@@ -1184,10 +2130,137 @@ static BOOL processStaticTables()
 // ================================================================================================
 
 
+// ================================================================================================
+
+static BYTE pendingAnnotations(ea_t ea)
+{
+    if (!annotationPending.empty())
+    {
+        auto it = annotationPending.find(ea);
+        if (it != annotationPending.end())
+            return it->second;
+    }
+    return 0;
+}
+
+static void queueAnnotation(ea_t ea, BYTE kind, LPCSTR text, BOOL ifNone)
+{
+    static const BYTE pendingFlag[] = { PENDING_NAME, PENDING_COMMENT, PENDING_COMMENT, PENDING_ANTERIOR };
+    size_t len = (strlen(text) + 1);
+    UINT32 offset = (UINT32) annotationText.size();
+    annotationText.insert(annotationText.end(), text, (text + len));
+    annotationQueue.push_back({ ea, (UINT32) annotationQueue.size(), offset, kind, (BYTE) ifNone });
+    annotationPending[ea] |= pendingFlag[kind];
+}
+
+// Return TRUE if there is a name at address that is not a dumbly name
+BOOL hasName(ea_t ea) { return((pendingAnnotations(ea) & PENDING_NAME) || has_name(get_flags(ea))); }
+
+// Return TRUE if there is a comment at address
+BOOL hasComment(ea_t ea) { return((pendingAnnotations(ea) & PENDING_COMMENT) || has_cmt(get_flags(ea))); }
+
 // Return TRUE if address as a anterior comment
-inline BOOL hasAnteriorComment(ea_t ea)
+BOOL hasAnteriorComment(ea_t ea)
 {
-    return (get_first_free_extra_cmtidx(ea, E_PREV) != E_PREV);
+    return((pendingAnnotations(ea) & PENDING_ANTERIOR) || (get_first_free_extra_cmtidx(ea, E_PREV) != E_PREV));
+}
+
+// Apply queued edits in address order with a single existing name/comment probe per address
+void commitAnnotations(LPCSTR phase)
+{
+    if (annotationQueue.empty())
+        return;
+
+    TIMESTAMP startTime = GetTimeStamp();
+    std::sort(annotationQueue.begin(), annotationQueue.end(), [](const ANNOTATION &a, const ANNOTATION &b) { return((a.ea < b.ea) || ((a.ea == b.ea) && (a.order < b.order))); });
+
+    UINT32 names = 0, comments = 0, lines = 0, skipped = 0;
+    size_t count = annotationQueue.size();
+    for (size_t i = 0; i < count;)
+    {
+        ea_t ea = annotationQueue[i].ea;
+        flags_t flags = get_flags(ea);
+        BOOL named = has_name(flags), commented = has_cmt(flags);
+        int anterior = -1;
+        LPCSTR name = NULL, comment = NULL, rptComment = NULL;
+
+        // Resolve this address' edits, the last one of a kind wins
+        for (; (i < count) && (annotationQueue[i].ea == ea); i++)
+        {
+            const ANNOTATION &an = annotationQueue[i];
+            LPCSTR text = &annotationText[an.text];
+            switch (an.kind)
+            {
+                case AK_NAME:
+                {
+                    if (an.ifNone && named)
+                        skipped++;
+                    else
+                    {
+                        name = text;
+                        named = TRUE;
+                    }
+                }
+                break;
+
+                case AK_COMMENT:
+                case AK_RPT_COMMENT:
+                {
+                    if (an.ifNone && commented)
+                        skipped++;
+                    else
+                    {
+                        if (an.kind == AK_RPT_COMMENT)
+                            rptComment = text;
+                        else
+                            comment = text;
+                        commented = TRUE;
+                    }
+                }
+                break;
+
+                case AK_ANTERIOR:
+                {
+                    // Lines accumulate, so these go in as they come
+                    if (anterior == -1)
+                        anterior = (get_first_free_extra_cmtidx(ea, E_PREV) != E_PREV);
+                    if (an.ifNone && anterior)
+                        skipped++;
+                    else
+                    {
+                        add_extra_line(ea, 0, "%s", text);
+                        anterior = TRUE;
+                        lines++;
+                    }
+                }
+                break;
+            };
+        }
+
+        if (name)
+        {
+            set_name(ea, name, (SN_NON_AUTO | SN_NOWARN | SN_NOCHECK | SN_FORCE));
+            names++;
+        }
+        if (comment)
+        {
+            set_cmt(ea, comment, FALSE);
+            comments++;
+        }
+        if (rptComment)
+        {
+            set_cmt(ea, rptComment, TRUE);
+            comments++;
+        }
+    }
+
+    annotationQueue.clear();
+    annotationText.clear();
+    annotationPending.clear();
+
+    char buf1[32], buf2[32], buf3[32], buf4[32];
+    msg("%s commit: %s names, %s comments, %s anterior lines (%s already set) in %s.\n", phase, NumberCommaString(names, buf1), NumberCommaString(comments, buf2),
+        NumberCommaString(lines, buf3), NumberCommaString(skipped, buf4), TimeString(GetTimeStamp() - startTime));
 }
 
 // Force a memory location to be DWORD size
@@ -1205,39 +2278,9 @@ void fixDword(ea_t ea)
 void fixEa(ea_t ea)
 {
 	if (!plat.is64)
-	{
-		// 32bit
-		if (!is_dword(get_flags(ea)))
-		{
-			setUnknown(ea, sizeof(UINT32));
-			create_dword(ea, sizeof(UINT32), TRUE);
-            auto_wait();
-		}
-	}
+		fixEa<RTTI::PTR32>(ea);
 	else
-	{
-		// If already a QWORD size value here it's good
-		if (!is_qword(get_flags(ea)))
-		{
-			setUnknown(ea, sizeof(UINT64));
-			create_qword(ea, sizeof(UINT64), TRUE);
-            auto_wait();
-		}
-	}
-}
-
-// Get IDA EA bit value with verification
-BOOL getVerifyEa(ea_t ea, ea_t &rValue)
-{
-	// Location valid?
-	if (IS_VALID_ADDR(ea))
-	{
-		// Get ea_t value
-		rValue = plat.getEa(ea);
-		return TRUE;
-	}
-
-	return FALSE;
+		fixEa<RTTI::PTR64>(ea);
 }
 
 // Address should be a code function
@@ -1301,314 +2344,458 @@ BOOL getPlainTypeName(__in LPCSTR mangled, __out_bcount(MAXSTR) LPSTR outStr)
 // Set name for address
 void setName(ea_t ea, __in LPCSTR name)
 {	
-	set_name(ea, name, (SN_NON_AUTO | SN_NOWARN | SN_NOCHECK | SN_FORCE));
+	queueAnnotation(ea, AK_NAME, name, FALSE);
     //msg("setName: %llX \"%s\"\n", ea, name);
 }
 
+// Set name for address if it doesn't have one at commit time
+void setNameIfNone(ea_t ea, __in LPCSTR name)
+{
+    queueAnnotation(ea, AK_NAME, name, TRUE);
+}
+
 // Set comment at address
 void setComment(ea_t ea, LPCSTR comment, BOOL rptble)
 {	
-	set_cmt(ea, comment, rptble);
+	queueAnnotation(ea, (rptble ? AK_RPT_COMMENT : AK_COMMENT), comment, FALSE);
     //msg("setComment: %llX \"%s\"\n", ea, comment);
 }
 
+// Set comment at address if it doesn't have one at commit time
+void setCommentIfNone(ea_t ea, LPCSTR comment, BOOL rptble)
+{
+    queueAnnotation(ea, (rptble ? AK_RPT_COMMENT : AK_COMMENT), comment, TRUE);
+}
+
 // Set comment at the line above the address
 void setAnteriorComment(ea_t ea, const char *format, ...)
 {
+    // Unbounded, the hierarchy comments can run long
+    qstring text;
 	va_list va;
 	va_start(va, format);
-	vadd_extra_line(ea, 0, format, va);
-	va_end(va);    
+	text.cat_vsprnt(format, va);
+	va_end(va);
+    queueAnnotation(ea, AK_ANTERIOR, text.c_str(), FALSE);
     //msg("setAnteriorComment: %llX\n", ea);
 }
 
+// Set comment at the line above the address if it doesn't have one at commit time
+void setAnteriorCommentIfNone(ea_t ea, const char *format, ...)
+{
+    qstring text;
+    va_list va;
+    va_start(va, format);
+    text.cat_vsprnt(format, va);
+    va_end(va);
+    queueAnnotation(ea, AK_ANTERIOR, text.c_str(), TRUE);
+}
+
+
+// Background scan state, main thread side
+static UINT32 scanPhase = ScanWorker::SP_COLS;
+static UINT32 scanSegFound = 0;
+static TIMESTAMP scanPhaseStart = 0;
+
+// The list opens at the start of the vftable phase and is refreshed with the new rows at most this often
+static const TIMESTAMP LIST_REFRESH_TIME = (TIMESTAMP) 1.0;
+static TIMESTAMP lastListRefresh = 0;
 
-// Scan segment for COLs
-static BOOL scanSeg4Cols(segment_t *seg)
+// Apply a batch of the scan worker's finds.
+// The worker saw the IDB as it was when the scan started, so the COLs are validated again against the IDB as it is
+// now, and the vftables get their full check in processVftable().
+template <class W> static void applyScanBatch(const std::vector<ScanWorker::ITEM> &items)
 {
-	qstring name;
-    if (get_segm_name(&name, seg) <= 0)
-		name = "???";
-    msg("N: \"%s\", %llX - %llX, S: %s.\n", name.c_str(), seg->start_ea, seg->end_ea, byteSizeString(seg->size()));
-    UINT32 newCount = 0, existingCount = 0;
-    WaitBox::processIdaEvents();
+    // Our own edits are not user changes
+    tableTracker.suspend(TRUE);
 
-    size_t colSize = (plat.is64 ? sizeof(RTTI::_RTTICompleteObjectLocator_64) : sizeof(RTTI::_RTTICompleteObjectLocator_32));
-    if (seg->size() >= colSize)
+    try
     {
-		ea_t startEA = ((seg->start_ea + plat.ptrSize) & ~((ea_t) plat.ptrSize - 1));
-        ea_t endEA   = (seg->end_ea - colSize);
-
-        for (ea_t ptr = startEA; ptr < endEA;)
+        for (const ScanWorker::ITEM &item: items)
         {
-            if (!plat.is64)
+            switch (item.kind)
             {
-				// 32bit
-                if (!IN_SUPER(ptr))
+                case ScanWorker::SI_SEGMENT:
                 {
-                    // TypeDescriptor address here?
-                    ea_t ea = plat.getEa(ptr);
-                    if (!plat.isBadAddress(ea))
+                    qstring name;
+                    segment_t *seg = getseg(item.ea);
+                    if (!seg || (get_segm_name(&name, seg) <= 0))
+                        name = "???";
+                    msg("N: \"%s\", %llX - %llX, S: %s.\n", name.c_str(), item.ea, item.col, byteSizeString(item.col - item.ea));
+                    scanPhase = item.count;
+                    scanSegFound = 0;
+                }
+                break;
+
+                case ScanWorker::SI_COL:
+                {
+                    if (RTTI::_RTTICompleteObjectLocator::isValid<W>(item.ea))
                     {
-                        if (RTTI::type_info_32::isValid(ea))
-                        {
-                            // yes, a COL here?
-                            ea_t col = (ptr - offsetof(RTTI::_RTTICompleteObjectLocator_32, typeDescriptor));
-                            if (RTTI::_RTTICompleteObjectLocator_32::isValid2(col))
-                            {
-                                // yes
-                                //msg("%llX located COL.\n", col);
-                                colList.push_back(col);
-                                newCount++;
-                                RTTI::_RTTICompleteObjectLocator_32::tryStruct(col);
-                                ptr += sizeof(RTTI::_RTTICompleteObjectLocator_32);
-                                continue;
-                            }
-                        }
+                        //msg("%llX located COL.\n", item.ea);
+                        colList.push_back(item.ea);
+                        scanSegFound++;
+                        RTTI::_RTTICompleteObjectLocator::tryStruct<W>(item.ea);
                     }
                 }
-				else
-				{
-					if (colSet.find(ptr) != colSet.end())
-						existingCount++;
-				}
-            }
-            else
-            {
-                // 64bit
-                if (!IN_SUPER(ptr))
+                break;
+
+                case ScanWorker::SI_VFTABLE:
+                    scanSegFound += (UINT32) RTTI::processVftable<W>(item.ea, item.col, item.count);
+                    break;
+
+                case ScanWorker::SI_SEGMENT_END:
                 {
-                    // Check for possible COL here
-                    // Signature will be one
-                    // TODO: Is this always 1 or can it be zero like 32bit?
-                    if (get_32bit(ptr + offsetof(RTTI::_RTTICompleteObjectLocator_64, signature)) == 1)
+                    char numBuffer[32];
+                    if (scanSegFound)
+                        msg(" Found: %s\n", NumberCommaString(scanSegFound, numBuffer));
+
+                    if (scanPhase == ScanWorker::SP_COLS)
                     {
-                        if (RTTI::_RTTICompleteObjectLocator_64::isValid(ptr))
+                        if (item.count)
+                            msg(" Existing: %s\n", NumberCommaString(item.count, numBuffer));
+
+                        // Place the structures found in this segment
+                        UINT32 objects, runs, creates;
+                        RTTI::flushPlacements(objects, runs, creates);
+                        if (objects)
                         {
-                            // yes
-                            //msg("%llX located COL.\n", ptr);
-                            colList.push_back(ptr);
-                            newCount++;
-                            RTTI::_RTTICompleteObjectLocator_64::tryStruct(ptr);
-                            ptr += sizeof(RTTI::_RTTICompleteObjectLocator_64);
-                            continue;
+                            char buf1[32], buf2[32], buf3[32];
+                            msg(" Placed: %s objects, %s undefine runs, %s struct creates\n", NumberCommaString(objects, buf1), NumberCommaString(runs, buf2), NumberCommaString(creates, buf3));
                         }
+                        commitAnnotations("COL");
                     }
                     else
                     {
-                        // TODO: Should we check stray BCDs?
-                        // Each value would have to be tested for a valid type_def and the pattern is pretty ambiguous.                      
+                        commitAnnotations("Vftable");
+                        checkpointResultTable();
                     }
                 }
-                else
+                break;
+
+                case ScanWorker::SI_PHASE_END:
                 {
-					if (colSet.find(ptr) != colSet.end())					
-						existingCount++;				
+                    if (item.count == ScanWorker::SP_COLS)
+                    {
+                        char numBuffer[32];
+                        msg("%s total new COLs located in %s.\n", NumberCommaString(colList.size(), numBuffer), TimeString(GetTimeStamp() - scanPhaseStart));
+
+                        // Append them to the known COLs
+                        UINT32 colSize = (UINT32) sizeof(typename W::col_t);
+                        for (auto &addr: colList)
+                            g_rttiStore.insert(addr, RK_COL, colSize);
+                        g_rttiStore.commit();
+                        colList.clear();
+
+                        msg("\nScanning for Virtual Function Tables:\n");
+                        msg("-------------------------------------------------\n");
+                        scanPhaseStart = GetTimeStamp();
+
+                        // Browse the rows as they come in
+                        showResultList(TRUE);
+                        lastListRefresh = GetTimeStamp();
+                    }
+                    else
+                    {
+                        msg("Vftable scan took: %s\n", TimeString(GetTimeStamp() - scanPhaseStart));
+                        RTTI::endVftablePhase();
+                    }
                 }
-            }
+                break;
 
-            if(ptr % 1000)
-                if (WaitBox::isUpdateTime())
-                    if (WaitBox::updateAndCancelCheck())
-                        return TRUE;
-
-            ptr += (ea_t) plat.ptrSize;
+                case ScanWorker::SI_DONE:
+                    scanWorker.finish();
+                    endScan(FALSE);
+                    break;
+            };
         }
     }
-    
-    if (newCount)
+    CATCH()
+
+    if (scanWorker.isRunning())
     {
-        char numBuffer[32];
-        msg(" Found: %s\n", NumberCommaString(newCount, numBuffer));
+        // Index the rows added for the user edit tracking
+        tableTracker.suspend(FALSE);
+        tableTracker.reset();
+
+        if ((scanPhase == ScanWorker::SP_VFTABLES) && ((GetTimeStamp() - lastListRefresh) >= LIST_REFRESH_TIME))
+        {
+            refresh_chooser(LBTITLE);
+            lastListRefresh = GetTimeStamp();
+        }
     }
-	if (existingCount)
-	{
-		char numBuffer[32];
-		msg(" Existing: %s\n", NumberCommaString(existingCount, numBuffer));
-	}
-    return FALSE;
 }
 
-// Locate COL by descriptor list
-static BOOL findCols(SegSelect::segments &segs)
+// Start the background COL and vftable scan of the selected segments, or the data segments by default.
+// Returns TRUE if started.
+static BOOL startScan(SegSelect::segments &segs)
 {
-    try
+    std::vector<ScanWorker::RANGE> ranges;
+    if (!segs.empty())
     {
-		// Use user selected segments
-        TIMESTAMP startTime = GetTimeStamp();
-		if (!segs.empty())
-		{
-            for (auto &seg: segs)
-			{
-				if (scanSeg4Cols(&seg))
-					return FALSE;
-			}
-		}
-		else
-		// Scan data segments named
-		{
-			for (int i = 0; i < get_segm_qty(); i++)
-			{
-				if (segment_t *seg = getnseg(i))
-				{
-					if (seg->type == SEG_DATA)
-					{
-						if (scanSeg4Cols(seg))
-							return FALSE;
-					}
-				}
-			}
-		}
+        for (auto &seg: segs)
+        {
+            if (!isUnchangedSegment(&seg))
+                ranges.push_back({ seg.start_ea, seg.end_ea });
+        }
+    }
+    else
+    {
+        for (int i = 0; i < get_segm_qty(); i++)
+        {
+            if (segment_t *seg = getnseg(i))
+            {
+                if ((seg->type == SEG_DATA) && !isUnchangedSegment(seg))
+                    ranges.push_back({ seg->start_ea, seg->end_ea });
+            }
+        }
+    }
 
-        char numBuffer[32];
-        msg("%s total new COLs located in %s.\n", NumberCommaString(colList.size(), numBuffer), TimeString(GetTimeStamp() - startTime));
-        WaitBox::processIdaEvents();
+    msg("\nScanning for for Complete Object Locators:\n");
+    msg("-------------------------------------------------\n");
+    WaitBox::processIdaEvents();
+    scanPhase = ScanWorker::SP_COLS;
+    scanSegFound = 0;
+    scanPhaseStart = GetTimeStamp();
+    if (!scanWorker.start(ranges, plat.is64, (plat.is64 ? applyScanBatch<RTTI::PTR64> : applyScanBatch<RTTI::PTR32>)))
+    {
+        msg("** Failed to start the scan thread **\n");
+        return FALSE;
+    }
 
-        // Append it to the colSet
-        for (auto &addr: colList)
-            colSet.insert(addr);
-        colList.clear();
+    msg("The scan continues in the background, the IDB can be used in the mean time.\n");
+    return TRUE;
+}
+
+// Stop a running scan, keeping what it found so far
+static void cancelScan(BOOL closing)
+{
+    try
+    {
+        if (scanWorker.isRunning())
+        {
+            scanWorker.cancel();
+            endScan(TRUE, closing);
+        }
     }
     CATCH()
-    return FALSE;
 }
 
 
-// Locate virtual function tables (vftable)
-static BOOL scanSeg4Vftables(segment_t *seg)
+// ================================================================================================
+
+// Incremental rescan.
+// Each scanned segment gets a content fingerprint stored with the results. A rescan skips the segments whose
+// fingerprint matches and that have no edited rows, keeping their stored rows and scanning only the rest.
+#pragma pack(push, 1)
+struct SEGPRINT
 {
-	qstring name;
-	if (get_segm_name(&name, seg) <= 0)
-		name = "???";
-	msg("N: \"%s\", %llX - %llX, S: %s.\n", name.c_str(), seg->start_ea, seg->end_ea, byteSizeString(seg->size()));
-    UINT32 foundCount = 0;
-    WaitBox::processIdaEvents();
+    UINT64 start, end;
+    UINT64 hash;
+};
+#pragma pack(pop)
+static std::vector<SEGPRINT> scanPrints;  // This scan's segments
+static eaSet unchangedSegs;               // Start addresses of the segments to skip
 
-    if (seg->size() >= plat.ptrSize)
+// Hash the segment bytes and attributes, eight bytes at the time
+static UINT64 hashSegment(const segment_t *seg)
+{
+    UINT64 hash = (0x9E3779B97F4A7C15 ^ (UINT64) seg->start_ea ^ _rotl64((UINT64) seg->end_ea, 32) ^ ((UINT64) seg->perm << 56) ^ ((UINT64) seg->type << 48) ^ ((UINT64) seg->bitness << 40));
+    const size_t CHUNK_SIZE = (1024 * 1024);
+    std::vector<BYTE> buffer(CHUNK_SIZE + sizeof(UINT64));
+
+    for (ea_t ea = seg->start_ea; ea < seg->end_ea;)
     {
-        // The default for vftable alignment is native pointer size
-        ea_t startEA = ((seg->start_ea + plat.ptrSize) & ~((ea_t) plat.ptrSize - 1));
-        ea_t endEA   = (seg->end_ea - plat.ptrSize);
+        size_t size = (size_t) std::min((ea_t) CHUNK_SIZE, (seg->end_ea - ea));
+        get_bytes(buffer.data(), size, ea, GMB_READALL);
+        memset(&buffer[size], 0, sizeof(UINT64));   // Zero pad the last word
+
+        for (size_t i = 0; i < size; i += sizeof(UINT64))
+        {
+            UINT64 word;
+            memcpy(&word, &buffer[i], sizeof(UINT64));
+            hash = (_rotl64((hash ^ word), 29) * 0xBF58476D1CE4E5B9);
+        }
+        ea += (ea_t) size;
+    }
+    return(hash ^ (hash >> 31));
+}
+
+static BOOL isUnchangedSegment(const segment_t *seg) { return(unchangedSegs.find(seg->start_ea) != unchangedSegs.end()); }
+
+// Stored row is in a segment being skipped
+static BOOL inUnchangedSegment(ea_t ea)
+{
+    segment_t *seg = getseg(ea);
+    return(seg && isUnchangedSegment(seg));
+}
+
+// Fingerprint the segments to scan. For an incremental scan, find the unchanged ones and drop the stored rows
+// outside of them so the scan can add them back.
+static void prepareSegmentScan(SegSelect::segments &segs, BOOL incremental)
+{
+    scanPrints.clear();
+    unchangedSegs.clear();
 
-		// Walk pointer at the time..
-        for (ea_t ptr = startEA; ptr < endEA; ptr += (ea_t) plat.ptrSize)
+    TIMESTAMP startTime = GetTimeStamp();
+    auto addPrint = [](const segment_t *seg) { scanPrints.push_back({ (UINT64) seg->start_ea, (UINT64) seg->end_ea, hashSegment(seg) }); };
+    if (!segs.empty())
+    {
+        for (auto &seg: segs)
+            addPrint(&seg);
+    }
+    else
+    {
+        for (int i = 0; i < get_segm_qty(); i++)
         {
-            // Points to a known COL?
-            ea_t colEa = plat.getEa(ptr);
-            if (colSet.find(colEa) != colSet.end())
+            if (segment_t *seg = getnseg(i))
             {
-                // yes, look for vftable one pointer below
-                ea_t vfptr = (ptr + (ea_t) plat.ptrSize);
+                if (seg->type == SEG_DATA)
+                    addPrint(seg);
+            }
+        }
+    }
 
-                // Already known?
-                if (vftSet.find(vfptr) != vftSet.end())
-                {
-                    // Yes, process it now
-                    RTTI::processVftable(vfptr, colEa, TRUE);
-                    foundCount++;
-                }
-                else
+    // The previous prints get replaced once this scan completes, none in the mean time on an abort
+    bytevec_t blob;
+    netNode->getblob(&blob, 0, NN_PRINT_TAG);
+    netNode->delblob(0, NN_PRINT_TAG);
+    if (!incremental)
+        return;
+
+    UINT64 skippedBytes = 0;
+    if (!(blob.size() % sizeof(SEGPRINT)))
+    {
+        const SEGPRINT *stored = (const SEGPRINT *) blob.begin();
+        size_t storedCount = (blob.size() / sizeof(SEGPRINT));
+        for (const SEGPRINT &p: scanPrints)
+        {
+            for (size_t i = 0; i < storedCount; i++)
+            {
+                if ((stored[i].start == p.start) && (stored[i].end == p.end) && (stored[i].hash == p.hash))
                 {
-                    // Points to code?
-                    ea_t method = plat.getEa(vfptr);
-                    const SEGMENT *methodSeg = FindCachedSegment(method);
-                    if (methodSeg && (methodSeg->type & _CODE_SEG))
-                    {
-                        // Yes, see if vftable here
-                        foundCount += (UINT32) RTTI::processVftable(vfptr, colEa);
-                    }
+                    unchangedSegs.insert((ea_t) p.start);
+                    break;
                 }
             }
-
-            if(ptr % 1000)
-                if (WaitBox::isUpdateTime())
-                    if (WaitBox::updateAndCancelCheck())
-                        return TRUE;
         }
     }
 
-	if (foundCount)
-	{
-		char numBuffer[32];
-		msg(" Found: %s\n", NumberCommaString(foundCount, numBuffer));
-	}	
-    return FALSE;
-}
-
-static BOOL findVftables(SegSelect::segments &segs)
-{
-    try
+    // Segments with rows edited since get rescanned too
+    UINT32 count = g_resultTable.size();
+    for (UINT32 i = 0; i < count; i++)
     {
-        TIMESTAMP startTime = GetTimeStamp();
+        if (g_resultTable.flags(i) & TBL_DIRTY)
+        {
+            if (segment_t *seg = getseg(g_resultTable.vft(i)))
+                unchangedSegs.erase(seg->start_ea);
+        }
+    }
 
-		// User selected segments
-		if (!segs.empty())
-		{
-            for (auto &seg: segs)
-			{
-				if (scanSeg4Vftables(&seg))
-					return FALSE;
-			}
-		}
-		else
-		// Scan data segments named
-		{
-			int segCount = get_segm_qty();
-			for (int i = 0; i < segCount; i++)
-			{
-				if (segment_t *seg = getnseg(i))
-				{
-					if (seg->type == SEG_DATA)
-					{
-						if (scanSeg4Vftables(seg))
-							return FALSE;
-					}
-				}
-			}
-		}
+    // Keep only the rows in the skipped segments
+    std::vector<BYTE> drop(count);
+    for (UINT32 i = 0; i < count; i++)
+        drop[i] = !inUnchangedSegment(g_resultTable.vft(i));
+    g_resultTable.remove(drop);
 
-        msg("Vftable scan took: %s\n", TimeString(GetTimeStamp() - startTime));
-        WaitBox::processIdaEvents();
+    // Their COLs are still needed to find vftables in the rescanned segments that use them
+    UINT32 colSize = (UINT32) (plat.is64 ? sizeof(RTTI::_RTTICompleteObjectLocator_64) : sizeof(RTTI::_RTTICompleteObjectLocator_32));
+    count = g_resultTable.size();
+    for (UINT32 i = 0; i < count; i++)
+    {
+        ea_t vft = g_resultTable.vft(i);
+        if (ea_t col = plat.getEa(vft - (ea_t) plat.ptrSize))
+            g_rttiStore.insert(col, RK_COL, colSize);
+        g_rttiStore.insert(vft, RK_VFT, (g_resultTable.methods(i) * plat.ptrSize));
     }
-    CATCH()
-    return FALSE;
-}
+    g_rttiStore.commit();
 
+    for (const SEGPRINT &p: scanPrints)
+    {
+        if (unchangedSegs.find((ea_t) p.start) != unchangedSegs.end())
+            skippedBytes += (p.end - p.start);
+    }
 
-// ================================================================================================
+    char buf1[32], buf2[32], buf3[32];
+    msg("Incremental rescan: %s of %s segments unchanged, %s skipped, %s stored rows kept (%s).\n", NumberCommaString((UINT32) unchangedSegs.size(), buf1),
+        NumberCommaString((UINT32) scanPrints.size(), buf2), byteSizeString(skippedBytes), NumberCommaString(count, buf3), TimeString(GetTimeStamp() - startTime));
+}
 
-// Gather RTTI data set
-static BOOL gatherRttiDataSet(SegSelect::segments &segs)
+// Save this scan's segment fingerprints
+static void saveSegmentPrints()
 {
-    // Free RTTI working data on return
-    struct OnReturn  { ~OnReturn(){	RTTI::freeWorkingData(); };} onReturn;
+    if (!scanPrints.empty())
+        netNode->setblob(scanPrints.data(), (scanPrints.size() * sizeof(SEGPRINT)), 0, NN_PRINT_TAG);
+}
 
+// Gather the RTTI types IDA placed, or from PDB placed names
+static BOOL gatherKnownTypes()
+{
     try
     {
-        // Gather known types by name from IDA RTTI places and/or PDB placed names
 		msg("\nLocating IDA placed RTTI types by name:\n");
         msg("-------------------------------------------------\n");
         WaitBox::processIdaEvents();
-        if(RTTI::gatherKnownRttiData())
-            return TRUE;
+        BOOL aborted = RTTI::gatherKnownRttiData();
+        commitAnnotations("Known types");
+        return aborted;
+    }
+    CATCH()
+    return TRUE;
+}
 
-        // ==== Find and process Complete Object Locators (COL)
-        msg("\nScanning for for Complete Object Locators:\n");
-		msg("-------------------------------------------------\n");
-        WaitBox::processIdaEvents();
-        if(findCols(segs))
-            return TRUE;
+// Wrap up a scan, once the worker is done, canceled, or didn't get started.
+// The list shows what was found, the partial result on an abort, unless the database is closing.
+static void endScan(BOOL aborted, BOOL closing)
+{
+    try
+    {
+        // Apply what the scan queued up to the end, unless the database is going away
+        if (!closing)
+        {
+            UINT32 objects, runs, creates;
+            RTTI::flushPlacements(objects, runs, creates);
+            commitAnnotations("Scan end");
+        }
+        RTTI::freeWorkingData();
+        if (!aborted)
+        {
+            // Commit the table in one write, then the fingerprints of the segments it covers
+            saveResultTable();
+            saveSegmentPrints();
 
-        // ==== Find and process vftables
-        msg("\nScanning for Virtual Function Tables:\n");
-		msg("-------------------------------------------------\n");
-        WaitBox::processIdaEvents();
-        if(findVftables(segs))
-			return TRUE;
+            // Optionally play completion sound if processing took more than a few seconds to notify user
+            if (g_optionAudioOnDone)
+            {
+                TIMESTAMP endTime = (GetTimeStamp() - s_startTime);
+                if (endTime > (TIMESTAMP) 2.4)
+                {
+                    OggPlay::endPlay();
+                    QFile file(QT_RES_PATH "completed.ogg");
+                    if (file.open(QFile::ReadOnly))
+                    {
+                        QByteArray ba = file.readAll();
+                        OggPlay::playFromMemory((const PVOID)ba.constData(), ba.size(), TRUE);
+                    }
+                }
+            }
+
+            showEndStats();
+            if (g_optionResultCache)
+                saveCachedResult(g_resultTable);
+            if (g_optionClassDb)
+                addResultToClassDb();
+        }
     }
     CATCH()
 
-    return FALSE;
+    saveResultTable();  // The partial result on an abort
+    tableTracker.suspend(FALSE);
+    tableTracker.reset();
+    refresh_idaview_anyway();
+    if (aborted)
+        msg("- Aborted -\n\n");
+    if (!closing)
+        showResultList(FALSE);
 }
 
 
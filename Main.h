@@ -3,25 +3,34 @@
 #pragma once
 
 
-extern BOOL getVerifyEa(ea_t ea, ea_t &rValue);
 extern BOOL hasAnteriorComment(ea_t ea);
-extern void addTableEntry(UINT32 flags, ea_t vft, int methodCount, LPCSTR format, ...);
+extern nodeidx_t getCachedTypeValue(UINT32 index);
+extern void setCachedTypeValue(UINT32 index, nodeidx_t value);
+extern void addTableEntry(UINT32 flags, ea_t vft, int methodCount, LPCSTR type, LPCSTR hierarchy);
+extern void loadResultTable();
+extern void useStoredTable();
 extern BOOL getPlainTypeName(__in LPCSTR mangled, __out_bcount(MAXSTR) LPSTR outStr);
 
 extern void fixDword(ea_t ea);
 extern void fixEa(ea_t ea);
 extern void fixFunction(ea_t eaFunc);
 
+// Name and comment edits are queued and committed in address order by commitAnnotations() at the end of each phase.
+// The "IfNone" forms only apply if the address has no name/comment at commit time.
 extern void setName(ea_t ea, __in LPCSTR name);
 extern void setComment(ea_t ea, LPCSTR comment, BOOL rptble);
 extern void setAnteriorComment(ea_t ea, const char *format, ...);
+extern void setNameIfNone(ea_t ea, __in LPCSTR name);
+extern void setCommentIfNone(ea_t ea, LPCSTR comment, BOOL rptble);
+extern void setAnteriorCommentIfNone(ea_t ea, const char *format, ...);
+extern void commitAnnotations(LPCSTR phase);
 inline void setUnknown(ea_t ea, int size) {	del_items(ea, DELIT_EXPAND, size); }
 
-// Return TRUE if there is a name at address that is not a dumbly name
-inline BOOL hasName(ea_t ea) { return has_name(get_flags(ea)); }
+// Return TRUE if there is a name at address that is not a dumbly name, including queued ones
+extern BOOL hasName(ea_t ea);
 
-// Return TRUE if there is a comment at address
-inline BOOL hasComment(ea_t ea) { return has_cmt(get_flags(ea)); }
+// Return TRUE if there is a comment at address, including queued ones
+extern BOOL hasComment(ea_t ea);
 
 // Get IDA 32 bit value with IDB existence verification
 template <class T> BOOL getVerify32(ea_t eaPtr, T& rValue)
@@ -36,6 +45,30 @@ template <class T> BOOL getVerify32(ea_t eaPtr, T& rValue)
 	return FALSE;
 }
 
+// Get IDA pointer size value with IDB existence verification
+template <class W> BOOL getVerifyEa(ea_t eaPtr, ea_t &rValue)
+{
+	// Location valid?
+	if (IS_VALID_ADDR(eaPtr))
+	{
+		// Get ea_t value
+		rValue = W::getEa(eaPtr);
+		return TRUE;
+	}
+	return FALSE;
+}
+
+// Force memory location to be pointer size
+template <class W> void fixEa(ea_t ea)
+{
+	if (!W::isEa(get_flags(ea)))
+	{
+		setUnknown(ea, W::ptrSize);
+		W::putEa(ea);
+		auto_wait();
+	}
+}
+
 // Segment cache container
 const UINT32 _CODE_SEG = (1 << 0);
 const UINT32 _DATA_SEG = (1 << 1);
@@ -47,4 +80,9 @@ struct SEGMENT
 };
 extern const SEGMENT *FindCachedSegment(ea_t addr);
 
+// Line background color for non parent/top level hierarchy lines
+// TOOD: Assumes text background is white. A way to make these user theme/style color aware?
+#define GRAY(v) RGB(v,v,v)
+const bgcolor_t NOT_PARENT_COLOR = GRAY(235);
+
 extern BOOL g_optionPlaceStructs;
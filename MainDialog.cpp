@@ -9,7 +9,7 @@
 #include <QtWidgets/QDialogButtonBox>
 
 
-MainDialog::MainDialog(BOOL &optionPlaceStructs, BOOL &optionProcessStatic, BOOL &optionAudioOnDone, SegSelect::segments &segs, qstring &version, size_t animSwitch) : QDialog(QApplication::activeWindow())
+MainDialog::MainDialog(BOOL &optionPlaceStructs, BOOL &optionProcessStatic, BOOL &optionAudioOnDone, BOOL &optionResultCache, BOOL &optionClassDb, SegSelect::segments &segs, qstring &version, size_t animSwitch) : QDialog(QApplication::activeWindow())
 {
     Ui::MainCIDialog::setupUi(this);
     setWindowFlags(windowFlags() & ~Qt::WindowContextHelpButtonHint);
@@ -20,6 +20,8 @@ MainDialog::MainDialog(BOOL &optionPlaceStructs, BOOL &optionProcessStatic, BOOL
     INITSTATE(checkBox1, optionPlaceStructs);
     INITSTATE(checkBox2, optionProcessStatic);
     INITSTATE(checkBox3, optionAudioOnDone);
+    INITSTATE(checkBox4, optionResultCache);
+    INITSTATE(checkBox5, optionClassDb);
     #undef INITSTATE
 
     // Apply style sheet
@@ -68,16 +70,18 @@ void MainDialog::segmentSelect()
 }
 
 // Do main dialog, return TRUE if canceled
-BOOL doMainDialog(BOOL &optionPlaceStructs, BOOL &optionProcessStatic, BOOL &optionAudioOnDone, __out SegSelect::segments &segs, qstring &version, size_t animSwitch)
+BOOL doMainDialog(BOOL &optionPlaceStructs, BOOL &optionProcessStatic, BOOL &optionAudioOnDone, BOOL &optionResultCache, BOOL &optionClassDb, __out SegSelect::segments &segs, qstring &version, size_t animSwitch)
 {
 	BOOL result = TRUE;
-    MainDialog *dlg = new MainDialog(optionPlaceStructs, optionProcessStatic, optionAudioOnDone, segs, version, animSwitch);
+    MainDialog *dlg = new MainDialog(optionPlaceStructs, optionProcessStatic, optionAudioOnDone, optionResultCache, optionClassDb, segs, version, animSwitch);
     if (dlg->exec())
     {
         #define CHECKSTATE(obj,var) var = dlg->obj->isChecked()
         CHECKSTATE(checkBox1, optionPlaceStructs);
         CHECKSTATE(checkBox2, optionProcessStatic);
         CHECKSTATE(checkBox3, optionAudioOnDone);
+        CHECKSTATE(checkBox4, optionResultCache);
+        CHECKSTATE(checkBox5, optionClassDb);
         #undef CHECKSTATE
 		result = FALSE;
     }
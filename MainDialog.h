@@ -12,7 +12,7 @@ class MainDialog : public QDialog, public Ui::MainCIDialog
 {
     Q_OBJECT
 public:
-    MainDialog(BOOL &optionPlaceStructs, BOOL &optionProcessStatic, BOOL &optionAudioOnDone, SegSelect::segments &segs, qstring &version, size_t animSwitch);
+    MainDialog(BOOL &optionPlaceStructs, BOOL &optionProcessStatic, BOOL &optionAudioOnDone, BOOL &optionResultCache, BOOL &optionClassDb, SegSelect::segments &segs, qstring &version, size_t animSwitch);
 
 private:	
 	SegSelect::segments *segs;
@@ -22,4 +22,4 @@ private slots:
 };
 
 // Do main dialog, return TRUE if canceled
-BOOL doMainDialog(BOOL &optionPlaceStructs, BOOL &optionProcessStatic, BOOL &optionAudioOnDone, __out SegSelect::segments &segs, qstring &version, size_t animSwitch);
+BOOL doMainDialog(BOOL &optionPlaceStructs, BOOL &optionProcessStatic, BOOL &optionAudioOnDone, BOOL &optionResultCache, BOOL &optionClassDb, __out SegSelect::segments &segs, qstring &version, size_t animSwitch);
@@ -4,6 +4,10 @@
 #include "Main.h"
 #include "RTTI.h"
 #include "Vftable.h"
+#include "RttiStore.h"
+#include "RttiNameIndex.h"
+#include "Arena.h"
+#include "RttiTypes.h"
 #include <WaitBoxEx.h>
 
 // const Name::`vftable'
@@ -32,40 +36,63 @@ static LPCSTR FORMAT_RTTI_COL = "??_R4%s6B@";
 // Class name list container
 struct bcdInfo
 {
-    char m_name[MAXSTR];
+    LPSTR m_name;
     UINT32 m_attribute;
 	RTTI::PMD m_pmd;
 };
-typedef std::vector<bcdInfo> bcdList;
 
-// Cache of IDA strings we have already read for performance
-static std::map<ea_t, qstring> stringCache;
+// Vftable phase temporaries arena, rewound after each vftable
+static Arena vftArena;
+
+// Queued RTTI structure placement.
+// Placing each object on its own costs an undefine plus a create, each kicking off IDA re-analysis. Since RTTI data
+// is mostly packed together, placements are queued, then sorted and merged into runs of adjacent objects that get
+// a single undefine each before the structures are created.
+struct PLACEMENT
+{
+    ea_t ea;
+    UINT32 size;   // Full extent, for type_info including the name string and alignment
+    UINT32 extra;  // type_info name length, BCD "has CHD" flag
+    tid_t tid;
+};
+static std::vector<PLACEMENT> placementQueue;
+static const size_t PLACEMENT_LIMIT = 16384;
 
-// Set of known RTTI types to address location
-static eaSet tdSet;  // Known "type_info" type defines set
-static eaSet chdSet; // _RTTIClassHierarchyDescriptor "Class Hierarchy Descriptor" (CHD) set
-static eaSet bcdSet; // _RTTIBaseClassDescriptor "Base Class Descriptor" (BCD) set
-eaSet vftSet;    // `vftable'
-eaSet colSet;    // _RTTICompleteObjectLocator "Complete Object Locator" (COL) set
-eaSet superSet;  // Combined for faster scanning
+// Placement counters
+static struct
+{
+    UINT32 objects, runs, creates;  // Creates are the successful create_struct() calls
+} placementStats;
 
-#define IN_SUPER(_addr) (superSet.find(_addr) != superSet.end())
-#define TO_INT64(_uint32) ((INT64) *((PINT32) &_uint32))
+// Cache of IDA strings we have already read for performance
+static std::map<ea_t, qstring> stringCache;
 
 namespace RTTI
 {
-    void getBCDInfo(ea_t col, __out bcdList& nameList, __out UINT32& numBaseClasses);
+    template <class W> bcdInfo *getBCDInfo(ea_t col, __out UINT32& numBaseClasses);
 };
 
 void RTTI::freeWorkingData()
 {
     stringCache.clear();
-    tdSet.clear();
-    chdSet.clear();
-    bcdSet.clear();
-    colSet.clear();
-    vftSet.clear();
-    superSet.clear();
+    g_rttiStore.clear();
+    vftArena.release();
+    placementQueue.clear();
+    ZeroMemory(&placementStats, sizeof(placementStats));
+}
+
+// Fixed store extent of an RTTI object kind. For type_info it's just the header, the name length varies.
+static UINT32 kindSize(BYTE kind)
+{
+    switch (kind)
+    {
+        case RK_TD:  return (plat.is64 ? offsetof(RTTI::type_info_64, _M_d_name) : offsetof(RTTI::type_info_32, _M_d_name));
+        case RK_BCD: return sizeof(RTTI::_RTTIBaseClassDescriptor);
+        case RK_CHD: return sizeof(RTTI::_RTTIClassHierarchyDescriptor);
+        case RK_COL: return (plat.is64 ? sizeof(RTTI::_RTTICompleteObjectLocator_64) : sizeof(RTTI::_RTTICompleteObjectLocator_32));
+        case RK_VFT: return plat.ptrSize;
+    };
+    return 0;
 }
 
 // Make a mangled number string for labeling
@@ -146,8 +173,8 @@ static void typeDump(tinfo_t &tinf)
 	msg("type dump: \n\"%s\".\n", out.c_str());
 }
 
-// Look for existing type from a list of names
-static tid_t GetKnownTypeID(LPCSTR names[], int namesCount, asize_t expectedTypeSize)
+// Look for existing type from a list of names, of either the known layout size or our own definition's size
+static tid_t GetKnownTypeID(LPCSTR names[], int namesCount, asize_t expectedTypeSize, asize_t ownTypeSize)
 {
 	for (int i = 0; i < namesCount; i++)
 	{
@@ -160,7 +187,7 @@ static tid_t GetKnownTypeID(LPCSTR names[], int namesCount, asize_t expectedType
                 //tinf.print(&out);
                 //msg("print: \"%s\".\n", out.c_str());
                 asize_t size = tinf.get_size();
-                if (size == expectedTypeSize)
+                if ((size == expectedTypeSize) || (size == ownTypeSize))
                 {
                     // TODO: Could verify the type
                     //type_t _decltype = tinf.get_decltype(); // Looking for struct but it will be BTF_TYPEDEF
@@ -174,6 +201,72 @@ static tid_t GetKnownTypeID(LPCSTR names[], int namesCount, asize_t expectedType
 	return BADADDR;
 }
 
+// RTTI type table, in declaration order
+struct RTTI_TYPE
+{
+    tid_t *id;
+    LPCSTR name;          // Our definition's name
+    LPCSTR *knownNames;   // Existing names to look for first, I.E. from a PDB
+    int knownCount;
+    asize_t size;         // Expected size for the IDB's pointer width, as in the CRT source and PDBs
+    asize_t ownSize;      // Size of our own definition, differs from 'size' for some of the 64bit ones
+};
+
+// Netnode cached type IDs, index 0 holds the cache signature
+#define TYPE_CACHE_VERSION 1
+static inline nodeidx_t typeCacheSignature() { return (((nodeidx_t) TYPE_CACHE_VERSION << 8) | (plat.is64 ? 64 : 32)); }
+
+// Return TRUE if a cached type ID still resolves to a structure of the expected size
+static BOOL isValidTypeId(tid_t tid, const RTTI_TYPE &type)
+{
+    tinfo_t tinf;
+    return(tinf.get_type_by_tid(tid) && tinf.is_udt() && ((tinf.get_size() == type.size) || (tinf.get_size() == type.ownSize)));
+}
+
+// Append the declaration of one struct from the fallback declarations, through its closing "};"
+static BOOL getTypeDecl(LPCSTR decls, LPCSTR name, __out qstring &decl)
+{
+    qstring head;
+    head.sprnt("struct %s", name);
+    for (LPCSTR start = strstr(decls, head.c_str()); start; start = strstr((start + 1), head.c_str()))
+    {
+        // Not just the start of a longer name
+        char next = start[head.length()];
+        if ((next == '\r') || (next == '\n') || (next == ' '))
+        {
+            if (LPCSTR end = strstr(start, "};"))
+            {
+                decl.append(start, ((end + 2) - start));
+                decl += "\n";
+                return TRUE;
+            }
+        }
+    }
+    return FALSE;
+}
+
+// Load our prebuilt type library from the plugin's directory, else from IDA's til search path
+static til_t *loadRttiTil()
+{
+    LPCSTR tilName = (plat.is64 ? RTTI_TIL_NAME64 : RTTI_TIL_NAME32);
+    qstring errbuf;
+
+    HMODULE module = NULL;
+    char path[MAX_PATH];
+    if (GetModuleHandleEx((GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT | GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS), (LPCTSTR) &loadRttiTil, &module) &&
+        GetModuleFileNameA(module, path, sizeof(path)))
+    {
+        LPSTR fileName = strrchr(path, '\\');
+        if (fileName)
+        {
+            *fileName = 0;
+            if (til_t *til = load_til(tilName, &errbuf, path))
+                return til;
+        }
+    }
+    return load_til(tilName, &errbuf);
+}
+
 void RTTI::addDefinitionsToIda()
 {
     // std::type_info, aka "_TypeDescriptor" and "_RTTITypeDescriptor" in CRT source, class representation
@@ -186,409 +279,326 @@ void RTTI::addDefinitionsToIda()
         "_TypeDescriptor",
         "TypeDescriptor"
     };
-    // Look for existing type by name
-    s_type_info_ID = GetKnownTypeID(type_info_names, _countof(type_info_names), (plat.is64 ? sizeof(type_info_64) : sizeof(type_info_32)));
-
-    // Not found so create it
-	if (s_type_info_ID == BADADDR)
-	{
-		LPCSTR def = R"DEF(
-            // RTTI std::type_info class (#classinformer)
-            struct type_info
-            {
-                const void *vfptr;
-                void *_M_data;
-                char _M_d_name[];
-            };
-        )DEF";
-        if (parse_decls(NULL, def, msg, HTI_DCL) != 0)
-            msg("** addDefinitionsToIda():  \"type_info\" create failed! **\n");
-        s_type_info_ID = get_named_type_tid("type_info");
-
-        // Set the representation of the "name" field to a string literal
-     // TODO: Can put __strlit(C) in the definition?
-		if (s_type_info_ID != BADADDR)
-		{
-			tinfo_t tinf;
-			value_repr_t repr;
-			if (tinf.get_type_by_tid(s_type_info_ID) && repr.parse_value_repr("__strlit(C,\"windows - 1252\");" /*"__strlit(C)"*/))
-			{
-				tinf.set_udm_repr(2, repr);
-                //typeDump(tinf);
-			}
-		}
-	}
-
-    // PDM
 	static LPCSTR pdm_names[] =	{ "_PDM", "PDM" };
-    s_PMD_ID = GetKnownTypeID(pdm_names, _countof(pdm_names), sizeof(PMD));
-	if (s_PMD_ID == BADADDR)
-	{
-		LPCSTR def = R"DEF(
-            // RTTI Base class descriptor displacement container (#classinformer)
-            struct PMD
-            {
-                int mdisp;
-                int pdisp;
-                int vdisp;
-            };
-        )DEF";
-		if (parse_decls(NULL, def, msg, HTI_DCL) != 0)
-			msg("** addDefinitionsToIda():  \"PMD\" create failed! **\n");
-        s_PMD_ID = get_named_type_tid("PMD");
-        /*
-		tinfo_t tinf;
-		if (tinf.get_type_by_tid(s_PMD_ID))
-            typeDump(tinf);
-        */
-	}
-
-    // _RTTIClassHierarchyDescriptor
 	static LPCSTR chd_names[] = { "_s__RTTIClassHierarchyDescriptor",	"__RTTIClassHierarchyDescriptor", "_RTTIClassHierarchyDescriptor", "RTTIClassHierarchyDescriptor" };
-    s_ClassHierarchyDescriptor_ID = GetKnownTypeID(chd_names, _countof(chd_names), (sizeof(_RTTIClassHierarchyDescriptor) + (plat.is64 ? sizeof(UINT32) : 0))); // The 64bit one in the CRT source shows it's a pointer while it's an int offset in binary
-    if (s_ClassHierarchyDescriptor_ID == BADADDR)
+	static LPCSTR bcd_names[] = { "_s__RTTIBaseClassDescriptor", "__RTTIBaseClassDescriptor", "_RTTIBaseClassDescriptor", "RTTIBaseClassDescriptor" };
+    static LPCSTR col_names[] = { "_s__RTTICompleteObjectLocator2", "_s__RTTICompleteObjectLocator", "__RTTICompleteObjectLocator", "_RTTICompleteObjectLocator", "RTTICompleteObjectLocator" };
+
+    // The 64bit CHD in the CRT source shows a pointer while it's an int offset in binary.
+    // Our own 64bit definitions use the int offsets, so they are smaller than the CRT source layouts.
+    RTTI_TYPE types[] =
     {
-        LPCSTR def;
-        if (!plat.is64)
-        {
-            // 32bit
-            def = R"DEF(
-                // RTTI Class Hierarchy Descriptor (#classinformer)
-                struct _RTTIClassHierarchyDescriptor
-                {
-                    unsigned int signature;
-                    unsigned int attributes;
-                    unsigned int numBaseClasses;
-                    void *baseClassArray; // _RTTIBaseClassArray*
-                };
-            )DEF";
-        }
-        else
+        { &s_type_info_ID, "type_info", type_info_names, _countof(type_info_names), (plat.is64 ? sizeof(type_info_64) : sizeof(type_info_32)), (plat.is64 ? sizeof(type_info_64) : sizeof(type_info_32)) },
+        { &s_PMD_ID, "PMD", pdm_names, _countof(pdm_names), sizeof(PMD), sizeof(PMD) },
+        { &s_ClassHierarchyDescriptor_ID, "_RTTIClassHierarchyDescriptor", chd_names, _countof(chd_names), (sizeof(_RTTIClassHierarchyDescriptor) + (plat.is64 ? sizeof(UINT32) : 0)), sizeof(_RTTIClassHierarchyDescriptor) },
+        { &s_BaseClassDescriptor_ID, "_RTTIBaseClassDescriptor", bcd_names, _countof(bcd_names), (sizeof(_RTTIBaseClassDescriptor) + (plat.is64 ? sizeof(UINT64) : 0)), sizeof(_RTTIBaseClassDescriptor) },
+        { &s_CompleteObjectLocator_ID, "_RTTICompleteObjectLocator", col_names, _countof(col_names), (sizeof(_RTTICompleteObjectLocator) + (plat.is64 ? 16 : 0)), (plat.is64 ? sizeof(_RTTICompleteObjectLocator_64) : sizeof(_RTTICompleteObjectLocator)) }
+    };
+
+    // Use the type IDs cached from a previous session if they all still check out
+    if (getCachedTypeValue(0) == typeCacheSignature())
+    {
+        BOOL valid = TRUE;
+        for (UINT32 i = 0; valid && (i < _countof(types)); i++)
         {
-            // 64bit
-            def = R"DEF(
-                // RTTI Class Hierarchy Descriptor (#classinformer)
-                struct _RTTIClassHierarchyDescriptor
-                {
-                    unsigned int signature;
-                    unsigned int attributes;
-                    unsigned int numBaseClasses;
-                    int baseClassArray;
-                };
-            )DEF";
+            *types[i].id = (tid_t) getCachedTypeValue(i + 1);
+            valid = isValidTypeId(*types[i].id, types[i]);
         }
-        if (parse_decls(NULL, def, msg, HTI_DCL) != 0)
-            msg("** addDefinitionsToIda():  \"_RTTIClassHierarchyDescriptor\" create failed! **\n");
-        s_ClassHierarchyDescriptor_ID = get_named_type_tid("_RTTIClassHierarchyDescriptor");
-        /*
-        tinfo_t tinf;
-        if (tinf.get_type_by_tid(s_ClassHierarchyDescriptor_ID))
-            typeDump(tinf);
-        */
+        if (valid)
+            return;
     }
 
-    // _RTTIBaseClassDescriptor
-	static LPCSTR bcd_names[] = { "_s__RTTIBaseClassDescriptor", "__RTTIBaseClassDescriptor", "_RTTIBaseClassDescriptor", "RTTIBaseClassDescriptor" };
-    s_BaseClassDescriptor_ID = GetKnownTypeID(bcd_names, _countof(bcd_names), (sizeof(_RTTIBaseClassDescriptor) + (plat.is64 ? sizeof(UINT64) : 0)));
-    if (s_BaseClassDescriptor_ID == BADADDR)
+    // Look for existing types by name
+    UINT32 missing = 0;
+    for (RTTI_TYPE &t: types)
     {
-		LPCSTR def;
-        if (!plat.is64)
+        *t.id = GetKnownTypeID(t.knownNames, t.knownCount, t.size, t.ownSize);
+        if (*t.id == BADADDR)
+            missing++;
+    }
+
+    // Create the missing ones
+    if (missing)
+    {
+        BOOL createTypeInfo = (s_type_info_ID == BADADDR);
+        // From the prebuilt type library with one import per type
+        BOOL imported = FALSE;
+        if (til_t *til = loadRttiTil())
         {
-			// 32bit
-			def = R"DEF(
-                // RTTI Base class descriptor displacement container (#classinformer)
-                struct _RTTIBaseClassDescriptor
-	            {
-		            int typeDescriptor;
-		            unsigned int numContainedBases;
-		            PMD pmd;
-		            unsigned int attributes;
-		            void *classDescriptor;  // _RTTIClassHierarchyDescriptor*
-                };
-            )DEF";
+            imported = TRUE;
+            for (RTTI_TYPE &t: types)
+            {
+                if (*t.id == BADADDR)
+                {
+                    *t.id = import_type(til, -1, t.name, IMPTYPE_LOCAL);
+                    if (*t.id == BADADDR)
+                        imported = FALSE;
+                }
+            }
+            free_til(til);
         }
-        else
+
+        // Else, or if the library is stale, from the declarations of just the missing ones in one parse.
+        // Plus our PMD for the BCD declaration to use when there's no type by that name.
+        if (!imported)
         {
-            // 64bit
-            def = R"DEF(
-                // RTTI Base class descriptor displacement container (#classinformer)
-                struct _RTTIBaseClassDescriptor
-	            {
-		            int typeDescriptor;
-		            unsigned int numContainedBases;
-		            PMD pmd;
-		            unsigned int attributes;
-		            int classDescriptor;
-                };
-            )DEF";
+            LPCSTR decls = (plat.is64 ? RTTI_TYPES_DECL64 : RTTI_TYPES_DECL32);
+            qstring missingDecls;
+            for (RTTI_TYPE &t: types)
+            {
+                BOOL needed = (*t.id == BADADDR);
+                if (!needed && (t.id == &s_PMD_ID) && (s_BaseClassDescriptor_ID == BADADDR) && (get_named_type_tid(t.name) == BADADDR))
+                    needed = TRUE;
+                if (needed && !getTypeDecl(decls, t.name, missingDecls))
+                    msg("** addDefinitionsToIda(): No \"%s\" declaration! **\n", t.name);
+            }
+
+            if (parse_decls(NULL, missingDecls.c_str(), msg, HTI_DCL) != 0)
+                msg("** addDefinitionsToIda(): RTTI type create failed! **\n");
+            for (RTTI_TYPE &t: types)
+            {
+                if (*t.id == BADADDR)
+                    *t.id = get_named_type_tid(t.name);
+            }
         }
-        if (parse_decls(NULL, def, msg, HTI_DCL) != 0)
-            msg("** addDefinitionsToIda():  \"_RTTIBaseClassDescriptor\" create failed! **\n");
-        s_BaseClassDescriptor_ID = get_named_type_tid("_RTTIBaseClassDescriptor");
-        /*
+
+        // Set the representation of our type_info "name" field to a string literal
+        // TODO: Can put __strlit(C) in the definition?
         tinfo_t tinf;
-        if (tinf.get_type_by_tid(s_BaseClassDescriptor_ID))
-            typeDump(tinf);
-        */
+        value_repr_t repr;
+        if (createTypeInfo && (s_type_info_ID != BADADDR) && tinf.get_type_by_tid(s_type_info_ID) &&
+            repr.parse_value_repr("__strlit(C,\"windows - 1252\");" /*"__strlit(C)"*/))
+        {
+            tinf.set_udm_repr(2, repr);
+            //typeDump(tinf);
+        }
     }
 
-    // _RTTICompleteObjectLocator
-    static LPCSTR col_names[] = { "_s__RTTICompleteObjectLocator2", "_s__RTTICompleteObjectLocator", "__RTTICompleteObjectLocator", "_RTTICompleteObjectLocator", "RTTICompleteObjectLocator" };
-    s_CompleteObjectLocator_ID = GetKnownTypeID(col_names, _countof(col_names), (sizeof(_RTTICompleteObjectLocator) + (plat.is64 ? 16 : 0)));
-    if (s_CompleteObjectLocator_ID == BADADDR)
+    // Cache them for the next session
+    BOOL complete = TRUE;
+    for (UINT32 i = 0; i < _countof(types); i++)
     {
-		LPCSTR def;
-		if (!plat.is64)
-		{
-			// 32bit
-			def = R"DEF(
-                // RTTI Complete Object Locator (#classinformer)
-                struct _RTTICompleteObjectLocator
-                {
-               	    unsigned int signature;
-               	    unsigned int offset;
-               	    unsigned int cdOffset;
-               	    void *typeDescriptor;   // type_info*
-               	    void *classDescriptor;  // _RTTIClassHierarchyDescriptor*
-                };
-            )DEF";
-		}
-		else
-		{
-			// 64bit
-			def = R"DEF(
-                // RTTI Complete Object Locator (#classinformer)
-                struct _RTTICompleteObjectLocator
-                {
-               	    unsigned int signature;
-               	    unsigned int offset;
-               	    unsigned int cdOffset;
-               	    int typeDescriptor;
-               	    int classDescriptor;
-                    int objectBase;
-                };
-            )DEF";
-		}
-        if (parse_decls(NULL, def, msg, HTI_DCL) != 0)
-            msg("** addDefinitionsToIda():  \"_RTTICompleteObjectLocator\" create failed! **\n");
-        s_CompleteObjectLocator_ID = get_named_type_tid("_RTTICompleteObjectLocator");
-        /*
-        tinfo_t tinf;
-        if (tinf.get_type_by_tid(s_CompleteObjectLocator_ID))
-            typeDump(tinf);       
-        */
+        if (*types[i].id == BADADDR)
+        {
+            msg("** addDefinitionsToIda(): \"%s\" not available! **\n", types[i].name);
+            complete = FALSE;
+        }
+        setCachedTypeValue((i + 1), (nodeidx_t) *types[i].id);
     }
+    setCachedTypeValue(0, (complete ? typeCacheSignature() : 0));
 }
 
 
-// Place an RTTI structure by type ID add address w/optional name
-// Returns TRUE if structure was placed, else FLASE it was already set
-static BOOL tryStructRTTI(ea_t ea, tid_t tid, __in_opt LPSTR typeName = NULL, BOOL bHasChd = FALSE)
+// Place an RTTI structure by type ID at address, the undefine already done for its run.
+// Returns TRUE if placed as a structure, FALSE if the fields had to be placed individually.
+template <class W> static BOOL placeStructRTTI(const PLACEMENT &pe)
 {
-    if (tid == BADADDR)
-    {
-        _ASSERT(FALSE);
-        return FALSE;
-    }
-
     #define put32(ea) create_dword(ea, sizeof(EA_32), TRUE)
-    #define put64(ea) create_qword(ea, sizeof(ea_t), TRUE)
+    ea_t ea = pe.ea;
+    BOOL result = FALSE;
 
     // type_info
-	if(tid == s_type_info_ID)
+	if(pe.tid == s_type_info_ID)
 	{
-        if (!plat.is64)
+        typedef typename W::td_t TD;
+        UINT32 nameLen = pe.extra;
+        UINT32 structSize = (offsetof(TD, _M_d_name) + nameLen);
+        if (g_optionPlaceStructs && (!W::is64 || (s_type_info_ID > 5)))
+            result = create_struct(ea, structSize, s_type_info_ID);
+        if (!result)
         {
-            // EA_32
-            if (!hasName(ea))
-            {
-                _ASSERT(typeName != NULL);
-                UINT32 nameLen = (UINT32) (strlen(typeName) + 1);
-                UINT32 structSize = (offsetof(RTTI::type_info_32, _M_d_name) + nameLen);
-
-                // Place struct
-                setUnknown(ea, structSize);
-                BOOL result = FALSE;
-                if (g_optionPlaceStructs)
-                    result = create_struct(ea, structSize, s_type_info_ID);
-                if (!result)
-                {
-                    // Else fix/place the proper type fields and name it
-                    put32(ea + offsetof(RTTI::type_info_32, vfptr));
-                    put32(ea + offsetof(RTTI::type_info_32, _M_data));
-                    create_strlit((ea + offsetof(RTTI::type_info_32, _M_d_name)), nameLen, STRTYPE_C);
-                }
-
-                // sh!ft: End should be aligned
-                ea_t end = (ea + offsetof(RTTI::type_info_32, _M_d_name) + nameLen);
-                if (end % 4)
-                    create_align(end, (4 - (end % 4)), 0);
-
-                return TRUE;
-            }
-        }
-        else
-        {
-            // EA_64
-            if (!hasName(ea))
-            {
-                _ASSERT(typeName != NULL);
-                UINT32 nameLen = (UINT32) (strlen(typeName) + 1);
-                UINT32 structSize = (offsetof(RTTI::type_info_64, _M_d_name) + nameLen);
-
-                // Place struct
-                setUnknown(ea, structSize);
-                BOOL result = FALSE;
-                if (g_optionPlaceStructs && (s_type_info_ID > 5))
-                    result = create_struct(ea, structSize, s_type_info_ID);
-                if (!result)
-                {
-                    put64(ea + offsetof(RTTI::type_info_64, vfptr));
-                    put64(ea + offsetof(RTTI::type_info_64, _M_data));
-                    create_strlit((ea + offsetof(RTTI::type_info_64, _M_d_name)), nameLen, STRTYPE_C);
-                }
-
-                // sh!ft: End should be aligned
-             #pragma message(__LOC2__ "  >> Should be align 8? Do we really even need this?")
-                ea_t end = (ea + offsetof(RTTI::type_info_64, _M_d_name) + nameLen);
-                if (end % 4)
-                    create_align(end, (4 - (end % 4)), 0);
-
-                return TRUE;
-            }
+            // Else fix/place the proper type fields and name it
+            W::putEa(ea + offsetof(TD, vfptr));
+            W::putEa(ea + offsetof(TD, _M_data));
+            create_strlit((ea + offsetof(TD, _M_d_name)), nameLen, STRTYPE_C);
         }
 
-        return FALSE;
+        // sh!ft: End should be aligned
+     #pragma message(__LOC2__ "  >> Should be align 8 for 64bit? Do we really even need this?")
+        ea_t end = (ea + structSize);
+        if (end % 4)
+            create_align(end, (4 - (end % 4)), 0);
 	}
-
+    else
     // _RTTIClassHierarchyDescriptor
-	if (tid == s_ClassHierarchyDescriptor_ID)
+	if (pe.tid == s_ClassHierarchyDescriptor_ID)
 	{
-		if (!hasName(ea))
+		if (g_optionPlaceStructs)
+			result = create_struct(ea, sizeof(RTTI::_RTTIClassHierarchyDescriptor), s_ClassHierarchyDescriptor_ID);
+		if (!result)
 		{
-			setUnknown(ea, sizeof(RTTI::_RTTIClassHierarchyDescriptor));
-			BOOL result = FALSE;
-			if (g_optionPlaceStructs)
-				result = create_struct(ea, sizeof(RTTI::_RTTIClassHierarchyDescriptor), s_ClassHierarchyDescriptor_ID);
-			if (!result)
-			{
-				put32(ea + offsetof(RTTI::_RTTIClassHierarchyDescriptor, signature));
-				put32(ea + offsetof(RTTI::_RTTIClassHierarchyDescriptor, attributes));
-				put32(ea + offsetof(RTTI::_RTTIClassHierarchyDescriptor, numBaseClasses));
-				put32(ea + offsetof(RTTI::_RTTIClassHierarchyDescriptor, baseClassArray));
-			}
-
-			return TRUE;
+			put32(ea + offsetof(RTTI::_RTTIClassHierarchyDescriptor, signature));
+			put32(ea + offsetof(RTTI::_RTTIClassHierarchyDescriptor, attributes));
+			put32(ea + offsetof(RTTI::_RTTIClassHierarchyDescriptor, numBaseClasses));
+			put32(ea + offsetof(RTTI::_RTTIClassHierarchyDescriptor, baseClassArray));
 		}
-
-        return FALSE;
 	}
-
+    else
     // PMD
-	if(tid == s_PMD_ID)
+	if(pe.tid == s_PMD_ID)
 	{
-		if (!hasName(ea))
+		if (g_optionPlaceStructs)
+			result = create_struct(ea, sizeof(RTTI::PMD), s_PMD_ID);
+		if (!result)
 		{
-			setUnknown(ea, sizeof(RTTI::PMD));
-			BOOL result = FALSE;
-			if (g_optionPlaceStructs)
-				result = create_struct(ea, sizeof(RTTI::PMD), s_PMD_ID);
-			if (!result)
-			{
-                put32(ea + offsetof(RTTI::PMD, mdisp));
-                put32(ea + offsetof(RTTI::PMD, pdisp));
-                put32(ea + offsetof(RTTI::PMD, vdisp));
-			}
-
-			return TRUE;
+            put32(ea + offsetof(RTTI::PMD, mdisp));
+            put32(ea + offsetof(RTTI::PMD, pdisp));
+            put32(ea + offsetof(RTTI::PMD, vdisp));
 		}
-
-        return FALSE;
 	}
-
+    else
 	// _RTTICompleteObjectLocator
-	if(tid == s_CompleteObjectLocator_ID)
+	if(pe.tid == s_CompleteObjectLocator_ID)
 	{
-        if (!plat.is64)
+        typedef typename W::col_t COL;
+        if (g_optionPlaceStructs)
+            result = create_struct(ea, sizeof(COL), s_CompleteObjectLocator_ID);
+        if (!result)
         {
-            // EA_32
-            if (!hasName(ea))
-            {
-                setUnknown(ea, sizeof(RTTI::_RTTICompleteObjectLocator_32));
-                BOOL result = FALSE;
-                if (g_optionPlaceStructs)
-                    result = create_struct(ea, sizeof(RTTI::_RTTICompleteObjectLocator_32), s_CompleteObjectLocator_ID);
-                if (!result)
-                {
-                    put32(ea + offsetof(RTTI::_RTTICompleteObjectLocator_32, signature));
-                    put32(ea + offsetof(RTTI::_RTTICompleteObjectLocator_32, offset));
-                    put32(ea + offsetof(RTTI::_RTTICompleteObjectLocator_32, cdOffset));
-                    put32(ea + offsetof(RTTI::_RTTICompleteObjectLocator_32, typeDescriptor));
-                    put32(ea + offsetof(RTTI::_RTTICompleteObjectLocator_32, classDescriptor));
-                }
-
-                return TRUE;
-            }
+            put32(ea + offsetof(COL, signature));
+            put32(ea + offsetof(COL, offset));
+            put32(ea + offsetof(COL, cdOffset));
+            put32(ea + offsetof(COL, typeDescriptor));
+            put32(ea + offsetof(COL, classDescriptor));
+            if constexpr (W::is64)
+                put32(ea + offsetof(RTTI::_RTTICompleteObjectLocator_64, objectBase));
         }
-        else
+	}
+    else
+	// _RTTIBaseClassDescriptor
+	if (pe.tid == s_BaseClassDescriptor_ID)
+	{
+        if (g_optionPlaceStructs)
+            result = create_struct(ea, sizeof(RTTI::_RTTIBaseClassDescriptor), s_BaseClassDescriptor_ID);
+        if (!result)
         {
-            // EA_64
-			if (!hasName(ea))
-			{
-				setUnknown(ea, sizeof(RTTI::_RTTICompleteObjectLocator_64));
-				BOOL result = FALSE;
-				if (g_optionPlaceStructs)
-					result = create_struct(ea, sizeof(RTTI::_RTTICompleteObjectLocator_64), s_CompleteObjectLocator_ID);
-				if (!result)
-				{
-					put32(ea + offsetof(RTTI::_RTTICompleteObjectLocator_64, signature));
-					put32(ea + offsetof(RTTI::_RTTICompleteObjectLocator_64, offset));
-					put32(ea + offsetof(RTTI::_RTTICompleteObjectLocator_64, cdOffset));
-					put32(ea + offsetof(RTTI::_RTTICompleteObjectLocator_64, typeDescriptor));
-					put32(ea + offsetof(RTTI::_RTTICompleteObjectLocator_64, classDescriptor));
-					put32(ea + offsetof(RTTI::_RTTICompleteObjectLocator_64, objectBase));
-				}
-
-				return TRUE;
-			}
+            put32(ea + offsetof(RTTI::_RTTIBaseClassDescriptor, typeDescriptor));
+            put32(ea + offsetof(RTTI::_RTTIBaseClassDescriptor, numContainedBases));
+            put32(ea + offsetof(RTTI::_RTTIBaseClassDescriptor, attributes));
+            //if (bHasChd)
+            put32(ea + offsetof(RTTI::_RTTIBaseClassDescriptor, classDescriptor));
+            if (pe.extra)
+                setComment((ea + offsetof(RTTI::_RTTIBaseClassDescriptor, classDescriptor)), "BCD_HASPCHD set", TRUE);
         }
-
-        return FALSE;
 	}
+    else
+	    _ASSERT(FALSE);
 
-	// _RTTIBaseClassDescriptor
-	if (tid == s_BaseClassDescriptor_ID)
-	{
-        // Recursive
-        //msg("PMD: 0x%llX\n", (ea + offsetof(RTTI::_RTTIBaseClassDescriptor, pmd)));
-        tryStructRTTI(ea + offsetof(RTTI::_RTTIBaseClassDescriptor, pmd), s_PMD_ID);
+    #undef put32
+    return result;
+}
+
+// Place the queued structures
+template <class W> static void flushPlacements()
+{
+    if (placementQueue.empty())
+        return;
+
+    // By address, containers ahead of the objects they contain
+    std::sort(placementQueue.begin(), placementQueue.end(), [](const PLACEMENT &a, const PLACEMENT &b) { return((a.ea < b.ea) || ((a.ea == b.ea) && (a.size > b.size))); });
 
-        if (!hasName(ea))
+    size_t count = placementQueue.size();
+    for (size_t i = 0; i < count;)
+    {
+        // Gather a run of touching or overlapping objects
+        ea_t runStart = placementQueue[i].ea;
+        ea_t runEnd = (runStart + placementQueue[i].size);
+        size_t last = (i + 1);
+        while ((last < count) && (placementQueue[last].ea <= runEnd))
         {
-            setUnknown(ea, sizeof(RTTI::_RTTIBaseClassDescriptor));
-            BOOL result = FALSE;
-            if (g_optionPlaceStructs)
-                result = create_struct(ea, sizeof(RTTI::_RTTIBaseClassDescriptor), s_BaseClassDescriptor_ID);
-            if (!result)
+            ea_t end = (placementQueue[last].ea + placementQueue[last].size);
+            if (end > runEnd)
+                runEnd = end;
+            last++;
+        }
+
+        // One undefine for the whole run, then the structures
+        setUnknown(runStart, (int) (runEnd - runStart));
+        placementStats.runs++;
+
+        ea_t placedEnd = 0;
+        for (; i < last; i++)
+        {
+            // Skip duplicates, and objects already covered by a placed structure (a BCD's PMD)
+            const PLACEMENT &pe = placementQueue[i];
+            if ((pe.ea + pe.size) <= placedEnd)
+                continue;
+
+            placementStats.objects++;
+            if (placeStructRTTI<W>(pe))
             {
-                put32(ea + offsetof(RTTI::_RTTIBaseClassDescriptor, typeDescriptor));
-                put32(ea + offsetof(RTTI::_RTTIBaseClassDescriptor, numContainedBases));
-                put32(ea + offsetof(RTTI::_RTTIBaseClassDescriptor, attributes));
-                //if (bHasChd)
-                put32(ea + offsetof(RTTI::_RTTIBaseClassDescriptor, classDescriptor));
-                if (bHasChd)
-                    setComment((ea + offsetof(RTTI::_RTTIBaseClassDescriptor, classDescriptor)), "BCD_HASPCHD set", TRUE);
+                placementStats.creates++;
+                placedEnd = (pe.ea + pe.size);
             }
-
-            return TRUE;
         }
+    }
+
+    placementQueue.clear();
+}
 
+// Queue an RTTI structure by type ID add address w/optional name
+// Returns TRUE if structure was queued, else FLASE it was already set
+template <class W> static BOOL tryStructRTTI(ea_t ea, tid_t tid, __in_opt LPSTR typeName = NULL, BOOL bHasChd = FALSE)
+{
+    if (tid == BADADDR)
+    {
+        _ASSERT(FALSE);
         return FALSE;
-	}
+    }
 
-	_ASSERT(FALSE);
-	return FALSE;
+    // A BCD has an embedded PMD
+    if (tid == s_BaseClassDescriptor_ID)
+        tryStructRTTI<W>(ea + offsetof(RTTI::_RTTIBaseClassDescriptor, pmd), s_PMD_ID);
+
+    if (hasName(ea))
+        return FALSE;
+
+    PLACEMENT pe = { ea, 0, 0, tid };
+    if (tid == s_type_info_ID)
+    {
+        _ASSERT(typeName != NULL);
+        pe.extra = (UINT32) (strlen(typeName) + 1);
+        pe.size = (((UINT32) offsetof(typename W::td_t, _M_d_name) + pe.extra + 3) & ~3);
+    }
+    else
+    if (tid == s_ClassHierarchyDescriptor_ID)
+        pe.size = sizeof(RTTI::_RTTIClassHierarchyDescriptor);
+    else
+    if (tid == s_PMD_ID)
+        pe.size = sizeof(RTTI::PMD);
+    else
+    if (tid == s_CompleteObjectLocator_ID)
+        pe.size = sizeof(typename W::col_t);
+    else
+    if (tid == s_BaseClassDescriptor_ID)
+    {
+        pe.size = sizeof(RTTI::_RTTIBaseClassDescriptor);
+        pe.extra = (UINT32) bHasChd;
+    }
+    else
+    {
+        _ASSERT(FALSE);
+        return FALSE;
+    }
+
+    placementQueue.push_back(pe);
+    if (placementQueue.size() >= PLACEMENT_LIMIT)
+        flushPlacements<W>();
+    return TRUE;
+}
+
+// Place queued RTTI structures, return counts since the last call
+void RTTI::flushPlacements(__out UINT32 &objects, __out UINT32 &runs, __out UINT32 &creates)
+{
+    if (plat.is64)
+        ::flushPlacements<PTR64>();
+    else
+        ::flushPlacements<PTR32>();
+
+    objects = placementStats.objects;
+    runs = placementStats.runs;
+    creates = placementStats.creates;
+    ZeroMemory(&placementStats, sizeof(placementStats));
 }
 
 
@@ -644,30 +654,32 @@ static int getIdaString(ea_t ea, __out LPSTR buffer, int bufferSize)
 
 // Get type name into a buffer
 // type_info assumed to be valid
-int RTTI::type_info::getName(ea_t typeInfo, __out LPSTR buffer, int bufferSize)
+template <class W> int RTTI::type_info::getName(ea_t typeInfo, __out LPSTR buffer, int bufferSize)
 {
-    return getIdaString(typeInfo + (plat.is64 ? offsetof(type_info_64, _M_d_name) : offsetof(type_info_32, _M_d_name)), buffer, bufferSize);
+    return getIdaString(typeInfo + offsetof(typename W::td_t, _M_d_name), buffer, bufferSize);
 }
 
 // A valid type_info/TypeDescriptor at pointer?
-BOOL RTTI::type_info::isValid(ea_t typeInfo)
+template <class W> BOOL RTTI::type_info::isValid(ea_t typeInfo)
 {
     // TRUE if we've already seen it
-    if (tdSet.find(typeInfo) != tdSet.end())
+    if (g_rttiStore.contains(typeInfo, RK_TD))
         return TRUE;
 
     if (IS_VALID_ADDR(typeInfo))
 	{
+        typedef typename W::td_t TD;
+
 		// Verify what should be a vftable
-        ea_t ea = plat.getEa(typeInfo + (plat.is64 ? offsetof(type_info_64, vfptr) : offsetof(type_info_32, vfptr)));
+        ea_t ea = W::getEa(typeInfo + offsetof(TD, vfptr));
         if (IS_VALID_ADDR(ea))
 		{
             // _M_data should be NULL statically
             ea_t _M_data = BADADDR;
-            if (getVerifyEa((typeInfo + (plat.is64 ? offsetof(type_info_64, _M_data) : offsetof(type_info_32, _M_data))), _M_data))
+            if (getVerifyEa<W>((typeInfo + offsetof(TD, _M_data)), _M_data))
             {
                 if (_M_data == 0)
-                    return isTypeName(typeInfo + (plat.is64 ? offsetof(type_info_64, _M_d_name) : offsetof(type_info_32, _M_d_name)));
+                    return isTypeName(typeInfo + offsetof(TD, _M_d_name));
             }
 		}
 	}
@@ -697,20 +709,19 @@ BOOL RTTI::type_info::isTypeName(ea_t name)
 }
 
 // Put struct and place name at address
-void RTTI::type_info::tryStruct(ea_t typeInfo)
+template <class W> void RTTI::type_info::tryStruct(ea_t typeInfo)
 {
 	// Only place once per address
-	if (tdSet.find(typeInfo) != tdSet.end())
+	if (g_rttiStore.contains(typeInfo, RK_TD))
 		return;
-	else
-		tdSet.insert(typeInfo);
 
 	// Get type name
 	char name[MAXSTR];
-	int nameLen = getName(typeInfo, name, SIZESTR(name));
+	int nameLen = getName<W>(typeInfo, name, SIZESTR(name));
+	g_rttiStore.insert(typeInfo, RK_TD, (UINT32) (offsetof(typename W::td_t, _M_d_name) + strlen(name) + 1));
 
     //msg("TD: 0x%llX\n", typeInfo);
-	tryStructRTTI(typeInfo, s_type_info_ID, name);
+	tryStructRTTI<W>(typeInfo, s_type_info_ID, name);
 
 	if (nameLen > 0)
 	{
@@ -731,69 +742,41 @@ void RTTI::type_info::tryStruct(ea_t typeInfo)
 // --------------------------- Complete Object Locator ---------------------------
 
 // Return TRUE if address is a valid RTTI structure
-BOOL RTTI::_RTTICompleteObjectLocator::isValid(ea_t col)
+template <class W> BOOL RTTI::_RTTICompleteObjectLocator::isValid(ea_t col)
 {
     // True if already known
-    if (colSet.find(col) != colSet.end())
+    if (g_rttiStore.contains(col, RK_COL))
         return TRUE;
 
     if (IS_VALID_ADDR(col))
     {
-        // Check signature
+        typedef typename W::col_t COL;
+
+        // Check signature. 32bit is zero with direct addresses, 64bit is one with offsets from the object base.
         UINT32 signature = -1;
         if (getVerify32((col + offsetof(_RTTICompleteObjectLocator, signature)), signature))
         {
-            if (!plat.is64)
+            if (signature == W::colSignature)
             {
-                // 32bit direct addresses
-                if (signature == 0)
+                if constexpr (W::is64)
                 {
-                    // Check valid type_info
-                    ea_t typeInfo = plat.getEa32(col + offsetof(_RTTICompleteObjectLocator_32, typeDescriptor));
-                    if (type_info_32::isValid(typeInfo))
+                    // TODO: Can any of these be zero and still be valid?
+                    if (!get_32bit(col + offsetof(COL, objectBase)) || !get_32bit(col + offsetof(COL, typeDescriptor)) || !get_32bit(col + offsetof(COL, classDescriptor)))
+                        return FALSE;
+                }
+
+                // Check valid type_info
+                INT64 colBase64 = W::getColBase(col);
+                ea_t typeInfo = W::getRef((col + offsetof(COL, typeDescriptor)), colBase64);
+                if (type_info::isValid<W>(typeInfo))
+                {
+                    ea_t classDescriptor = W::getRef((col + offsetof(COL, classDescriptor)), colBase64);
+                    if (_RTTIClassHierarchyDescriptor::isValid<W>(classDescriptor, colBase64))
                     {
-                        ea_t classDescriptor = plat.getEa32(col + offsetof(_RTTICompleteObjectLocator_32, classDescriptor));
-                        if (_RTTIClassHierarchyDescriptor::isValid(classDescriptor))
-                        {
-                            //msg("%llX %llX %llX\n", col, typeInfo, classDescriptor);
-                            return TRUE;
-                        }
+                        //msg("%llX %llX %llX\n", col, typeInfo, classDescriptor);
+                        return TRUE;
                     }
                 }
-            }
-            else
-            {
-                // 64bit bases plus objectBase offsets
-				if (signature == 1)
-				{
-					// TODO: Can any of these be zero and still be valid?
-					UINT32 objectLocator32 = get_32bit(col + offsetof(_RTTICompleteObjectLocator_64, objectBase));
-                    INT64 objectLocator64 = TO_INT64(objectLocator32);
-					if (objectLocator64 != 0)
-					{
-						UINT32 tdOffset32 = get_32bit(col + offsetof(_RTTICompleteObjectLocator_64, typeDescriptor));
-                        INT64 tdOffset64 = TO_INT64(tdOffset32);
-						if (tdOffset64 != 0)
-						{
-							UINT32 cdOffset32 = get_32bit(col + offsetof(_RTTICompleteObjectLocator_64, classDescriptor));
-                            INT64 cdOffset64 = TO_INT64(cdOffset32);
-							if (cdOffset64 != 0)
-							{
-								INT64 colBase64 = ((INT64) col - objectLocator64);
-								ea_t typeInfo = (ea_t) (colBase64 + tdOffset64);
-								if (type_info_64::isValid(typeInfo))
-								{
-									ea_t classDescriptor = (ea_t) (colBase64 + cdOffset64);
-									if (_RTTIClassHierarchyDescriptor::isValid(classDescriptor, colBase64))
-									{
-										//msg("%llX %llX %llX\n", col, typeInfo, classDescriptor);
-										return TRUE;
-									}
-								}
-							}
-						}
-					}
-				}
             }
 		}
 	}
@@ -805,7 +788,7 @@ BOOL RTTI::_RTTICompleteObjectLocator::isValid(ea_t col)
 BOOL RTTI::_RTTICompleteObjectLocator_32::isValid2(ea_t col)
 {
 	// True if already known
-	if (colSet.find(col) != colSet.end())
+	if (g_rttiStore.contains(col, RK_COL))
 		return TRUE;
 
     // 'signature' should be zero
@@ -815,9 +798,9 @@ BOOL RTTI::_RTTICompleteObjectLocator_32::isValid2(ea_t col)
         if (signature == 0)
         {
             // Verify CHD
-            ea_t classDescriptor = plat.getEa32(col + offsetof(_RTTICompleteObjectLocator_32, classDescriptor));
+            ea_t classDescriptor = PTR32::getEa(col + offsetof(_RTTICompleteObjectLocator_32, classDescriptor));
             if (classDescriptor && (classDescriptor != BADADDR))
-                return _RTTIClassHierarchyDescriptor::isValid(classDescriptor);
+                return _RTTIClassHierarchyDescriptor::isValid<PTR32>(classDescriptor);
         }
     }
 
@@ -825,10 +808,10 @@ BOOL RTTI::_RTTICompleteObjectLocator_32::isValid2(ea_t col)
 }
 
 // Place full COL hierarchy structures if they don't already exist
-BOOL RTTI::_RTTICompleteObjectLocator::tryStruct(ea_t col)
+template <class W> BOOL RTTI::_RTTICompleteObjectLocator::tryStruct(ea_t col)
 {
 	// Place it once
-	if (colSet.find(col) != colSet.end())
+	if (g_rttiStore.contains(col, RK_COL))
 		return TRUE;
 
 	// If it doesn't have a name, IDA's analyzer missed it
@@ -840,38 +823,22 @@ BOOL RTTI::_RTTICompleteObjectLocator::tryStruct(ea_t col)
 		msg("%llX fix COL (%s)\n", col, buf.c_str());
 		#endif
         //msg("COL: 0x%llX\n", col);
-		tryStructRTTI(col, s_CompleteObjectLocator_ID);
+		tryStructRTTI<W>(col, s_CompleteObjectLocator_ID);
 
 		// Put type_def
-        if (!plat.is64)
-        {
-            // 32bit direct address
-            ea_t typeInfo = plat.getEa32(col + offsetof(_RTTICompleteObjectLocator_32, typeDescriptor));
-            type_info_32::tryStruct(typeInfo);
+        typedef typename W::col_t COL;
+        INT64 colBase64 = W::getColBase(col);
+        ea_t typeInfo = W::getRef((col + offsetof(COL, typeDescriptor)), colBase64);
+        type_info::tryStruct<W>(typeInfo);
 
-            // Place CHD hierarchy
-            ea_t classDescriptor = plat.getEa32(col + offsetof(_RTTICompleteObjectLocator_32, classDescriptor));
-            _RTTIClassHierarchyDescriptor::tryStruct(classDescriptor);
-        }
-        else
-        {
-            // 64bit offsets plus objectBase
-			UINT32 tdOffset32 = get_32bit(col + offsetof(_RTTICompleteObjectLocator_64, typeDescriptor));
-            INT64 tdOffset64 = TO_INT64(tdOffset32);	 
-			UINT32 cdOffset32 = get_32bit(col + offsetof(_RTTICompleteObjectLocator_64, classDescriptor));
-            INT64 cdOffset64 = TO_INT64(cdOffset32);
-			UINT32 objectLocator32 = get_32bit(col + offsetof(_RTTICompleteObjectLocator_64, objectBase));
-            INT64 objectLocator64 = TO_INT64(objectLocator32);
-        		 
-			INT64 colBase64 = ((INT64) col - objectLocator64);
-			ea_t typeInfo = (ea_t) (colBase64 + tdOffset64);
-			type_info::tryStruct(typeInfo);
-
-			ea_t classDescriptor = (ea_t) (colBase64 + cdOffset64);
-			_RTTIClassHierarchyDescriptor::tryStruct(classDescriptor, colBase64);
+        // Place CHD hierarchy
+        ea_t classDescriptor = W::getRef((col + offsetof(COL, classDescriptor)), colBase64);
+        _RTTIClassHierarchyDescriptor::tryStruct<W>(classDescriptor, colBase64);
 
+        if constexpr (W::is64)
+        {
 			// Set absolute address comments
-			ea_t ea = (col + offsetof(_RTTICompleteObjectLocator_64, typeDescriptor));
+			ea_t ea = (col + offsetof(COL, typeDescriptor));
 			if (!hasComment(ea))
 			{
 				char buffer[64];
@@ -879,7 +846,7 @@ BOOL RTTI::_RTTICompleteObjectLocator::tryStruct(ea_t col)
 				setComment(ea, buffer, TRUE);
 			}
 
-			ea = (col + offsetof(_RTTICompleteObjectLocator_64, classDescriptor));
+			ea = (col + offsetof(COL, classDescriptor));
 			if (!hasComment(ea))
 			{
 				char buffer[64];
@@ -898,10 +865,10 @@ BOOL RTTI::_RTTICompleteObjectLocator::tryStruct(ea_t col)
 // --------------------------- Base Class Descriptor ---------------------------
 
 // Return TRUE if address is a valid BCD
-BOOL RTTI::_RTTIBaseClassDescriptor::isValid(ea_t bcd, INT64 colBase64)
+template <class W> BOOL RTTI::_RTTIBaseClassDescriptor::isValid(ea_t bcd, INT64 colBase64)
 {
     // TRUE if already known
-    if (bcdSet.find(bcd) != bcdSet.end())
+    if (g_rttiStore.contains(bcd, RK_BCD))
         return TRUE;
 
     if (IS_VALID_ADDR(bcd))
@@ -914,18 +881,7 @@ BOOL RTTI::_RTTIBaseClassDescriptor::isValid(ea_t bcd, INT64 colBase64)
             if ((attributes & 0xFFFFFF00) == 0)
             {
                 // Check for valid type_info
-                if (!plat.is64)
-                {
-                    // When 32bit direct address
-                    return type_info_32::isValid(plat.getEa32(bcd + offsetof(_RTTIBaseClassDescriptor, typeDescriptor)));
-                }
-                else
-                {
-                    // When 64bit plus COL bass ea_t
-					UINT32 tdOffset32 = get_32bit(bcd + offsetof(_RTTIBaseClassDescriptor, typeDescriptor));
-                    INT64 tdOffset64 = TO_INT64(tdOffset32);
-					return type_info_64::isValid((ea_t) (colBase64 + tdOffset64));
-                }
+                return type_info::isValid<W>(W::getRef((bcd + offsetof(_RTTIBaseClassDescriptor, typeDescriptor)), colBase64));
             }
         }
     }
@@ -934,59 +890,37 @@ BOOL RTTI::_RTTIBaseClassDescriptor::isValid(ea_t bcd, INT64 colBase64)
 }
 
 // Put BCD structure at address
-void RTTI::_RTTIBaseClassDescriptor::tryStruct(ea_t bcd, __out_bcount(MAXSTR) LPSTR baseClassName, INT64 colBase64)
+template <class W> void RTTI::_RTTIBaseClassDescriptor::tryStruct(ea_t bcd, __out_bcount(MAXSTR) LPSTR baseClassName, INT64 colBase64)
 {
     // Only place it once
-    if (bcdSet.find(bcd) != bcdSet.end())
+    if (g_rttiStore.contains(bcd, RK_BCD))
     {
         // Seen already, just return type name
-        ea_t typeInfo = BADADDR;
-        if (!plat.is64)
-        {
-            // When 32bit direct address
-            typeInfo = plat.getEa32(bcd + offsetof(_RTTIBaseClassDescriptor, typeDescriptor));
-        }
-        else
-        {
-            // When 64bit plus COL bass ea_t
-			UINT32 tdOffset32 = get_32bit(bcd + offsetof(_RTTIBaseClassDescriptor, typeDescriptor));
-            INT64 tdOffset64 = TO_INT64(tdOffset32);
-			typeInfo = (ea_t) (colBase64 + tdOffset64);
-        }
+        ea_t typeInfo = W::getRef((bcd + offsetof(_RTTIBaseClassDescriptor, typeDescriptor)), colBase64);
 
         char buffer[MAXSTR];
-        type_info::getName(typeInfo, buffer, SIZESTR(buffer));
+        type_info::getName<W>(typeInfo, buffer, SIZESTR(buffer));
         strcpy_s(baseClassName, sizeof(buffer), SKIP_TD_TAG(buffer));
         return;
     }
-    else
-        bcdSet.insert(bcd);
+
+    UINT32 attributes = (IS_VALID_ADDR(bcd) ? get_32bit(bcd + offsetof(_RTTIBaseClassDescriptor, attributes)) : 0);
+    g_rttiStore.insert(bcd, RK_BCD, kindSize(RK_BCD), attributes);
 
     if (IS_VALID_ADDR(bcd))
     {
-        UINT32 attributes = get_32bit(bcd + offsetof(_RTTIBaseClassDescriptor, attributes));
         //msg("BCD: 0x%llX\n", bcd);
-        tryStructRTTI(bcd, s_BaseClassDescriptor_ID, NULL, ((attributes & BCD_HASPCHD) > 0));
+        tryStructRTTI<W>(bcd, s_BaseClassDescriptor_ID, NULL, ((attributes & BCD_HASPCHD) > 0));
 
         // Has appended CHD?
         if (attributes & BCD_HASPCHD)
         {
             // yes, process it
             ea_t chdOffset = (bcd + (offsetof(_RTTIBaseClassDescriptor, classDescriptor)));
-            ea_t chd = BADADDR;
-            if (!plat.is64)
-            {
-                // EA_32
-                fixDword(chdOffset);
-                chd = get_32bit(chdOffset);
-            }
-            else
+            fixDword(chdOffset);
+            ea_t chd = W::getRef(chdOffset, colBase64);
+            if constexpr (W::is64)
             {
-                // EA_64
-				fixDword(chdOffset);
-				UINT32 chdOffset32 = get_32bit(chdOffset);
-                INT64 chdOffset64 = TO_INT64(chdOffset32);              			 
-				chd = (ea_t) (colBase64 + chdOffset64);
 				if (!hasComment(chdOffset))
 				{
 					char buffer[32];
@@ -996,29 +930,18 @@ void RTTI::_RTTIBaseClassDescriptor::tryStruct(ea_t bcd, __out_bcount(MAXSTR) LP
             }
 
             if (IS_VALID_ADDR(chd))
-                _RTTIClassHierarchyDescriptor::tryStruct(chd, colBase64);
+                _RTTIClassHierarchyDescriptor::tryStruct<W>(chd, colBase64);
             else
                 _ASSERT(FALSE);
         }
 
         // Place type_info struct
-        ea_t typeInfo = BADADDR;
-        if (!plat.is64)
-        {
-            // When 32bit direct address
-            typeInfo = plat.getEa32(bcd + offsetof(_RTTIBaseClassDescriptor, typeDescriptor));
-        }
-        else
-        {
-            // When 64bit plus COL bass ea_t
-			UINT32 tdOffset = get_32bit(bcd + offsetof(_RTTIBaseClassDescriptor, typeDescriptor));
-			typeInfo = (colBase64 + (ea_t)tdOffset);
-        }
-        type_info::tryStruct(typeInfo);
+        ea_t typeInfo = W::getRef((bcd + offsetof(_RTTIBaseClassDescriptor, typeDescriptor)), colBase64);
+        type_info::tryStruct<W>(typeInfo);
 
         // Get raw type/class name
         char buffer[MAXSTR];
-        type_info::getName(typeInfo, buffer, SIZESTR(buffer));
+        type_info::getName<W>(typeInfo, buffer, SIZESTR(buffer));
         strcpy_s(baseClassName, sizeof(buffer), SKIP_TD_TAG(buffer));
 
         if (!g_optionPlaceStructs && attributes)
@@ -1066,10 +989,10 @@ void RTTI::_RTTIBaseClassDescriptor::tryStruct(ea_t bcd, __out_bcount(MAXSTR) LP
 // --------------------------- Class Hierarchy Descriptor ---------------------------
 
 // Return true if address is a valid CHD structure
-BOOL RTTI::_RTTIClassHierarchyDescriptor::isValid(ea_t chd, INT64 colBase64)
+template <class W> BOOL RTTI::_RTTIClassHierarchyDescriptor::isValid(ea_t chd, INT64 colBase64)
 {
     // TRUE is already known
-    if (chdSet.find(chd) != chdSet.end())
+    if (g_rttiStore.contains(chd, RK_CHD))
         return(TRUE);
 
     if (IS_VALID_ADDR(chd))
@@ -1094,31 +1017,11 @@ BOOL RTTI::_RTTIClassHierarchyDescriptor::isValid(ea_t chd, INT64 colBase64)
                             if (numBaseClasses >= 1)
                             {
                                 // Check the first BCD entry
-                                ea_t baseClassArray = BADADDR;
-                                if (!plat.is64)
+                                ea_t baseClassArray = W::getRef((chd + offsetof(_RTTIClassHierarchyDescriptor, baseClassArray)), colBase64);
+                                if (IS_VALID_ADDR(baseClassArray))
                                 {
-                                    // When 32bit a pointer
-                                    baseClassArray = plat.getEa32(chd + offsetof(_RTTIClassHierarchyDescriptor, baseClassArray));
-                                    if (IS_VALID_ADDR(baseClassArray))
-                                    {
-										// When 32bit direct address
-										ea_t baseClassDescriptor = plat.getEa32(baseClassArray);
-										return RTTI::_RTTIBaseClassDescriptor::isValid(baseClassDescriptor);
-                                    }
-                                }
-                                else
-                                {
-                                    // When 64bit plus COL bass ea_t
-									UINT32 baseClassArrayOffset32 = get_32bit(chd + offsetof(_RTTIClassHierarchyDescriptor, baseClassArray));
-                                    INT64 baseClassArrayOffset64 = TO_INT64(baseClassArrayOffset32);
-									baseClassArray = (ea_t) (colBase64 + baseClassArrayOffset64);
-                                    if (IS_VALID_ADDR(baseClassArray))
-                                    {
-										// When 64bit plus COL bass ea_t
-										UINT32 baseClassDescriptor32 = get_32bit(baseClassArray);
-                                        INT64 baseClassDescriptor64 = (TO_INT64(baseClassDescriptor32) + colBase64);
-										return RTTI::_RTTIBaseClassDescriptor::isValid((ea_t) baseClassDescriptor64, colBase64);
-                                    }
+                                    ea_t baseClassDescriptor = W::getRef(baseClassArray, colBase64);
+                                    return RTTI::_RTTIBaseClassDescriptor::isValid<W>(baseClassDescriptor, colBase64);
                                 }
                             }
                         }
@@ -1132,22 +1035,22 @@ BOOL RTTI::_RTTIClassHierarchyDescriptor::isValid(ea_t chd, INT64 colBase64)
 }
 
 // Put CHD structure at address
-void RTTI::_RTTIClassHierarchyDescriptor::tryStruct(ea_t chd, INT64 colBase64)
+template <class W> void RTTI::_RTTIClassHierarchyDescriptor::tryStruct(ea_t chd, INT64 colBase64)
 {
     // Only place it once per address
-    if (chdSet.find(chd) != chdSet.end())
+    if (g_rttiStore.contains(chd, RK_CHD))
         return;
-    else
-        chdSet.insert(chd);
+
+    UINT32 attributes = (IS_VALID_ADDR(chd) ? get_32bit(chd + offsetof(_RTTIClassHierarchyDescriptor, attributes)) : 0);
+    g_rttiStore.insert(chd, RK_CHD, kindSize(RK_CHD), attributes);
 
     if (IS_VALID_ADDR(chd))
     {
         // Place CHD
         //msg("CHD: 0x%llX\n", chd);
-        tryStructRTTI(chd, s_ClassHierarchyDescriptor_ID);
+        tryStructRTTI<W>(chd, s_ClassHierarchyDescriptor_ID);
 
         // Place attributes comment
-        UINT32 attributes = get_32bit(chd + offsetof(_RTTIClassHierarchyDescriptor, attributes));
         if (!g_optionPlaceStructs && attributes)
         {
 			ea_t ea = (chd + offsetof(_RTTIClassHierarchyDescriptor, attributes));
@@ -1169,18 +1072,9 @@ void RTTI::_RTTIClassHierarchyDescriptor::tryStruct(ea_t chd, INT64 colBase64)
         if (getVerify32((chd + offsetof(_RTTIClassHierarchyDescriptor, numBaseClasses)), numBaseClasses))
         {
             // Get pointer
-            ea_t baseClassArray = BADADDR;
-            if (!plat.is64)
+            ea_t baseClassArray = W::getRef((chd + offsetof(_RTTIClassHierarchyDescriptor, baseClassArray)), colBase64);
+            if constexpr (W::is64)
             {
-                // 32bit direct address
-                baseClassArray = plat.getEa32(chd + offsetof(_RTTIClassHierarchyDescriptor, baseClassArray));
-            }
-            else
-            {
-                // 64bit plus COL bass ea_t
-				UINT32 baseClassArrayOffset = get_32bit(chd + offsetof(_RTTIClassHierarchyDescriptor, baseClassArray));
-				baseClassArray = (colBase64 + (ea_t) baseClassArrayOffset);
-
 				ea_t ea = (chd + offsetof(_RTTIClassHierarchyDescriptor, baseClassArray));
 				if (!hasComment(ea))
 				{
@@ -1196,7 +1090,7 @@ void RTTI::_RTTIClassHierarchyDescriptor::tryStruct(ea_t chd, INT64 colBase64)
                 char format[128];
                 if(numBaseClasses > 1)
                 {
-                    if (!plat.is64)
+                    if constexpr (!W::is64)
                     {
                         // EA_32
                         int digits = (int) strlen(_itoa(numBaseClasses, format, 10));
@@ -1221,12 +1115,13 @@ void RTTI::_RTTIClassHierarchyDescriptor::tryStruct(ea_t chd, INT64 colBase64)
                     fixDword(baseClassArray);
 
                     char baseClassName[MAXSTR];
-					if (!plat.is64)
-					{
-                        // EA_32
-                        if (!hasComment(baseClassArray))
+                    ea_t bcd = W::getRef(baseClassArray, colBase64);
+                    if (!hasComment(baseClassArray))
+                    {
+                        // Add index comment to to it
+                        if constexpr (!W::is64)
                         {
-                            // Add index comment to to it
+                            // EA_32
                             if (numBaseClasses == 1)
                                 setComment(baseClassArray, "  BaseClass", FALSE);
                             else
@@ -1236,22 +1131,9 @@ void RTTI::_RTTIClassHierarchyDescriptor::tryStruct(ea_t chd, INT64 colBase64)
                                 setComment(baseClassArray, ptrComent, FALSE);
                             }
                         }
-
-						// Place BCD struct, and grab the base class name
-                        // 32bit, direct address
-                        ea_t bcd = plat.getEa32(baseClassArray);
-						_RTTIBaseClassDescriptor::tryStruct(bcd, baseClassName);
-                    }
-                    else
-                    {
-                        // EA_64
-						UINT32 bcdOffset32 = get_32bit(baseClassArray);
-                        INT64 bcdOffset64 = TO_INT64(bcdOffset32);
-						ea_t bcd = (ea_t) (colBase64 + bcdOffset64);
-
-                        if (!hasComment(baseClassArray))
+                        else
                         {
-                            // Add index comment to to it
+                            // EA_64
                             if (numBaseClasses == 1)
                             {
                                 char buffer[MAXSTR];
@@ -1265,12 +1147,11 @@ void RTTI::_RTTIClassHierarchyDescriptor::tryStruct(ea_t chd, INT64 colBase64)
                                 setComment(baseClassArray, buffer, FALSE);
                             }
                         }
-
-						// Place BCD struct, and grab the base class name
-                        // 64bit plus COL bass ea_t
-						_RTTIBaseClassDescriptor::tryStruct(bcd, baseClassName, colBase64);
                     }
 
+                    // Place BCD struct, and grab the base class name
+                    _RTTIBaseClassDescriptor::tryStruct<W>(bcd, baseClassName, colBase64);
+
                     // Now we have the base class name, name and label some things
                     if (i == 0)
                     {
@@ -1284,8 +1165,7 @@ void RTTI::_RTTIClassHierarchyDescriptor::tryStruct(ea_t chd, INT64 colBase64)
                         }
 
                         // Add a spacing comment line above us
-                        if (!hasAnteriorComment(baseClassArray))
-							setAnteriorComment(baseClassArray, "");
+                        setAnteriorCommentIfNone(baseClassArray, "");
 
                         // Set CHD name
                         if (!hasName(chd))
@@ -1321,103 +1201,102 @@ void RTTI::_RTTIClassHierarchyDescriptor::tryStruct(ea_t chd, INT64 colBase64)
 
 // --------------------------- Vftable ---------------------------
 
-// Get list of base class descriptor info
-static void RTTI::getBCDInfo(ea_t col, __out bcdList &list, __out UINT32 &numBaseClasses)
+// Get list of base class descriptor info, allocated from the vftable arena
+template <class W> static bcdInfo *RTTI::getBCDInfo(ea_t col, __out UINT32 &numBaseClasses)
 {
 	numBaseClasses = 0;
+    bcdInfo *list = NULL;
 
-    if(!plat.is64)
+    INT64 colBase64 = W::getColBase(col);
+    ea_t chd = W::getRef((col + offsetof(typename W::col_t, classDescriptor)), colBase64);
+    if(chd)
     {
-        // 32bit version
-        ea_t chd = plat.getEa32(col + offsetof(_RTTICompleteObjectLocator_32, classDescriptor));
-	    if(chd)
+        if (numBaseClasses = get_32bit(chd + offsetof(_RTTIClassHierarchyDescriptor, numBaseClasses)))
 	    {
-            if (numBaseClasses = get_32bit(chd + offsetof(_RTTIClassHierarchyDescriptor, numBaseClasses)))
+            list = vftArena.alloc<bcdInfo>(numBaseClasses);
+            ZeroMemory(list, (sizeof(bcdInfo) * numBaseClasses));
+            LPSTR name = vftArena.alloc<char>(MAXSTR);
+
+            // Entries default to an empty name for when the base class array isn't readable. Zero filled past the
+            // terminator since the callers test the type tag at name[3].
+            LPSTR emptyName = vftArena.alloc<char>(4);
+            ZeroMemory(emptyName, 4);
+            for (UINT32 i = 0; i < numBaseClasses; i++)
+                list[i].m_name = emptyName;
+
+		    // Get pointer
+            ea_t baseClassArray = W::getRef((chd + offsetof(_RTTIClassHierarchyDescriptor, baseClassArray)), colBase64);
+		    if(IS_VALID_ADDR(baseClassArray))
 		    {
-                list.resize(numBaseClasses);
-
-			    // Get pointer
-                ea_t baseClassArray = plat.getEa32(chd + offsetof(_RTTIClassHierarchyDescriptor, baseClassArray));
-			    if(baseClassArray && (baseClassArray != BADADDR))
+			    for(UINT32 i = 0; i < numBaseClasses; i++, baseClassArray += sizeof(UINT32))
 			    {
-				    for(UINT32 i = 0; i < numBaseClasses; i++, baseClassArray += sizeof(UINT32))
-				    {
-                        // Get next BCD
-                        ea_t bcd = get_32bit(baseClassArray);
-
-                        // Get type name
-                        ea_t typeInfo = get_32bit(bcd + offsetof(_RTTIBaseClassDescriptor, typeDescriptor));
-                        bcdInfo *bi = &list[i];
-                        type_info_32::getName(typeInfo, bi->m_name, SIZESTR(bi->m_name));
-
-					    // Add info to list
-                        UINT32 mdisp = get_32bit(bcd + (offsetof(_RTTIBaseClassDescriptor, pmd) + offsetof(PMD, mdisp)));
-                        UINT32 pdisp = get_32bit(bcd + (offsetof(_RTTIBaseClassDescriptor, pmd) + offsetof(PMD, pdisp)));
-                        UINT32 vdisp = get_32bit(bcd + (offsetof(_RTTIBaseClassDescriptor, pmd) + offsetof(PMD, vdisp)));
-                        // As signed int
-                        bi->m_pmd.mdisp = *((PINT32) &mdisp);
-                        bi->m_pmd.pdisp = *((PINT32) &pdisp);
-                        bi->m_pmd.vdisp = *((PINT32) &vdisp);
-                        bi->m_attribute = get_32bit(bcd + offsetof(_RTTIBaseClassDescriptor, attributes));
-
-					    //msg("   BN: [%d] \"%s\", ATB: %04X\n", i, szBuffer1, get_32bit((ea_t) &pBCD->attributes));
-					    //msg("       mdisp: %d, pdisp: %d, vdisp: %d, attributes: %04X\n", *((PINT) &mdisp), *((PINT) &pdisp), *((PINT) &vdisp), attributes);
-				    }
+                    // Get next BCD
+                    ea_t bcd = W::getRef(baseClassArray, colBase64);
+
+                    // Get type name
+                    ea_t typeInfo = W::getRef((bcd + offsetof(_RTTIBaseClassDescriptor, typeDescriptor)), colBase64);
+                    bcdInfo *bi = &list[i];
+                    name[0] = 0;
+                    type_info::getName<W>(typeInfo, name, (MAXSTR - 1));
+                    if (name[0])
+                        bi->m_name = vftArena.strdup(name);
+
+				    // Add info to list
+                    UINT32 mdisp = get_32bit(bcd + (offsetof(_RTTIBaseClassDescriptor, pmd) + offsetof(PMD, mdisp)));
+                    UINT32 pdisp = get_32bit(bcd + (offsetof(_RTTIBaseClassDescriptor, pmd) + offsetof(PMD, pdisp)));
+                    UINT32 vdisp = get_32bit(bcd + (offsetof(_RTTIBaseClassDescriptor, pmd) + offsetof(PMD, vdisp)));
+                    // As signed int
+                    bi->m_pmd.mdisp = *((PINT32) &mdisp);
+                    bi->m_pmd.pdisp = *((PINT32) &pdisp);
+                    bi->m_pmd.vdisp = *((PINT32) &vdisp);
+                    bi->m_attribute = get_32bit(bcd + offsetof(_RTTIBaseClassDescriptor, attributes));
+
+				    //msg("   BN: [%d] \"%s\", ATB: %04X\n", i, szBuffer1, get_32bit((ea_t) &pBCD->attributes));
+				    //msg("       mdisp: %d, pdisp: %d, vdisp: %d, attributes: %04X\n", *((PINT) &mdisp), *((PINT) &pdisp), *((PINT) &vdisp), attributes);
 			    }
 		    }
 	    }
     }
-    else
+
+    return list;
+}
+
+// Read the COL's base class list in hierarchy order into 'bases', reusing its entries. Returns the count.
+// Like getBCDInfo() but without the vftable arena, for the callers outside of the scan.
+template <class W> UINT32 RTTI::getBaseClasses(ea_t col, __out qvector<BASECLASS> &bases)
+{
+    UINT32 count = 0;
+    INT64 colBase64 = W::getColBase(col);
+    ea_t chd = W::getRef((col + offsetof(typename W::col_t, classDescriptor)), colBase64);
+    if (chd)
     {
-        // 64bit version
-        UINT32 cdOffset32 = get_32bit(col + offsetof(_RTTICompleteObjectLocator_64, classDescriptor));
-        INT64 cdOffset64 = TO_INT64(cdOffset32);
-        UINT32 objectLocator32 = get_32bit(col + offsetof(_RTTICompleteObjectLocator_64, objectBase));
-        INT64 objectLocator64 = TO_INT64(objectLocator32);
-        INT64 colBase64 = ((INT64) col - objectLocator64);
-        ea_t chd = (ea_t) (colBase64 + cdOffset64);
-
-	    if(chd)
-	    {
-            if (numBaseClasses = get_32bit(chd + offsetof(_RTTIClassHierarchyDescriptor, numBaseClasses)))
-		    {
-                list.resize(numBaseClasses);
+        UINT32 numBaseClasses = get_32bit(chd + offsetof(_RTTIClassHierarchyDescriptor, numBaseClasses));
+        ea_t baseClassArray = W::getRef((chd + offsetof(_RTTIClassHierarchyDescriptor, baseClassArray)), colBase64);
+        if (numBaseClasses && IS_VALID_ADDR(baseClassArray))
+        {
+            if (bases.size() < numBaseClasses)
+                bases.resize(numBaseClasses);
 
-			    // Get pointer
-                UINT32 bcaOffset32 = get_32bit(chd + offsetof(_RTTIClassHierarchyDescriptor, baseClassArray));
-                INT64 bcaOffset64 = TO_INT64(bcaOffset32);
-                ea_t baseClassArray = (ea_t) (colBase64 + bcaOffset64);
-			    if(IS_VALID_ADDR(baseClassArray))
-			    {
-				    for(UINT32 i = 0; i < numBaseClasses; i++, baseClassArray += sizeof(UINT32))
-				    {
-                        UINT32 bcdOffset32 = get_32bit(baseClassArray);
-                        INT64 bcdOffset64 = TO_INT64(bcdOffset32);
-                        ea_t bcd = (ea_t) (colBase64 + bcdOffset64);
-
-                        UINT32 tdOffset32 = get_32bit(bcd + offsetof(_RTTIBaseClassDescriptor, typeDescriptor));
-                        INT64 tdOffset64 = TO_INT64(tdOffset32);
-                        ea_t typeInfo = (ea_t) (colBase64 + tdOffset64);
-                        bcdInfo *bi = &list[i];
-                        type_info_64::getName(typeInfo, bi->m_name, SIZESTR(bi->m_name));
-
-					    // Add info to list
-                        UINT32 mdisp = get_32bit(bcd + (offsetof(_RTTIBaseClassDescriptor, pmd) + offsetof(PMD, mdisp)));
-                        UINT32 pdisp = get_32bit(bcd + (offsetof(_RTTIBaseClassDescriptor, pmd) + offsetof(PMD, pdisp)));
-                        UINT32 vdisp = get_32bit(bcd + (offsetof(_RTTIBaseClassDescriptor, pmd) + offsetof(PMD, vdisp)));
-                        // As signed int
-                        bi->m_pmd.mdisp = *((PINT32) &mdisp);
-                        bi->m_pmd.pdisp = *((PINT32) &pdisp);
-                        bi->m_pmd.vdisp = *((PINT32) &vdisp);
-                        bi->m_attribute = get_32bit(bcd + offsetof(_RTTIBaseClassDescriptor, attributes));
-
-					    //msg("   BN: [%d] \"%s\", ATB: %04X\n", i, szBuffer1, get_32bit((ea_t) &pBCD->attributes));
-					    //msg("       mdisp: %d, pdisp: %d, vdisp: %d, attributes: %04X\n", *((PINT) &mdisp), *((PINT) &pdisp), *((PINT) &vdisp), attributes);
-				    }
-			    }
-		    }
-	    }
+            char mangled[MAXSTR], plain[MAXSTR];
+            for (; count < numBaseClasses; count++, baseClassArray += sizeof(UINT32))
+            {
+                ea_t bcd = W::getRef(baseClassArray, colBase64);
+                ea_t typeInfo = W::getRef((bcd + offsetof(_RTTIBaseClassDescriptor, typeDescriptor)), colBase64);
+                BASECLASS &bc = bases[count];
+
+                mangled[0] = 0;
+                type_info::getName<W>(typeInfo, mangled, SIZESTR(mangled));
+                bc.name = (getPlainTypeName(mangled, plain) ? plain : mangled);
+
+                bc.pmd.mdisp = (INT32) get_32bit(bcd + (offsetof(_RTTIBaseClassDescriptor, pmd) + offsetof(PMD, mdisp)));
+                bc.pmd.pdisp = (INT32) get_32bit(bcd + (offsetof(_RTTIBaseClassDescriptor, pmd) + offsetof(PMD, pdisp)));
+                bc.pmd.vdisp = (INT32) get_32bit(bcd + (offsetof(_RTTIBaseClassDescriptor, pmd) + offsetof(PMD, vdisp)));
+                bc.attributes = get_32bit(bcd + offsetof(_RTTIBaseClassDescriptor, attributes));
+                bc.numContainedBases = get_32bit(bcd + offsetof(_RTTIBaseClassDescriptor, numContainedBases));
+            }
+        }
     }
+    return count;
 }
 
 
@@ -1425,50 +1304,42 @@ static void RTTI::getBCDInfo(ea_t col, __out bcdList &list, __out UINT32 &numBas
 
 // Process RTTI vftable info
 // Returns TRUE if if vftable and wasn't named on entry
-BOOL RTTI::processVftable(ea_t vft, ea_t col, BOOL known)
+template <class W> BOOL RTTI::processVftable(ea_t vft, ea_t col, BOOL known)
 {
 	BOOL result = FALSE;
 
-    ea_t chd = BADADDR;
-    ea_t typeInfo = BADADDR;
-    if (!plat.is64)
-    {
-        // 32bit direct address
-        chd = plat.getEa32(col + offsetof(_RTTICompleteObjectLocator_32, classDescriptor));
-	    typeInfo = plat.getEa32(col + offsetof(_RTTICompleteObjectLocator_32, typeDescriptor));
-    }
-    else
-	{
-        // 64bit offsets relative to objectBase
-		UINT32 tdOffset = get_32bit(col + offsetof(_RTTICompleteObjectLocator_64, typeDescriptor));
-        UINT32 chdOffset = get_32bit(col + offsetof(_RTTICompleteObjectLocator_64, classDescriptor));
-		UINT32 objectLocator = get_32bit(col + offsetof(_RTTICompleteObjectLocator_64, objectBase));
-
-        ea_t colBase = (col - (ea_t) objectLocator);
-        typeInfo = (colBase + (ea_t) tdOffset);
-		chd = (colBase + (ea_t) chdOffset);
-	}
+    // All per vftable temporaries come from the phase arena and get released on return
+    Arena::Scope arenaScope(vftArena);
+
+    // 32bit direct addresses, 64bit offsets relative to objectBase
+    INT64 colBase64 = W::getColBase(col);
+    ea_t chd = W::getRef((col + offsetof(typename W::col_t, classDescriptor)), colBase64);
+    ea_t typeInfo = W::getRef((col + offsetof(typename W::col_t, typeDescriptor)), colBase64);
 
     // Verify and fix if vftable exists here
     vftable::vtinfo vi;
-    if(vftable::getTableInfo(vft, vi))
+    if(vftable::getTableInfo<W>(vft, vi))
     {
 	    // Get COL type name
-        char colName[MAXSTR];
-        type_info::getName(typeInfo, colName, SIZESTR(colName));
-        char demangledColName[MAXSTR];
+        LPSTR colName = vftArena.alloc<char>(MAXSTR);
+        colName[0] = 0;
+        type_info::getName<W>(typeInfo, colName, (MAXSTR - 1));
+        LPSTR demangledColName = vftArena.alloc<char>(MAXSTR);
         getPlainTypeName(colName, demangledColName);
 
+        // Scratch buffers
+        LPSTR decorated = vftArena.alloc<char>(MAXSTR);
+        LPSTR plainName = vftArena.alloc<char>(MAXSTR);
+
         UINT32 chdAttributes = get_32bit(chd + offsetof(_RTTIClassHierarchyDescriptor, attributes));
         UINT32 offset = get_32bit(col + offsetof(_RTTICompleteObjectLocator, offset));
 
 	    // Parse BCD info
-	    bcdList list;
         UINT32 numBaseClasses;
-	    getBCDInfo(col, list, numBaseClasses);
+	    bcdInfo *list = getBCDInfo<W>(col, numBaseClasses);
 
         BOOL sucess = FALSE, isTopLevel = FALSE;
-        qstring cmt;
+        ArenaString cmt(vftArena);
 
 	    // ======= Simple or no inheritance
         if ((offset == 0) && ((chdAttributes & (CHD_MULTINH | CHD_VIRTINH)) == 0))
@@ -1479,27 +1350,21 @@ BOOL RTTI::processVftable(ea_t vft, ea_t col, BOOL known)
 				result = TRUE;
 
                 // Decorate raw name as a vftable. I.E. const Name::`vftable'
-                char decorated[MAXSTR];
-                _snprintf_s(decorated, sizeof(decorated), SIZESTR(decorated), FORMAT_RTTI_VFTABLE, SKIP_TD_TAG(colName));
+                _snprintf_s(decorated, MAXSTR, (MAXSTR - 1), FORMAT_RTTI_VFTABLE, SKIP_TD_TAG(colName));
                 setName(vft, decorated);
 		    }
 
 		    // Set COL name. I.E. const Name::`RTTI Complete Object Locator'
-            if (!hasName(col))
-            {
-                char decorated[MAXSTR];
-                _snprintf_s(decorated, sizeof(decorated), SIZESTR(decorated), FORMAT_RTTI_COL, SKIP_TD_TAG(colName));
-                setName(col, decorated);
-            }
+            _snprintf_s(decorated, MAXSTR, (MAXSTR - 1), FORMAT_RTTI_COL, SKIP_TD_TAG(colName));
+            setNameIfNone(col, decorated);
 
 		    // Build object hierarchy string
             int placed = 0;
             if (numBaseClasses > 1)
             {
                 // Parent
-                char plainName[MAXSTR];
                 getPlainTypeName(list[0].m_name, plainName);
-                cmt.sprnt("%s%s: ", ((list[0].m_name[3] == 'V') ? "" : "struct "), plainName);
+                cmt.format("%s%s: ", ((list[0].m_name[3] == 'V') ? "" : "struct "), plainName);
                 placed++;
                 isTopLevel = ((strcmp(list[0].m_name, colName) == 0) ? TRUE : FALSE);
 
@@ -1508,23 +1373,23 @@ BOOL RTTI::processVftable(ea_t vft, ea_t col, BOOL known)
                 {
                     // Append name
                     getPlainTypeName(list[i].m_name, plainName);
-                    cmt.cat_sprnt("%s%s, ", ((list[i].m_name[3] == 'V') ? "" : "struct "), plainName);
+                    cmt.appendf("%s%s, ", ((list[i].m_name[3] == 'V') ? "" : "struct "), plainName);
                     placed++;
                 }
 
                 // Nix the ending ',' for the last one
                 if (placed > 1)
-                    cmt.remove((cmt.length() - 2), 2);
+                    cmt.truncate(cmt.length() - 2);
             }
             else
             {
                 // Plain, no inheritance object(s)
-                cmt.sprnt("%s%s: ", ((colName[3] == 'V') ? "" : "struct "), demangledColName);
+                cmt.format("%s%s: ", ((colName[3] == 'V') ? "" : "struct "), demangledColName);
                 isTopLevel = TRUE;
             }
 
             if (placed > 1)
-                cmt += ';';
+                cmt.append(";");
 
             sucess = TRUE;
 	    }
@@ -1581,47 +1446,40 @@ BOOL RTTI::processVftable(ea_t vft, ea_t col, BOOL known)
                     {
 						result = TRUE;
 
-                        char decorated[MAXSTR];
-                        _snprintf_s(decorated, sizeof(decorated), SIZESTR(decorated), FORMAT_RTTI_VFTABLE, SKIP_TD_TAG(colName));
+                        _snprintf_s(decorated, MAXSTR, (MAXSTR - 1), FORMAT_RTTI_VFTABLE, SKIP_TD_TAG(colName));
                         setName(vft, decorated);
                     }
 
                     // COL name
-                    if (!hasName(col))
-                    {
-                        char decorated[MAXSTR];
-                        _snprintf_s(decorated, sizeof(decorated), SIZESTR(decorated), FORMAT_RTTI_COL, SKIP_TD_TAG(colName));
-                        setName(col, decorated);
-                    }
+                    _snprintf_s(decorated, MAXSTR, (MAXSTR - 1), FORMAT_RTTI_COL, SKIP_TD_TAG(colName));
+                    setNameIfNone(col, decorated);
 
                     // Build hierarchy string starting with parent
-                    char plainName[MAXSTR];
                     getPlainTypeName(list[0].m_name, plainName);
-                    cmt.sprnt("%s%s: ", ((list[0].m_name[3] == 'V') ? "" : "struct "), plainName);
+                    cmt.format("%s%s: ", ((list[0].m_name[3] == 'V') ? "" : "struct "), plainName);
                     placed++;
 
                     // Concatenate forward child hierarchy
                     for (UINT32 i = 1; i < numBaseClasses; i++)
                     {
                         getPlainTypeName(list[i].m_name, plainName);
-                        cmt.cat_sprnt("%s%s, ", ((list[i].m_name[3] == 'V') ? "" : "struct "), plainName);
+                        cmt.appendf("%s%s, ", ((list[i].m_name[3] == 'V') ? "" : "struct "), plainName);
                         placed++;
                     }
                     if (placed > 1)
-                        cmt.remove((cmt.length() - 2), 2);
+                        cmt.truncate(cmt.length() - 2);
                 }
                 else
                 {
                     // Combine COL and CHD name
-                    char combinedName[MAXSTR];
-                    _snprintf_s(combinedName, sizeof(combinedName), SIZESTR(combinedName), "%s6B%s@", SKIP_TD_TAG(colName), SKIP_TD_TAG(bi->m_name));
+                    LPSTR combinedName = vftArena.alloc<char>(MAXSTR);
+                    _snprintf_s(combinedName, MAXSTR, (MAXSTR - 1), "%s6B%s@", SKIP_TD_TAG(colName), SKIP_TD_TAG(bi->m_name));
 
                     // Set vftable name
                     if (!hasName(vft))
                     {
 						result = TRUE;
 
-                        char decorated[MAXSTR];
 						strcpy(decorated, FORMAT_RTTI_VFTABLE_PREFIX);
 						strncat_s(decorated, MAXSTR, combinedName, (MAXSTR - (1 + SIZESTR(FORMAT_RTTI_VFTABLE_PREFIX))));
                         setName(vft, decorated);
@@ -1630,16 +1488,14 @@ BOOL RTTI::processVftable(ea_t vft, ea_t col, BOOL known)
                     // COL name
                     if (!hasName((ea_t) col))
                     {
-						char decorated[MAXSTR];
 						strcpy(decorated, FORMAT_RTTI_COL_PREFIX);
 						strncat_s(decorated, MAXSTR, combinedName, (MAXSTR - (1 + SIZESTR(FORMAT_RTTI_COL_PREFIX))));
                         setName((ea_t) col, decorated);
                     }
 
                     // Build hierarchy string starting with parent
-                    char plainName[MAXSTR];
                     getPlainTypeName(bi->m_name, plainName);
-                    cmt.sprnt("%s%s: ", ((bi->m_name[3] == 'V') ? "" : "struct "), plainName);
+                    cmt.format("%s%s: ", ((bi->m_name[3] == 'V') ? "" : "struct "), plainName);
                     placed++;
 
                     // Concatenate forward child hierarchy
@@ -1648,11 +1504,11 @@ BOOL RTTI::processVftable(ea_t vft, ea_t col, BOOL known)
                         for (; index < (int) numBaseClasses; index++)
                         {
                             getPlainTypeName(list[index].m_name, plainName);
-                            cmt.cat_sprnt("%s%s, ", ((list[index].m_name[3] == 'V') ? "" : "struct "), plainName);
+                            cmt.appendf("%s%s, ", ((list[index].m_name[3] == 'V') ? "" : "struct "), plainName);
                             placed++;
                         }
                         if (placed > 1)
-                            cmt.remove((cmt.length() - 2), 2);
+                            cmt.truncate(cmt.length() - 2);
                     }
                 }
 
@@ -1664,16 +1520,16 @@ BOOL RTTI::processVftable(ea_t vft, ea_t col, BOOL known)
                     for (; index >= 0; index--)
                     {
                         getPlainTypeName(list[index].m_name, plainName);
-                        cmt.cat_sprnt("%s%s, ", ((list[index].m_name[3] == 'V') ? "" : "struct "), plainName);
+                        cmt.appendf("%s%s, ", ((list[index].m_name[3] == 'V') ? "" : "struct "), plainName);
                         placed++;
                     }
                     if (placed > 1)
-                        cmt.remove((cmt.length() - 2), 2);
+                        cmt.truncate(cmt.length() - 2);
                 }
                 */
 
                 if (placed > 1)
-                    cmt += ';';
+                    cmt.append(";");
 
                 sucess = TRUE;
             }
@@ -1683,16 +1539,17 @@ BOOL RTTI::processVftable(ea_t vft, ea_t col, BOOL known)
 
         if (sucess)
         {
+            g_rttiStore.insert(vft, RK_VFT, (UINT32) (vi.end - vi.start));
+
             // Store entry
-            addTableEntry(((chdAttributes & 0xF) | (isTopLevel ? RTTI::IS_TOP_LEVEL : 0)), vft, vi.methodCount, "%s@%s", demangledColName, cmt.c_str());
+            addTableEntry(((chdAttributes & 0xF) | (isTopLevel ? RTTI::IS_TOP_LEVEL : 0)), vft, vi.methodCount, demangledColName, cmt.c_str());
 
             // Add a separating comment above RTTI COL
-			ea_t colPtr = (vft - plat.ptrSize);
-			fixEa(colPtr);
+			ea_t colPtr = (vft - W::ptrSize);
+			fixEa<W>(colPtr);
 			//cmt.cat_sprnt("  %s O: %d, A: %d  (#classinformer)", attributeLabel(chdAttributes, numBaseClasses), offset, chdAttributes);
-			cmt.cat_sprnt(" %s (#classinformer)", attributeLabel(chdAttributes));
-			if (!hasAnteriorComment(colPtr))
-				setAnteriorComment(colPtr, "\n; %s %s", ((colName[3] == 'V') ? "class" : "struct"), cmt.c_str());
+			cmt.appendf(" %s (#classinformer)", attributeLabel(chdAttributes));
+			setAnteriorCommentIfNone(colPtr, "\n; %s %s", ((colName[3] == 'V') ? "class" : "struct"), cmt.c_str());
 
             result = TRUE;
         }
@@ -1709,11 +1566,12 @@ BOOL RTTI::processVftable(ea_t vft, ea_t col, BOOL known)
         // Just set COL name
         if (!hasName(col))
         {
-            char colName[MAXSTR];
-            type_info::getName(typeInfo, colName, SIZESTR(colName));
+            LPSTR colName = vftArena.alloc<char>(MAXSTR);
+            colName[0] = 0;
+            type_info::getName<W>(typeInfo, colName, (MAXSTR - 1));
 
-            char decorated[MAXSTR];
-            _snprintf_s(decorated, sizeof(decorated), SIZESTR(decorated), FORMAT_RTTI_COL, SKIP_TD_TAG(colName));
+            LPSTR decorated = vftArena.alloc<char>(MAXSTR);
+            _snprintf_s(decorated, MAXSTR, (MAXSTR - 1), FORMAT_RTTI_COL, SKIP_TD_TAG(colName));
             setName(col, decorated);
         }
     }
@@ -1722,6 +1580,20 @@ BOOL RTTI::processVftable(ea_t vft, ea_t col, BOOL known)
 }
 
 
+// Report and free the vftable phase arena
+void RTTI::endVftablePhase()
+{
+    const Arena::STATS &stats = vftArena.stats();
+    if (stats.allocs)
+    {
+        char buf1[32], buf2[32];
+        msg("Vftable temporaries: %s served from %s heap block(s), peak %s.\n", NumberCommaString(stats.allocs, buf1), NumberCommaString(stats.heapBlocks, buf2), byteSizeString(stats.peak));
+    }
+    vftArena.release();
+    vftArena.clearStats();
+}
+
+
 // ===============================================================================================
 
 // New strategy: Since IDA's own internal RTTI system is so good now at leat at version 9, we'll
@@ -1730,66 +1602,37 @@ BOOL RTTI::gatherKnownRttiData()
 {
 	try
 	{
-        // RTTI type mangled name patterns
-        #define PATE(_prefix, _verify, _eaSet) { _prefix, _verify, _eaSet }
-        struct PATCE
-        {
-            LPCSTR prefix;
-            LPCSTR verify;
-            eaSet *set;
-        } __declspec(align(32)) rttiTypePatterns[] =
-        {
-            PATE("??_R0", "`RTTI Type Descriptor'", &tdSet),
-            PATE("??_R1", "`RTTI Base Class Descriptor", &bcdSet),
-            PATE("??_R3", "`RTTI Class Hierarchy Descriptor'", &chdSet),
-            PATE("??_R4", "`RTTI Complete Object Locator'", &colSet),
-            PATE("??_7", "`vftable'", &vftSet)
-        };
-
-	    // Walk all names in the IDB
+        // Load the RTTI name index, or build it with a walk of all names in the IDB
         TIMESTAMP startTime = GetTimeStamp();
-	    size_t nameCount = get_nlist_size();
-	    for (size_t i = 0; i < nameCount; i++)
-	    {
-            // Next name
-            LPCSTR name = get_nlist_name(i);
-            for (size_t j = 0; j < _countof(rttiTypePatterns); j++)
-            {
-                // Match a known RTTI type pattern?
-                PATCE &pe = rttiTypePatterns[j];
-                if (strncmp(name, pe.prefix, strlen(pe.prefix)) == 0)
-                {
-				    // Yes
-				    ea_t ea = get_nlist_ea(i);
-                    /*
-					// Verify it
-					// Fails for many "??_R4" types
-				    qstring qstr;
-				    demangle_name(&qstr, name, MT_MSCOMP, DQT_FULL);
-				    if (!strstr(qstr.c_str(), pe.verify))
-					    msg(" ** 0x%llX \"%s\" \"%s\"\n", ea, pe.prefix, qstr.c_str());
-                    */
-                    pe.set->insert(ea);
-                }
-            }
-
-            if(i % 1000)
-			    if (WaitBox::isUpdateTime())
-				    if (WaitBox::updateAndCancelCheck())
-					    return TRUE;
-	    }
+        if (g_rttiNameIndex.prepare())
+            return TRUE;
+        g_rttiNameIndex.forEach(RK_ANY, [](ea_t ea, BYTE kind) { g_rttiStore.insert(ea, (kind & RK_ANY), kindSize(kind & RK_ANY)); });
+        g_rttiStore.commit();
         TIMESTAMP endTime = (GetTimeStamp() - startTime);
         char buf1[32], buf2[32], buf3[32], buf4[32];
-        msg("%s name search took: %s\n", NumberCommaString(nameCount, buf1), TimeString(endTime));
-        msg("Totals: COL: %s, BCD: %s, CHD: %s, TD: %s\n", NumberCommaString(colSet.size(), buf1), NumberCommaString(bcdSet.size(), buf2), NumberCommaString(chdSet.size(), buf3), NumberCommaString(tdSet.size(), buf4));
+        if (g_rttiNameIndex.wasRebuilt())
+            msg("%s name search took: %s\n", NumberCommaString(get_nlist_size(), buf1), TimeString(endTime));
+        else
+            msg("%s indexed names loaded in: %s\n", NumberCommaString(g_rttiNameIndex.size(), buf1), TimeString(endTime));
+        msg("Totals: COL: %s, BCD: %s, CHD: %s, TD: %s\n", NumberCommaString(g_rttiStore.count(RK_COL), buf1), NumberCommaString(g_rttiStore.count(RK_BCD), buf2), NumberCommaString(g_rttiStore.count(RK_CHD), buf3), NumberCommaString(g_rttiStore.count(RK_TD), buf4));
         WaitBox::processIdaEvents();
-        #undef PATE
 
-        // Merge them all into a supper set
-        superSet.clear();
-	    std::vector<eaSet*> all = { &tdSet, &bcdSet, &chdSet, &colSet, &vftSet };
-	    for (const eaSet *sp: all) superSet.insert(sp->begin(), sp->end());
+        #ifdef RTTI_STORE_BENCHMARK
+        g_rttiStore.benchmark();
+        #endif
 	}
 	CATCH()
     return FALSE;
 }
+
+
+// Pointer width instantiations for the callers outside this module
+#define INSTANTIATE_RTTI(W) \
+    template BOOL RTTI::type_info::isValid<W>(ea_t typeInfo); \
+    template BOOL RTTI::_RTTICompleteObjectLocator::isValid<W>(ea_t col); \
+    template BOOL RTTI::_RTTICompleteObjectLocator::tryStruct<W>(ea_t col); \
+    template BOOL RTTI::processVftable<W>(ea_t vft, ea_t col, BOOL known); \
+    template UINT32 RTTI::getBaseClasses<W>(ea_t col, __out qvector<BASECLASS> &bases);
+INSTANTIATE_RTTI(RTTI::PTR32)
+INSTANTIATE_RTTI(RTTI::PTR64)
+#undef INSTANTIATE_RTTI
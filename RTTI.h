@@ -9,10 +9,10 @@ namespace RTTI
 	// std::type_info, aka "_TypeDescriptor" and "_RTTITypeDescriptor" in CRT source, class representation
 	struct type_info
 	{
-		static BOOL isValid(ea_t typeInfo);
+		template <class W> static BOOL isValid(ea_t typeInfo);
 		static BOOL isTypeName(ea_t name);
-		static int  getName(ea_t typeInfo, __out LPSTR bufffer, int bufferSize);
-		static void tryStruct(ea_t typeInfo);
+		template <class W> static int  getName(ea_t typeInfo, __out LPSTR bufffer, int bufferSize);
+		template <class W> static void tryStruct(ea_t typeInfo);
 	};
 
 	#pragma warning(push)
@@ -59,8 +59,8 @@ namespace RTTI
 		UINT32 attributes;			// 0C Flags
 		int classDescriptor;		// 10 Image relative offset of _RTTIClassHierarchyDescriptor. If "attributes" & BCD_HASPCHD
 
-        static BOOL isValid(ea_t bcd, INT64 colBase64 = NULL);
-        static void tryStruct(ea_t bcd, __out_bcount(MAXSTR) LPSTR baseClassName, INT64 colBase64 = NULL);
+        template <class W> static BOOL isValid(ea_t bcd, INT64 colBase64 = NULL);
+        template <class W> static void tryStruct(ea_t bcd, __out_bcount(MAXSTR) LPSTR baseClassName, INT64 colBase64 = NULL);
 	};
 
     // "Class Hierarchy Descriptor" (CHD) describes the inheritance hierarchy of a class; shared by all COLs for the class
@@ -76,8 +76,8 @@ namespace RTTI
 		UINT32 numBaseClasses;	// 08 Number of classes in the following 'baseClassArray'
         int baseClassArray;     // 0C _RTTIBaseClassArray*. Pointer EA_32 for 32bit, offset added to COL base ea_t for 64bit
 
-        static BOOL isValid(ea_t chd, INT64 colBase64 = NULL);
-        static void tryStruct(ea_t chd, INT64 colBase64 = NULL);
+        template <class W> static BOOL isValid(ea_t chd, INT64 colBase64 = NULL);
+        template <class W> static void tryStruct(ea_t chd, INT64 colBase64 = NULL);
 	};
 
 	#if 0
@@ -100,8 +100,8 @@ namespace RTTI
 		int typeDescriptor;	    // 0C (type_info *) of the complete class. Pointer EA_32 for 32bit, offset added to ea_t for 64bit
 		int classDescriptor;	// 10 (_RTTIClassHierarchyDescriptor *) Describes inheritance hierarchy. Pointer EA_32 for 32bit, offset added to ea_t for 64bit
 
-		static BOOL isValid(ea_t col);
-		static BOOL tryStruct(ea_t col);
+		template <class W> static BOOL isValid(ea_t col);
+		template <class W> static BOOL tryStruct(ea_t col);
 	};
 
 	struct __declspec(novtable) _RTTICompleteObjectLocator_32 : _RTTICompleteObjectLocator
@@ -115,11 +115,60 @@ namespace RTTI
 	};
 	#pragma pack(pop)
 
+    // Pointer width traits.
+    // The RTTI scan and placement paths are templates over these so a run picks the fully specialized
+    // 32 or 64 bit instantiation once up front instead of testing 'plat.is64' on every call.
+    struct PTR32
+    {
+        static const BOOL is64 = FALSE;
+        static const UINT32 ptrSize = sizeof(EA_32);
+        static const UINT32 colSignature = 0;
+        typedef type_info_32 td_t;
+        typedef _RTTICompleteObjectLocator_32 col_t;
+
+        static ea_t getEa(ea_t ea) { return (ea_t) get_32bit(ea); }
+        static BOOL isEa(flags_t flags) { return is_dword(flags); }
+        static void putEa(ea_t ea) { create_dword(ea, sizeof(EA_32), TRUE); }
+
+        // RTTI references are direct addresses
+        static ea_t getRef(ea_t ref, INT64 colBase) { return (ea_t) get_32bit(ref); }
+        static INT64 getColBase(ea_t col) { return 0; }
+    };
+
+    struct PTR64
+    {
+        static const BOOL is64 = TRUE;
+        static const UINT32 ptrSize = sizeof(UINT64);
+        static const UINT32 colSignature = 1;
+        typedef type_info_64 td_t;
+        typedef _RTTICompleteObjectLocator_64 col_t;
+
+        static ea_t getEa(ea_t ea) { return (ea_t) get_64bit(ea); }
+        static BOOL isEa(flags_t flags) { return is_qword(flags); }
+        static void putEa(ea_t ea) { create_qword(ea, sizeof(UINT64), TRUE); }
+
+        // RTTI references are signed 32bit offsets from the COL object base
+        static ea_t getRef(ea_t ref, INT64 colBase) { return (ea_t) (colBase + (INT32) get_32bit(ref)); }
+        static INT64 getColBase(ea_t col) { return ((INT64) col - (INT32) get_32bit(col + offsetof(_RTTICompleteObjectLocator_64, objectBase))); }
+    };
+
     const WORD IS_TOP_LEVEL = 0x8000;
 
+    // Base class of a COL's complete class, for use outside of the scan
+    struct BASECLASS
+    {
+        qstring name;  // Demangled, the mangled one if it doesn't demangle
+        PMD pmd;
+        UINT32 attributes;
+        UINT32 numContainedBases;
+    };
+
     void freeWorkingData();
 	void addDefinitionsToIda();
 	BOOL gatherKnownRttiData();
-    BOOL processVftable(ea_t eaTable, ea_t col, BOOL known = FALSE);
+    void endVftablePhase();
+    void flushPlacements(__out UINT32 &objects, __out UINT32 &runs, __out UINT32 &creates);
+    template <class W> BOOL processVftable(ea_t eaTable, ea_t col, BOOL known = FALSE);
+    template <class W> UINT32 getBaseClasses(ea_t col, __out qvector<BASECLASS> &bases);
 }
 
@@ -0,0 +1,128 @@
+// User level result cache
+#include "stdafx.h"
+#include "Main.h"
+#include "ResultTable.h"
+#include "ResultCache.h"
+
+static const char CACHE_DIR[] = { "ClassInformer" };
+static const UINT32 CACHE_MAGIC = 0x43524943; // "CIRC"
+static const UINT32 CACHE_VERSION = 1;
+
+#pragma pack(push, 1)
+struct CACHEHEADER
+{
+    UINT32 magic;
+    UINT32 version;
+    UINT32 pluginVersion;
+    BYTE   sha256[32];
+    UINT64 imageBase;
+    UINT32 is64;
+    UINT32 tableSize;   // ResultTable blob that follows
+};
+#pragma pack(pop)
+
+
+// Input file hash, returns FALSE if IDA doesn't have it
+static BOOL getInputHash(__out BYTE hash[32])
+{
+    return retrieve_input_file_sha256(hash);
+}
+
+// "<user IDA dir>/ClassInformer/<SHA-256>_<version>.bin"
+static void getCachePath(const BYTE hash[32], __out qstring &path)
+{
+    qstring name;
+    for (UINT32 i = 0; i < 32; i++)
+        name.cat_sprnt("%02X", hash[i]);
+    name.cat_sprnt("_%08X.bin", MY_VERSION);
+
+    char buffer[QMAXPATH];
+    qmakepath(buffer, sizeof(buffer), get_user_idadir(), CACHE_DIR, name.c_str(), NULL);
+    path = buffer;
+}
+
+BOOL findCachedResult(__out qstring &path)
+{
+    BYTE hash[32];
+    if (!getInputHash(hash))
+        return FALSE;
+    getCachePath(hash, path);
+    return qfileexist(path.c_str());
+}
+
+BOOL loadCachedResult(LPCSTR path, __out ResultTable &table)
+{
+    table.clear();
+    BYTE hash[32];
+    if (!getInputHash(hash))
+        return FALSE;
+
+    BOOL result = FALSE;
+    if (FILE *fp = qfopen(path, "rb"))
+    {
+        CACHEHEADER header;
+        if ((qfread(fp, &header, sizeof(header)) == sizeof(header)) && (header.magic == CACHE_MAGIC) && (header.version == CACHE_VERSION) &&
+            (header.pluginVersion == MY_VERSION) && (memcmp(header.sha256, hash, sizeof(hash)) == 0) && (header.is64 == (UINT32) inf_is_64bit()))
+        {
+            bytevec_t blob;
+            blob.resize(header.tableSize);
+            if ((qfread(fp, blob.begin(), blob.size()) == (ssize_t) blob.size()) && table.deserialize(blob))
+            {
+                // Rebase if the IDB was loaded at a different address
+                ea_t imageBase = get_imagebase();
+                if ((UINT64) imageBase != header.imageBase)
+                {
+                    for (UINT32 i = 0; i < table.size(); i++)
+                        table.setVft(i, (ea_t) ((table.vft(i) - header.imageBase) + imageBase));
+                }
+                result = TRUE;
+            }
+        }
+        qfclose(fp);
+    }
+
+    if (!result)
+        table.clear();
+    return result;
+}
+
+void saveCachedResult(ResultTable &table)
+{
+    BYTE hash[32];
+    qstring path;
+    if (table.empty() || !getInputHash(hash))
+        return;
+    getCachePath(hash, path);
+
+    char dir[QMAXPATH];
+    qmakepath(dir, sizeof(dir), get_user_idadir(), CACHE_DIR, NULL);
+    qmkdir(dir, 0777);
+
+    bytevec_t blob;
+    table.serialize(blob);  // Leaves the modified state for the IDB save
+    CACHEHEADER header = { CACHE_MAGIC, CACHE_VERSION, MY_VERSION, {}, (UINT64) get_imagebase(), (UINT32) inf_is_64bit(), (UINT32) blob.size() };
+    memcpy(header.sha256, hash, sizeof(hash));
+
+    // Write to a temporary then rename over, so a partly written cache file never exists
+    qstring tempPath = path;
+    tempPath += ".tmp";
+    BOOL written = FALSE;
+    if (FILE *fp = qfopen(tempPath.c_str(), "wb"))
+    {
+        written = ((qfwrite(fp, &header, sizeof(header)) == sizeof(header)) && (qfwrite(fp, blob.begin(), blob.size()) == (ssize_t) blob.size()));
+        qfclose(fp);
+    }
+
+    if (written)
+    {
+        qunlink(path.c_str());
+        written = (qrename(tempPath.c_str(), path.c_str()) == 0);
+    }
+    if (!written)
+    {
+        qunlink(tempPath.c_str());
+        msg("** Failed to write result cache file: \"%s\" **\n", path.c_str());
+    }
+    else
+        msg("Saved result to cache: \"%s\".\n", path.c_str());
+}
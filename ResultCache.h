@@ -0,0 +1,14 @@
+// User level result cache
+#pragma once
+
+// Vftable results saved under the user IDA directory keyed by the input file SHA-256 and the plugin version, so a
+// new IDB for an already analyzed binary can import them instead of scanning.
+
+// Get the cache file path for the input file, returns TRUE if it exists
+BOOL findCachedResult(__out qstring &path);
+
+// Load the cached table, rebased to the IDB image base. Returns FALSE if the file is not a valid cache for it.
+BOOL loadCachedResult(LPCSTR path, __out ResultTable &table);
+
+// Save the table to the cache
+void saveCachedResult(ResultTable &table);
@@ -0,0 +1,347 @@
+// Vftable result table
+#include "stdafx.h"
+#include "Main.h"
+#include "ResultTable.h"
+#include <algorithm>
+
+// Serialized format version, bump on any layout change
+static const UINT32 RESULT_TABLE_VERSION = 1;
+
+// Hierarchy layout flags.
+// The processVftable() hierarchy text is "Class: Base1, Base2, .." with an optional trailing ';'. It gets stored as the
+// pool IDs of the class names and put back together on display. Text not in that form is kept as a single string.
+const BYTE HF_HEAD = (1 << 0);  // First ID is the "Class: " head
+const BYTE HF_SEMI = (1 << 1);  // Ends with ';'
+
+#pragma pack(push, 1)
+struct TABLEHEADER
+{
+    UINT32 version;
+    UINT32 rows;
+    UINT32 idCount;    // Hierarchy IDs
+    UINT32 poolCount;  // Pool strings
+    UINT32 poolSize;   // Pool bytes
+};
+#pragma pack(pop)
+
+ResultTable g_resultTable;
+
+
+// Index the pool if it was loaded from a blob, it's only needed once strings are added or looked up
+void ResultTable::indexPool()
+{
+    if (m_poolIndex.empty() && !m_poolOffset.empty())
+    {
+        m_poolIndex.reserve(m_poolOffset.size());
+        for (UINT32 i = 0; i < (UINT32) m_poolOffset.size(); i++)
+            m_poolIndex.emplace(poolString(i), i);
+    }
+}
+
+UINT32 ResultTable::poolId(LPCSTR str)
+{
+    indexPool();
+    auto it = m_poolIndex.find(str);
+    return ((it != m_poolIndex.end()) ? it->second : NO_POOL_ID);
+}
+
+// Return ID of string in pool, adding it if new
+UINT32 ResultTable::intern(LPCSTR str, size_t len)
+{
+    indexPool();
+
+    auto it = m_poolIndex.emplace(std::string(str, len), (UINT32) m_poolOffset.size());
+    if (it.second)
+    {
+        m_poolOffset.push_back((UINT32) m_pool.size());
+        m_pool.insert(m_pool.end(), str, (str + len));
+        m_pool.push_back(0);
+    }
+    return it.first->second;
+}
+
+void ResultTable::setHierarchy(UINT32 row, LPCSTR hierarchy)
+{
+    BYTE format = 0;
+    m_hierStart[row] = (UINT32) m_hierIds.size();
+
+    if (size_t len = strlen(hierarchy))
+    {
+        LPCSTR head = strstr(hierarchy, ": ");
+        if (head)
+        {
+            format |= HF_HEAD;
+            m_hierIds.push_back(intern(hierarchy, (head - hierarchy)));
+
+            LPCSTR end = (hierarchy + len);
+            if (end[-1] == ';')
+            {
+                format |= HF_SEMI;
+                end--;
+            }
+
+            // Base class names, split at the ", " separators outside of template and function argument lists
+            LPCSTR name = (head + 2);
+            while (name < end)
+            {
+                LPCSTR next = name;
+                int depth = 0;
+                for (; next < end; next++)
+                {
+                    if ((*next == '<') || (*next == '('))
+                        depth++;
+                    else
+                    if (((*next == '>') || (*next == ')')) && depth)
+                        depth--;
+                    else
+                    if (!depth && (next[0] == ',') && ((next + 1) < end) && (next[1] == ' '))
+                        break;
+                }
+                m_hierIds.push_back(intern(name, (next - name)));
+                name = ((next < end) ? (next + 2) : end);
+            }
+        }
+        else
+            m_hierIds.push_back(intern(hierarchy, len));
+    }
+
+    m_hierFormat[row] = format;
+    m_hierCount[row] = ((UINT32) m_hierIds.size() - m_hierStart[row]);
+}
+
+void ResultTable::getHierarchy(UINT32 row, __out qstring &hierarchy) const
+{
+    hierarchy.qclear();
+    const UINT32 *id = &m_hierIds[m_hierStart[row]];
+    UINT32 count = m_hierCount[row];
+    if (!count)
+        return;
+
+    BYTE format = m_hierFormat[row];
+    if (format & HF_HEAD)
+    {
+        hierarchy = poolString(*id++);
+        hierarchy += ": ";
+        for (UINT32 i = 1; i < count; i++)
+        {
+            if (i > 1)
+                hierarchy += ", ";
+            hierarchy += poolString(*id++);
+        }
+        if (format & HF_SEMI)
+            hierarchy += ';';
+    }
+    else
+        hierarchy = poolString(*id);
+}
+
+
+UINT32 ResultTable::add(ea_t vft, UINT32 methods, WORD flags, LPCSTR type, LPCSTR hierarchy)
+{
+    UINT32 row = (UINT32) m_vft.size();
+    m_vft.push_back(vft);
+    m_methods.push_back(methods);
+    m_flags.push_back(flags);
+    m_type.push_back(intern(type, strlen(type)));
+    m_hierFormat.push_back(0);
+    m_hierStart.push_back(0);
+    m_hierCount.push_back(0);
+    setHierarchy(row, hierarchy);
+    updateMax(vft);
+    changed(TRUE);
+    return row;
+}
+
+// The row's old ID list is left in place, serialize() drops it
+void ResultTable::set(UINT32 row, ea_t vft, UINT32 methods, WORD flags, LPCSTR type, LPCSTR hierarchy)
+{
+    m_vft[row] = vft;
+    m_methods[row] = methods;
+    m_flags[row] = flags;
+    m_type[row] = intern(type, strlen(type));
+    setHierarchy(row, hierarchy);
+    updateMax(vft);
+    changed();
+}
+
+void ResultTable::remove(const std::vector<BYTE> &drop)
+{
+    UINT32 count = size(), out = 0;
+    m_maxVft = 0;
+    for (UINT32 i = 0; i < count; i++)
+    {
+        if ((i < drop.size()) && drop[i])
+            continue;
+
+        updateMax(m_vft[i]);
+        if (out != i)
+        {
+            m_vft[out] = m_vft[i];
+            m_methods[out] = m_methods[i];
+            m_flags[out] = m_flags[i];
+            m_type[out] = m_type[i];
+            m_hierFormat[out] = m_hierFormat[i];
+            m_hierStart[out] = m_hierStart[i];
+            m_hierCount[out] = m_hierCount[i];
+        }
+        out++;
+    }
+
+    if (out != count)
+    {
+        m_vft.resize(out);
+        m_methods.resize(out);
+        m_flags.resize(out);
+        m_type.resize(out);
+        m_hierFormat.resize(out);
+        m_hierStart.resize(out);
+        m_hierCount.resize(out);
+        changed();
+    }
+}
+
+// Appends and flag changes keep the existing rows' layout, anything else starts a new edit generation
+void ResultTable::changed(BOOL keepLayout)
+{
+    m_modified = TRUE;
+    m_generation++;
+    if (!keepLayout)
+    {
+        m_editGeneration = m_generation;
+        m_flagChanges.clear();
+    }
+}
+
+void ResultTable::clear()
+{
+    m_vft.clear();
+    m_methods.clear();
+    m_flags.clear();
+    m_type.clear();
+    m_hierFormat.clear();
+    m_hierStart.clear();
+    m_hierCount.clear();
+    m_hierIds.clear();
+    m_pool.clear();
+    m_poolOffset.clear();
+    m_poolIndex.clear();
+    m_flagChanges.clear();
+    m_maxVft = 0;
+    m_editGeneration = ++m_generation;
+    m_modified = FALSE;
+}
+
+
+// Append a column to the blob
+template <class T> static void putColumn(bytevec_t &blob, const T *data, size_t count)
+{
+    if (count)
+        blob.append(data, (count * sizeof(T)));
+}
+
+// Read a column from the blob, returns FALSE if past the end
+template <class T> static BOOL getColumn(const bytevec_t &blob, size_t &offset, std::vector<T> &column, size_t count)
+{
+    size_t bytes = (count * sizeof(T));
+    if ((offset + bytes) > blob.size())
+        return FALSE;
+    column.resize(count);
+    if (bytes)
+        memcpy(column.data(), (blob.begin() + offset), bytes);
+    offset += bytes;
+    return TRUE;
+}
+
+// Serialized as the header then each column in turn, the hierarchy ID lists packed in row order, and the pool.
+// Addresses are written as 64bit regardless of the IDA address size.
+void ResultTable::serialize(__out bytevec_t &blob)
+{
+    UINT32 rows = size();
+
+    // Pack the ID lists, dropping any left over from set()
+    std::vector<UINT32> ids;
+    ids.reserve(m_hierIds.size());
+    for (UINT32 i = 0; i < rows; i++)
+        ids.insert(ids.end(), (m_hierIds.begin() + m_hierStart[i]), (m_hierIds.begin() + (m_hierStart[i] + m_hierCount[i])));
+
+    std::vector<UINT64> vft(m_vft.begin(), m_vft.end());
+
+    TABLEHEADER header = { RESULT_TABLE_VERSION, rows, (UINT32) ids.size(), (UINT32) m_poolOffset.size(), (UINT32) m_pool.size() };
+    blob.clear();
+    blob.reserve(sizeof(TABLEHEADER) + (rows * (sizeof(UINT64) + sizeof(UINT32) + sizeof(WORD) + sizeof(UINT32) + sizeof(BYTE) + sizeof(UINT32))) +
+                 (ids.size() * sizeof(UINT32)) + m_pool.size());
+    blob.append(&header, sizeof(header));
+    putColumn(blob, vft.data(), rows);
+    putColumn(blob, m_methods.data(), rows);
+    putColumn(blob, m_flags.data(), rows);
+    putColumn(blob, m_type.data(), rows);
+    putColumn(blob, m_hierFormat.data(), rows);
+    putColumn(blob, m_hierCount.data(), rows);
+    putColumn(blob, ids.data(), ids.size());
+    putColumn(blob, m_pool.data(), m_pool.size());
+
+    // Keep the packed lists too
+    UINT32 start = 0;
+    for (UINT32 i = 0; i < rows; i++)
+    {
+        m_hierStart[i] = start;
+        start += m_hierCount[i];
+    }
+    m_hierIds.swap(ids);
+}
+
+// Returns FALSE if the blob is not a valid table of this version
+BOOL ResultTable::deserialize(const bytevec_t &blob)
+{
+    clear();
+    if (blob.size() < sizeof(TABLEHEADER))
+        return FALSE;
+    TABLEHEADER header;
+    memcpy(&header, blob.begin(), sizeof(TABLEHEADER));
+    if (header.version != RESULT_TABLE_VERSION)
+        return FALSE;
+
+    size_t offset = sizeof(TABLEHEADER);
+    std::vector<UINT64> vft;
+    if (!getColumn(blob, offset, vft, header.rows) ||
+        !getColumn(blob, offset, m_methods, header.rows) ||
+        !getColumn(blob, offset, m_flags, header.rows) ||
+        !getColumn(blob, offset, m_type, header.rows) ||
+        !getColumn(blob, offset, m_hierFormat, header.rows) ||
+        !getColumn(blob, offset, m_hierCount, header.rows) ||
+        !getColumn(blob, offset, m_hierIds, header.idCount) ||
+        !getColumn(blob, offset, m_pool, header.poolSize) ||
+        (offset != blob.size()) || (header.poolSize && (m_pool.back() != 0)))
+    {
+        clear();
+        return FALSE;
+    }
+    m_vft.assign(vft.begin(), vft.end());
+    for (ea_t ea: m_vft)
+        updateMax(ea);
+
+    // Pool string offsets
+    m_poolOffset.reserve(header.poolCount);
+    for (UINT32 i = 0; i < header.poolSize; i += (UINT32) (strlen(&m_pool[i]) + 1))
+        m_poolOffset.push_back(i);
+
+    // Row ID list starts, and bounds check the IDs
+    BOOL valid = (m_poolOffset.size() == header.poolCount);
+    m_hierStart.resize(header.rows);
+    UINT64 start = 0;
+    for (UINT32 i = 0; valid && (i < header.rows); i++)
+    {
+        m_hierStart[i] = (UINT32) start;
+        start += m_hierCount[i];
+        valid = ((m_type[i] < header.poolCount) && (start <= header.idCount));
+    }
+    for (UINT32 i = 0; valid && (i < header.idCount); i++)
+        valid = (m_hierIds[i] < header.poolCount);
+
+    if (!valid || (start != header.idCount))
+    {
+        clear();
+        return FALSE;
+    }
+    return TRUE;
+}
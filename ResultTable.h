@@ -0,0 +1,107 @@
+// Vftable result table
+#pragma once
+#include <unordered_map>
+#include <string>
+
+// Row flag for a stored row edited in the IDB since, to be revalidated
+const WORD TBL_DIRTY = 0x4000;
+
+// Column store of the located vftables, the chooser list rows.
+// The type and hierarchy text is kept as ID lists into a deduplicated string pool since the same class names
+// repeat across many rows, and the whole table serializes to a single versioned blob.
+class ResultTable
+{
+public:
+    // Append a row, returns its index
+    UINT32 add(ea_t vft, UINT32 methods, WORD flags, LPCSTR type, LPCSTR hierarchy);
+
+    // Write over an existing row
+    void set(UINT32 row, ea_t vft, UINT32 methods, WORD flags, LPCSTR type, LPCSTR hierarchy);
+
+    // Remove the rows flagged in 'drop' (by row index), keeping the order of the rest
+    void remove(const std::vector<BYTE> &drop);
+
+    UINT32 size() const { return (UINT32) m_vft.size(); }
+    BOOL empty() const { return m_vft.empty(); }
+
+    ea_t vft(UINT32 row) const { return m_vft[row]; }
+    void setVft(UINT32 row, ea_t vft) { m_vft[row] = vft; updateMax(vft); changed(); }
+    UINT32 methods(UINT32 row) const { return m_methods[row]; }
+    WORD flags(UINT32 row) const { return m_flags[row]; }
+    void setFlags(UINT32 row, WORD flags) { m_flags[row] = flags; m_flagChanges.push_back(row); changed(TRUE); }
+
+    // Type name and reassembled hierarchy text
+    LPCSTR type(UINT32 row) const { return poolString(m_type[row]); }
+    void getHierarchy(UINT32 row, __out qstring &hierarchy) const;
+
+    // Pool string IDs, for views that sort by a name's rank in the pool instead of by its text
+    UINT32 typeId(UINT32 row) const { return m_type[row]; }
+    UINT32 hierarchyCount(UINT32 row) const { return m_hierCount[row]; }
+    UINT32 hierarchyId(UINT32 row, UINT32 index) const { return m_hierIds[m_hierStart[row] + index]; }
+    LPCSTR poolText(UINT32 id) const { return poolString(id); }
+
+    // ID of a pool string, NO_POOL_ID if it's not in the pool
+    static const UINT32 NO_POOL_ID = (UINT32) -1;
+    UINT32 poolId(LPCSTR str);
+
+    // Largest vft address, for the address column width
+    ea_t maxVft() const { return m_maxVft; }
+
+    // Changed since the last deserialize() or clearModified()
+    BOOL isModified() const { return m_modified; }
+    void clearModified() { m_modified = FALSE; }
+
+    // Bumped on every change, for views caching row data
+    UINT32 generation() const { return m_generation; }
+
+    // Generation of the last change other than an append or a flags change, so a view can format just the rows
+    // added since
+    UINT32 editGeneration() const { return m_editGeneration; }
+
+    // Rows whose flags changed since the last edit generation, in change order and possibly repeating.
+    // A view keeps its position in the log and only refreshes the rows logged past it.
+    UINT32 flagChangeCount() const { return (UINT32) m_flagChanges.size(); }
+    UINT32 flagChangeRow(UINT32 index) const { return m_flagChanges[index]; }
+
+    void serialize(__out bytevec_t &blob);
+    BOOL deserialize(const bytevec_t &blob);
+    void clear();
+
+    // Serialized and string pool sizes, for the stats
+    size_t poolSize() const { return m_pool.size(); }
+    UINT32 poolCount() const { return (UINT32) m_poolOffset.size(); }
+
+private:
+    UINT32 intern(LPCSTR str, size_t len);
+    void indexPool();
+    LPCSTR poolString(UINT32 id) const { return &m_pool[m_poolOffset[id]]; }
+    void setHierarchy(UINT32 row, LPCSTR hierarchy);
+    void updateMax(ea_t vft) { if (vft > m_maxVft) m_maxVft = vft; }
+    void changed(BOOL keepLayout = FALSE);
+
+    // Row columns
+    std::vector<ea_t>   m_vft;
+    std::vector<UINT32> m_methods;
+    std::vector<WORD>   m_flags;
+    std::vector<UINT32> m_type;       // Pool string ID
+    std::vector<BYTE>   m_hierFormat; // HF_* hierarchy layout flags
+    std::vector<UINT32> m_hierStart;  // First ID in 'm_hierIds'
+    std::vector<UINT32> m_hierCount;
+
+    // Hierarchy pool string ID lists
+    std::vector<UINT32> m_hierIds;
+
+    // String pool, null terminated strings by offset
+    std::vector<char>   m_pool;
+    std::vector<UINT32> m_poolOffset;
+    std::unordered_map<std::string, UINT32> m_poolIndex;  // Built on demand, only needed while adding
+
+    std::vector<UINT32> m_flagChanges;  // setFlags() rows since the last edit generation
+
+    ea_t m_maxVft = 0;
+    UINT32 m_generation = 0;
+    UINT32 m_editGeneration = 0;
+    BOOL m_modified = FALSE;
+};
+
+extern ResultTable g_resultTable;
@@ -0,0 +1,282 @@
+// Persistent RTTI name index
+#include "stdafx.h"
+#include "Main.h"
+#include "RttiStore.h"
+#include "RttiNameIndex.h"
+#include <WaitBoxEx.h>
+
+// Netnode constants
+const static char NAME_INDEX_NODE[] = {"$ClassInformer_names"};
+const char NN_INDEX_TAG = 'I';
+
+// Saved index header, followed by 'count' INDEXENTRYs
+#define NAME_INDEX_VERSION 2
+#pragma pack(push, 1)
+struct INDEXHEADER
+{
+    UINT32 version;
+    UINT32 count;
+    UINT64 nameCount;   // IDB name list size when saved
+};
+struct INDEXENTRY
+{
+    ea_t ea;
+    BYTE kind;
+};
+#pragma pack(pop)
+
+RttiNameIndex g_rttiNameIndex;
+
+
+// Return TRUE if 'name' of 'len' ends with 'suffix'
+template <size_t N> static inline BOOL endsWith(LPCSTR name, size_t len, const char (&suffix)[N])
+{
+    return((len >= (N - 1)) && (memcmp((name + (len - (N - 1))), suffix, (N - 1)) == 0));
+}
+
+BYTE RttiNameIndex::kindFromName(LPCSTR name)
+{
+    // One prefix check for all five instead of a strncmp() each
+    if ((name[0] == '?') && (name[1] == '?') && (name[2] == '_'))
+    {
+        if (name[3] == '7')
+            return RK_VFT;
+        else
+        if (name[3] == 'R')
+        {
+            switch (name[4])
+            {
+                case '0': return RK_TD;
+                case '1': return RK_BCD;
+                case '3': return RK_CHD;
+                case '4': return RK_COL;
+            };
+        }
+        return 0;
+    }
+
+    // CRT functions, by the last character before the full suffix compare
+    size_t len = strlen(name);
+    if (!len)
+        return 0;
+    char last = name[len - 1];
+    if ((last >= '0') && (last <= '9'))
+    {
+        // Strip a local enumeration suffix, I.E. "_initterm_0"
+        size_t i = len;
+        while ((i > 0) && (name[i - 1] >= '0') && (name[i - 1] <= '9'))
+            i--;
+        if ((i == 0) || (name[i - 1] != '_'))
+            return 0;
+        len = (i - 1);
+        last = (len ? name[len - 1] : 0);
+    }
+
+    switch (last)
+    {
+        case 't': return(endsWith(name, len, "_cinit") ? NK_CINIT : 0);
+        case 'm': return(endsWith(name, len, "_initterm") ? NK_INITTERM : 0);
+        case 'e': return(endsWith(name, len, "_initterm_e") ? NK_INITTERM_E : 0);
+    };
+    return 0;
+}
+
+void RttiNameIndex::hook()
+{
+    if (!m_hooked)
+        m_hooked = hook_event_listener(HT_IDB, this, NULL);
+}
+
+void RttiNameIndex::unhook()
+{
+    if (m_hooked)
+    {
+        unhook_event_listener(HT_IDB, this);
+        m_hooked = FALSE;
+    }
+    m_index.clear();
+    m_state = IS_UNLOADED;
+}
+
+
+// Load the saved index. Returns FALSE if there is none or it doesn't match the database anymore.
+BOOL RttiNameIndex::load()
+{
+    m_index.clear();
+    netnode node(NAME_INDEX_NODE);
+    if (node == BADNODE)
+        return FALSE;
+
+    bytevec_t blob;
+    if (node.getblob(&blob, 0, NN_INDEX_TAG) < (ssize_t) sizeof(INDEXHEADER))
+        return FALSE;
+
+    const INDEXHEADER *header = (const INDEXHEADER *) blob.begin();
+    if ((header->version != NAME_INDEX_VERSION) || (header->nameCount != (UINT64) get_nlist_size()) ||
+        (blob.size() != (sizeof(INDEXHEADER) + (header->count * sizeof(INDEXENTRY)))))
+        return FALSE;
+
+    // Saved in address order, so each insert goes at the end
+    const INDEXENTRY *entry = (const INDEXENTRY *) (header + 1);
+    for (UINT32 i = 0; i < header->count; i++, entry++)
+        m_index.emplace_hint(m_index.end(), entry->ea, entry->kind);
+    return TRUE;
+}
+
+void RttiNameIndex::save()
+{
+    netnode node(NAME_INDEX_NODE, SIZESTR(NAME_INDEX_NODE), TRUE);
+    bytevec_t blob;
+    blob.resize(sizeof(INDEXHEADER) + (m_index.size() * sizeof(INDEXENTRY)));
+    INDEXHEADER *header = (INDEXHEADER *) blob.begin();
+    header->version = NAME_INDEX_VERSION;
+    header->count = (UINT32) m_index.size();
+    header->nameCount = (UINT64) get_nlist_size();
+    INDEXENTRY *entry = (INDEXENTRY *) (header + 1);
+    for (auto &it: m_index)
+    {
+        entry->ea = it.first;
+        entry->kind = it.second;
+        entry++;
+    }
+    node.setblob(blob.begin(), blob.size(), 0, NN_INDEX_TAG);
+}
+
+void RttiNameIndex::discard()
+{
+    netnode node(NAME_INDEX_NODE);
+    if (node != BADNODE)
+        node.delblob(0, NN_INDEX_TAG);
+}
+
+// Full IDB name list walk
+BOOL RttiNameIndex::rebuild()
+{
+    m_index.clear();
+    size_t nameCount = get_nlist_size();
+    for (size_t i = 0; i < nameCount; i++)
+    {
+        BYTE kind = kindFromName(get_nlist_name(i));
+        if (kind)
+            m_index[get_nlist_ea(i)] = kind;
+
+        if(i % 1000)
+            if (WaitBox::isUpdateTime())
+                if (WaitBox::updateAndCancelCheck())
+                {
+                    m_index.clear();
+                    m_state = IS_ABSENT;
+                    return TRUE;
+                }
+    }
+    save();
+    m_state = IS_LOADED;
+    return FALSE;
+}
+
+BOOL RttiNameIndex::prepare()
+{
+    m_rebuilt = FALSE;
+    if (m_state == IS_LOADED)
+        return FALSE;
+    if ((m_state == IS_UNLOADED) && load())
+    {
+        m_state = IS_LOADED;
+        return FALSE;
+    }
+
+    m_rebuilt = TRUE;
+    return rebuild();
+}
+
+// First event for this database, pick up the saved index to keep it current
+void RttiNameIndex::ensureLoaded()
+{
+    if (m_state == IS_UNLOADED)
+        m_state = (load() ? IS_LOADED : IS_ABSENT);
+}
+
+
+ssize_t idaapi RttiNameIndex::on_event(ssize_t code, va_list va)
+{
+    try
+    {
+        switch (code)
+        {
+            // Name set, changed, or deleted
+            case idb_event::renamed:
+            {
+                ea_t ea = va_arg(va, ea_t);
+                LPCSTR newName = va_arg(va, LPCSTR);
+                ensureLoaded();
+                if (m_state == IS_LOADED)
+                {
+                    BYTE kind = (newName ? kindFromName(newName) : 0);
+                    if (kind)
+                        m_index[ea] = kind;
+                    else
+                        m_index.erase(ea);
+                }
+            }
+            break;
+
+            // Segment gone along with its names
+            case idb_event::segm_deleted:
+            {
+                ea_t startEa = va_arg(va, ea_t);
+                ea_t endEa = va_arg(va, ea_t);
+                ensureLoaded();
+                if (m_state == IS_LOADED)
+                    m_index.erase(m_index.lower_bound(startEa), m_index.lower_bound(endEa));
+            }
+            break;
+
+            // Segment moved, shift its names
+            case idb_event::segm_moved:
+            {
+                ea_t from = va_arg(va, ea_t);
+                ea_t to = va_arg(va, ea_t);
+                asize_t size = va_arg(va, asize_t);
+                ensureLoaded();
+                if ((m_state == IS_LOADED) && (from != to))
+                {
+                    auto first = m_index.lower_bound(from), last = m_index.lower_bound(from + size);
+                    std::vector<std::pair<ea_t, BYTE>> moved(first, last);
+                    m_index.erase(first, last);
+                    for (auto &it: moved)
+                        m_index[(it.first - from) + to] = it.second;
+                }
+            }
+            break;
+
+            // Rebase, simpler to just start over
+            case idb_event::allsegs_moved:
+            {
+                ensureLoaded();
+                m_index.clear();
+                m_state = IS_ABSENT;
+            }
+            break;
+
+            // Save with the database, or drop a saved index we didn't keep current
+            case idb_event::savebase:
+            {
+                if (m_state == IS_LOADED)
+                    save();
+                else
+                if (m_state == IS_ABSENT)
+                    discard();
+            }
+            break;
+
+            case idb_event::closebase:
+            {
+                m_index.clear();
+                m_state = IS_UNLOADED;
+            }
+            break;
+        };
+    }
+    CATCH()
+    return 0;
+}
@@ -0,0 +1,63 @@
+// Persistent RTTI name index
+#pragma once
+
+// CRT static table function kind tags, above the RttiStore RK_* ones
+const BYTE NK_CINIT      = (1 << 5); // "*_cinit"
+const BYTE NK_INITTERM   = (1 << 6); // "*_initterm"
+const BYTE NK_INITTERM_E = (1 << 7); // "*_initterm_e"
+const BYTE NK_CRT = (NK_CINIT | NK_INITTERM | NK_INITTERM_E);
+
+// Index of the addresses with RTTI mangled names ("??_R0", "??_R1", "??_R3", "??_R4" and "??_7" prefixes), plus the
+// CRT static table functions by name suffix including their local enumerated variants (I.E. "_initterm_0").
+// Saved to its own netnode with the database and kept current through IDB rename and segment events, so runs
+// after the first only need to load it instead of walking the whole IDB name list.
+class RttiNameIndex: public event_listener_t
+{
+public:
+    // Start/stop tracking IDB events
+    void hook();
+    void unhook();
+
+    // Make the index current, loading it or rebuilding it from the name list if needed.
+    // Returns TRUE if canceled.
+    BOOL prepare();
+
+    // Iterate the indexed addresses of the given kinds in ascending order with their kind tags
+    template <class F> void forEach(BYTE kinds, F f) const
+    {
+        for (auto &it: m_index)
+        {
+            if (it.second & kinds)
+                f(it.first, it.second);
+        }
+    }
+
+    size_t size() const { return m_index.size(); }
+    BOOL wasRebuilt() const { return m_rebuilt; }
+
+    // RttiStore or NK_* kind tag for a name, zero if not one we index
+    static BYTE kindFromName(LPCSTR name);
+
+    virtual ssize_t idaapi on_event(ssize_t code, va_list va);
+
+private:
+    enum STATE
+    {
+        IS_UNLOADED,  // Not looked at yet for this database
+        IS_LOADED,    // Current and tracking events
+        IS_ABSENT     // No valid saved index, rebuilt on the next run
+    };
+
+    BOOL load();
+    void save();
+    void discard();
+    BOOL rebuild();
+    void ensureLoaded();
+
+    std::map<ea_t, BYTE> m_index;
+    STATE m_state = IS_UNLOADED;
+    BOOL m_hooked = FALSE;
+    BOOL m_rebuilt = FALSE;
+};
+
+extern RttiNameIndex g_rttiNameIndex;
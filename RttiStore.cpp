@@ -0,0 +1,340 @@
+// Unified RTTI object store
+#include "stdafx.h"
+#include "Main.h"
+#include "RttiStore.h"
+#include <algorithm>
+
+// Pending inserts are merged into the sorted arrays when the list grows past this, or past this fraction of the
+// sorted rows so the merges stay amortized O(1) per insert as the store grows. The scans insert in address order,
+// which keeps a long pending list cheap to add to.
+static const size_t PENDING_LIMIT = 4096;
+static const size_t PENDING_FRACTION = 16;
+
+RttiStore g_rttiStore;
+
+
+// Branch free Eytzinger lower bound search.
+// Returns the sorted row index of the first address >= 'ea', or the row count if none.
+size_t RttiStore::lowerBound(ea_t ea) const
+{
+    size_t n = m_eytz.size();
+    size_t k = 1;
+    while (k < n)
+        k = ((k << 1) + (size_t) (m_eytz[k] < ea));
+
+    // Undo the trailing right turns plus the last left one to get to the answer node
+    unsigned long bit;
+    _BitScanForward64(&bit, ~(UINT64) k);
+    k >>= (bit + 1);
+    return(k ? (size_t) m_eytzRow[k] : m_ea.size());
+}
+
+// Row index of address in the sorted arrays, or NOT_FOUND
+size_t RttiStore::findRow(ea_t ea) const
+{
+    size_t row = lowerBound(ea);
+    if ((row < m_ea.size()) && (m_ea[row] == ea))
+        return row;
+    return NOT_FOUND;
+}
+
+// Index of address in the pending list, or NOT_FOUND
+size_t RttiStore::findPending(ea_t ea) const
+{
+    if (!m_pending.empty())
+    {
+        auto it = std::lower_bound(m_pending.begin(), m_pending.end(), ea, [](const ROW &r, ea_t ea) { return r.ea < ea; });
+        if ((it != m_pending.end()) && (it->ea == ea))
+            return (size_t) (it - m_pending.begin());
+    }
+    return NOT_FOUND;
+}
+
+
+void RttiStore::insert(ea_t ea, BYTE kind, UINT32 size, UINT32 attributes)
+{
+    // Already in the sorted arrays? Just update it in place
+    size_t row = findRow(ea);
+    if (row != NOT_FOUND)
+    {
+        m_kind[row] |= kind;
+        if (size > m_size[row])
+            m_size[row] = size;
+        if (attributes)
+            m_attributes[row] = attributes;
+        return;
+    }
+
+    auto it = std::lower_bound(m_pending.begin(), m_pending.end(), ea, [](const ROW &r, ea_t ea) { return r.ea < ea; });
+    if ((it != m_pending.end()) && (it->ea == ea))
+    {
+        it->kind |= kind;
+        if (size > it->size)
+            it->size = size;
+        if (attributes)
+            it->attributes = attributes;
+    }
+    else
+    {
+        m_pending.insert(it, { ea, size, attributes, kind });
+        if (m_pending.size() >= std::max(PENDING_LIMIT, (m_ea.size() / PENDING_FRACTION)))
+            commit();
+    }
+}
+
+BYTE RttiStore::getKind(ea_t ea) const
+{
+    size_t row = findRow(ea);
+    if (row != NOT_FOUND)
+        return m_kind[row];
+
+    row = findPending(ea);
+    if (row != NOT_FOUND)
+        return m_pending[row].kind;
+    return 0;
+}
+
+BOOL RttiStore::findCovering(ea_t ea, __out ea_t &start, __out UINT32 &size, BYTE kinds) const
+{
+    // Nearest object at or below the address from both the sorted arrays and the pending list
+    BOOL found = FALSE;
+    ea_t bestStart = 0;
+    UINT32 bestSize = 0;
+    BYTE bestKind = 0;
+
+    size_t row = lowerBound(ea);
+    if ((row < m_ea.size()) && (m_ea[row] == ea))
+    {
+        bestStart = m_ea[row], bestSize = m_size[row], bestKind = m_kind[row];
+        found = TRUE;
+    }
+    else
+    if (row > 0)
+    {
+        --row;
+        bestStart = m_ea[row], bestSize = m_size[row], bestKind = m_kind[row];
+        found = TRUE;
+    }
+
+    if (!m_pending.empty())
+    {
+        auto it = std::upper_bound(m_pending.begin(), m_pending.end(), ea, [](ea_t ea, const ROW &r) { return ea < r.ea; });
+        if (it != m_pending.begin())
+        {
+            --it;
+            if (!found || (it->ea > bestStart))
+            {
+                bestStart = it->ea, bestSize = it->size, bestKind = it->kind;
+                found = TRUE;
+            }
+        }
+    }
+
+    // Zero sized objects only cover their own address
+    if (found && (bestKind & kinds) && (ea < (bestStart + (bestSize ? bestSize : 1))))
+    {
+        start = bestStart;
+        size = bestSize;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+size_t RttiStore::count(BYTE kind) const
+{
+    size_t count = 0;
+    for (BYTE k: m_kind)
+    {
+        if (k & kind)
+            count++;
+    }
+    for (const ROW &r: m_pending)
+    {
+        if (r.kind & kind)
+            count++;
+    }
+    return count;
+}
+
+size_t RttiStore::memoryUsage() const
+{
+    return((m_ea.capacity() * sizeof(ea_t)) + m_kind.capacity() + (m_size.capacity() * sizeof(UINT32)) + (m_attributes.capacity() * sizeof(UINT32)) +
+           (m_eytz.capacity() * sizeof(ea_t)) + (m_eytzRow.capacity() * sizeof(UINT32)) + (m_pending.capacity() * sizeof(ROW)));
+}
+
+
+// In-order walk of the implicit tree to lay out the sorted addresses in Eytzinger order
+void RttiStore::buildEytzinger(size_t &i, size_t k)
+{
+    if (k < m_eytz.size())
+    {
+        buildEytzinger(i, (k << 1));
+        m_eytz[k] = m_ea[i];
+        m_eytzRow[k] = (UINT32) i;
+        i++;
+        buildEytzinger(i, ((k << 1) + 1));
+    }
+}
+
+void RttiStore::rebuildIndex()
+{
+    m_eytz.resize(m_ea.size() + 1);
+    m_eytzRow.resize(m_ea.size() + 1);
+    m_eytz[0] = BADADDR;
+    m_eytzRow[0] = 0;
+    size_t i = 0;
+    buildEytzinger(i, 1);
+}
+
+void RttiStore::commit()
+{
+    if (m_pending.empty())
+    {
+        if (m_eytz.size() != (m_ea.size() + 1))
+            rebuildIndex();
+        return;
+    }
+
+    // Merge the two sorted runs
+    size_t total = (m_ea.size() + m_pending.size());
+    std::vector<ea_t> ea;
+    std::vector<BYTE> kind;
+    std::vector<UINT32> size, attributes;
+    ea.reserve(total);
+    kind.reserve(total);
+    size.reserve(total);
+    attributes.reserve(total);
+
+    size_t i = 0, j = 0;
+    while ((i < m_ea.size()) || (j < m_pending.size()))
+    {
+        if ((j >= m_pending.size()) || ((i < m_ea.size()) && (m_ea[i] < m_pending[j].ea)))
+        {
+            ea.push_back(m_ea[i]);
+            kind.push_back(m_kind[i]);
+            size.push_back(m_size[i]);
+            attributes.push_back(m_attributes[i]);
+            i++;
+        }
+        else
+        {
+            const ROW &r = m_pending[j++];
+            ea.push_back(r.ea);
+            kind.push_back(r.kind);
+            size.push_back(r.size);
+            attributes.push_back(r.attributes);
+        }
+    }
+
+    m_ea.swap(ea);
+    m_kind.swap(kind);
+    m_size.swap(size);
+    m_attributes.swap(attributes);
+    m_pending.clear();
+    rebuildIndex();
+}
+
+void RttiStore::clear()
+{
+    m_ea.clear();
+    m_kind.clear();
+    m_size.clear();
+    m_attributes.clear();
+    m_eytz.clear();
+    m_eytzRow.clear();
+    m_pending.clear();
+}
+
+
+// ================================================================================================
+
+// Counts the bytes the std::set nodes take, not counting heap block overhead
+static size_t s_setBytes = 0;
+template <class T> struct CountingAllocator
+{
+    typedef T value_type;
+    CountingAllocator() = default;
+    template <class U> CountingAllocator(const CountingAllocator<U> &) {}
+    T *allocate(size_t n) { s_setBytes += (n * sizeof(T)); return (T *) malloc(n * sizeof(T)); }
+    void deallocate(T *p, size_t n) { s_setBytes -= (n * sizeof(T)); free(p); }
+    template <class U> bool operator==(const CountingAllocator<U> &) const { return true; }
+    template <class U> bool operator!=(const CountingAllocator<U> &) const { return false; }
+};
+typedef std::set<ea_t, std::less<ea_t>, CountingAllocator<ea_t>> countedSet;
+
+// Per kind set index of a single RK_* kind bit
+static UINT32 kindIndex(BYTE kind)
+{
+    UINT32 index = 0;
+    while ((kind >>= 1) != 0)
+        index++;
+    return index;
+}
+
+void RttiStore::benchmark()
+{
+    commit();
+    if (m_ea.empty())
+        return;
+
+    // Rebuild the former container layout: one set per kind plus the merged "super" set
+    s_setBytes = 0;
+    {
+        countedSet kindSets[RK_KIND_COUNT], superSet;
+        for (size_t i = 0; i < m_ea.size(); i++)
+        {
+            for (UINT32 k = 0; k < RK_KIND_COUNT; k++)
+            {
+                if (m_kind[i] & (1 << k))
+                    kindSets[k].insert(m_ea[i]);
+            }
+            superSet.insert(m_ea[i]);
+        }
+        size_t setBytes = s_setBytes;
+
+        // Probe list, half known addresses and half random ones in the same range
+        const UINT32 PROBES = 1000000;
+        std::vector<ea_t> probes(PROBES);
+        ea_t low = m_ea.front(), range = ((m_ea.back() - low) + 1);
+        UINT64 seed = 0x9E3779B97F4A7C15;
+        for (UINT32 i = 0; i < PROBES; i++)
+        {
+            seed ^= (seed << 13); seed ^= (seed >> 7); seed ^= (seed << 17);
+            if (i & 1)
+                probes[i] = m_ea[seed % m_ea.size()];
+            else
+                probes[i] = (low + (ea_t) (seed % range));
+        }
+
+        // Any kind lookups
+        size_t hits1 = 0, hits2 = 0;
+        TIMESTAMP startTime = GetTimeStamp();
+        for (ea_t ea: probes)
+            hits1 += (superSet.find(ea) != superSet.end());
+        TIMESTAMP setTime = (GetTimeStamp() - startTime);
+
+        startTime = GetTimeStamp();
+        for (ea_t ea: probes)
+            hits2 += contains(ea);
+        TIMESTAMP storeTime = (GetTimeStamp() - startTime);
+
+        // COL only lookups
+        const countedSet &colSet = kindSets[kindIndex(RK_COL)];
+        size_t hits3 = 0, hits4 = 0;
+        startTime = GetTimeStamp();
+        for (ea_t ea: probes)
+            hits3 += (colSet.find(ea) != colSet.end());
+        TIMESTAMP colSetTime = (GetTimeStamp() - startTime);
+
+        startTime = GetTimeStamp();
+        for (ea_t ea: probes)
+            hits4 += contains(ea, RK_COL);
+        TIMESTAMP colStoreTime = (GetTimeStamp() - startTime);
+
+        char buf1[32], buf2[32];
+        msg("RTTI store benchmark, %s objects, %s probes:\n", NumberCommaString(m_ea.size(), buf1), NumberCommaString(PROBES, buf2));
+        msg("  Memory: std::set %s, store %s\n", byteSizeString(setBytes), byteSizeString(memoryUsage()));
+        msg("  Any kind lookup: std::set %.1f ns, store %.1f ns (hits %u/%u)\n", ((setTime * 1e9) / PROBES), ((storeTime * 1e9) / PROBES), (UINT32) hits1, (UINT32) hits2);
+        msg("  COL lookup: std::set %.1f ns, store %.1f ns (hits %u/%u)\n", ((colSetTime * 1e9) / PROBES), ((colStoreTime * 1e9) / PROBES), (UINT32) hits3, (UINT32) hits4);
+    }
+}
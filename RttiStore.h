@@ -0,0 +1,89 @@
+// Unified RTTI object store
+#pragma once
+
+// Object kind tags. Bit flags since the same address can be known as more than one kind.
+const BYTE RK_TD  = (1 << 0); // type_info
+const BYTE RK_BCD = (1 << 1); // _RTTIBaseClassDescriptor
+const BYTE RK_CHD = (1 << 2); // _RTTIClassHierarchyDescriptor
+const BYTE RK_COL = (1 << 3); // _RTTICompleteObjectLocator
+const BYTE RK_VFT = (1 << 4); // `vftable'
+const BYTE RK_ANY = (RK_TD | RK_BCD | RK_CHD | RK_COL | RK_VFT);
+const UINT32 RK_KIND_COUNT = 5;
+
+// Address sorted structure-of-arrays store of every known RTTI object.
+// Lookups go through an Eytzinger (BFS) ordered copy of the addresses for a cache friendly, branch free
+// lower bound search. New objects found during a scan go to a small sorted pending list that gets merged in
+// on commit() or once it grows past a threshold.
+class RttiStore
+{
+public:
+    static const size_t NOT_FOUND = ((size_t) -1);
+
+    // Add an object, or add a kind tag to an already known address.
+    // Size is the object extent in bytes, attributes are the raw CHD/BCD attribute flags, etc.
+    void insert(ea_t ea, BYTE kind, UINT32 size = 0, UINT32 attributes = 0);
+
+    // Return TRUE if address is a known object of any of the given kinds
+    BOOL contains(ea_t ea, BYTE kinds = RK_ANY) const { return((getKind(ea) & kinds) != 0); }
+
+    // Kind tags at address, zero if unknown
+    BYTE getKind(ea_t ea) const;
+
+    // Find the object whose extent covers the address. Returns TRUE and the object's start and size if found.
+    BOOL findCovering(ea_t ea, __out ea_t &start, __out UINT32 &size, BYTE kinds = RK_ANY) const;
+
+    // Iterate the addresses of a kind in ascending order
+    template <class F> void forEach(BYTE kind, F f)
+    {
+        commit();
+        size_t count = m_ea.size();
+        for (size_t i = 0; i < count; i++)
+        {
+            if (m_kind[i] & kind)
+                f(m_ea[i], m_size[i], m_attributes[i]);
+        }
+    }
+
+    // Number of objects of a kind
+    size_t count(BYTE kind) const;
+    size_t size() const { return(m_ea.size() + m_pending.size()); }
+
+    // Bytes used by the store's arrays
+    size_t memoryUsage() const;
+
+    // Merge pending objects in and rebuild the search index
+    void commit();
+    void clear();
+
+    // Time and memory comparison against the former per kind std::set<ea_t> containers
+    void benchmark();
+
+private:
+    struct ROW
+    {
+        ea_t ea;
+        UINT32 size, attributes;
+        BYTE kind;
+    };
+
+    size_t lowerBound(ea_t ea) const;
+    size_t findRow(ea_t ea) const;
+    size_t findPending(ea_t ea) const;
+    void rebuildIndex();
+    void buildEytzinger(size_t &i, size_t k);
+
+    // Sorted by address columns
+    std::vector<ea_t>   m_ea;
+    std::vector<BYTE>   m_kind;
+    std::vector<UINT32> m_size;
+    std::vector<UINT32> m_attributes;
+
+    // One based Eytzinger layout of 'm_ea' and the matching row indexes
+    std::vector<ea_t>   m_eytz;
+    std::vector<UINT32> m_eytzRow;
+
+    // Recent inserts, sorted by address
+    std::vector<ROW> m_pending;
+};
+
+extern RttiStore g_rttiStore;
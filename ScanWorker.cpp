@@ -0,0 +1,548 @@
+// Background RTTI scan
+#include "stdafx.h"
+#include "Main.h"
+#include "RTTI.h"
+#include "ScanWorker.h"
+#include <algorithm>
+
+// Batch send thresholds. A batch goes when it's full, at a segment end, or when the last one is this old so the
+// main thread shows progress. The worker waits while 'MAX_IN_FLIGHT' batches are queued so the main thread is never
+// more than a couple of short batches behind, which keeps the UI responsive.
+static const size_t BATCH_SIZE = 128;
+static const TIMESTAMP BATCH_TIME = (TIMESTAMP) 0.25;
+static const UINT32 MAX_IN_FLIGHT = 2;
+
+// Segment bytes are read in chunks of this size, a multiple of 8 so each chunk's mask starts on a byte
+static const size_t SNAPSHOT_CHUNK = (1024 * 1024);
+
+// Copy the segments. A lone segment is both code and data like in the segment cache.
+void ImageSnapshot::take()
+{
+    clear();
+    std::vector<BYTE> buffer;
+    int count = get_segm_qty();
+    for (int i = 0; i < count; i++)
+    {
+        segment_t *seg = getnseg(i);
+        if (!seg || (seg->end_ea <= seg->start_ea))
+            continue;
+
+        REGION region;
+        region.start = seg->start_ea;
+        region.end = seg->end_ea;
+        if (count == 1)
+            region.type = (_CODE_SEG | _DATA_SEG);
+        else
+        if (seg->type == SEG_CODE)
+            region.type = _CODE_SEG;
+        else
+            region.type = ((seg->type == SEG_DATA) ? _DATA_SEG : 0);
+
+        size_t size = (size_t) (region.end - region.start);
+        BOOL maskOnly = (region.type == _CODE_SEG);
+        region.mask.resize(((size + 7) / 8), 0);
+        if (maskOnly)
+            buffer.resize(SNAPSHOT_CHUNK);
+        else
+            region.bytes.resize(size);
+
+        for (size_t offset = 0; offset < size; offset += SNAPSHOT_CHUNK)
+        {
+            size_t length = std::min(SNAPSHOT_CHUNK, (size - offset));
+            BYTE *bytes = (maskOnly ? buffer.data() : &region.bytes[offset]);
+            get_bytes(bytes, length, (region.start + (ea_t) offset), GMB_READALL, &region.mask[offset / 8]);
+        }
+        m_regions.push_back(std::move(region));
+    }
+
+    std::sort(m_regions.begin(), m_regions.end(), [](const REGION &a, const REGION &b) { return(a.start < b.start); });
+}
+
+size_t ImageSnapshot::memoryUsage() const
+{
+    size_t size = 0;
+    for (const REGION &region: m_regions)
+        size += (region.bytes.capacity() + region.mask.capacity());
+    return size;
+}
+
+const ImageSnapshot::REGION *ImageSnapshot::find(ea_t ea) const
+{
+    auto it = std::upper_bound(m_regions.begin(), m_regions.end(), ea, [](ea_t ea, const REGION &r) { return(ea < r.start); });
+    if (it != m_regions.begin())
+    {
+        const REGION *region = &*(--it);
+        if (ea < region->end)
+            return region;
+    }
+    return NULL;
+}
+
+BOOL ImageSnapshot::isLoaded(ea_t ea) const
+{
+    if (const REGION *region = find(ea))
+    {
+        size_t offset = (size_t) (ea - region->start);
+        return((region->mask[offset / 8] & (1 << (offset & 7))) != 0);
+    }
+    return FALSE;
+}
+
+BOOL ImageSnapshot::isCode(ea_t ea) const
+{
+    const REGION *region = find(ea);
+    return(region && (region->type & _CODE_SEG));
+}
+
+BOOL ImageSnapshot::read(ea_t ea, __out_bcount(size) PVOID buffer, UINT32 size) const
+{
+    const REGION *region = find(ea);
+    if (region && !region->bytes.empty() && ((region->end - ea) >= size))
+    {
+        memcpy(buffer, &region->bytes[(size_t) (ea - region->start)], size);
+        return TRUE;
+    }
+    memset(buffer, 0xFF, size);
+    return FALSE;
+}
+
+UINT32 ImageSnapshot::get32(ea_t ea) const
+{
+    UINT32 value;
+    read(ea, &value, sizeof(value));
+    return value;
+}
+
+UINT64 ImageSnapshot::get64(ea_t ea) const
+{
+    UINT64 value;
+    read(ea, &value, sizeof(value));
+    return value;
+}
+
+// Like get_max_strlit_length() with STRTYPE_C, the loaded bytes up to the terminator
+int ImageSnapshot::getString(ea_t ea, __out LPSTR buffer, int bufferSize) const
+{
+    buffer[0] = 0;
+    const REGION *region = find(ea);
+    if (!region || region->bytes.empty())
+        return 0;
+
+    size_t offset = (size_t) (ea - region->start);
+    size_t size = region->bytes.size();
+    int len = 0;
+    for (; (len < (bufferSize - 1)) && ((offset + len) < size); len++)
+    {
+        size_t i = (offset + len);
+        if (!(region->mask[i / 8] & (1 << (i & 7))) || !region->bytes[i])
+            break;
+        buffer[len] = (char) region->bytes[i];
+    }
+    buffer[len] = 0;
+    return len;
+}
+
+
+// ================================================================================================
+
+// The RTTI structure checks of RTTI.cpp over the snapshot
+template <class W> class ScanWorker::Validator
+{
+public:
+    Validator(const ImageSnapshot &image, const RttiStore &known) : m_image(image), m_known(known) {}
+
+    ea_t getEa(ea_t ea) const
+    {
+        if constexpr (W::is64)
+            return (ea_t) m_image.get64(ea);
+        else
+            return (ea_t) m_image.get32(ea);
+    }
+
+    ea_t getRef(ea_t ref, INT64 colBase) const
+    {
+        if constexpr (W::is64)
+            return (ea_t) (colBase + (INT32) m_image.get32(ref));
+        else
+            return (ea_t) m_image.get32(ref);
+    }
+
+    INT64 getColBase(ea_t col) const
+    {
+        if constexpr (W::is64)
+            return ((INT64) col - (INT32) m_image.get32(col + offsetof(RTTI::_RTTICompleteObjectLocator_64, objectBase)));
+        else
+            return 0;
+    }
+
+    BOOL getVerify32(ea_t ea, __out UINT32 &value) const
+    {
+        if (m_image.isLoaded(ea))
+        {
+            value = m_image.get32(ea);
+            return TRUE;
+        }
+        return FALSE;
+    }
+
+    BOOL isTypeName(ea_t name) const
+    {
+        char buffer[MAXSTR];
+        if (m_image.getString(name, buffer, SIZESTR(buffer)) && (buffer[0] == '.'))
+        {
+            // The CRT undecorator serializes calls with it's own lock, so it's safe to use from the worker
+            if (LPSTR s = __unDName(NULL, buffer+1 /*skip the '.'*/, 0, mallocWrap, free, (UNDNAME_32_BIT_DECODE | UNDNAME_TYPE_ONLY)))
+            {
+                free(s);
+                return TRUE;
+            }
+        }
+        return FALSE;
+    }
+
+    BOOL isTd(ea_t typeInfo) const
+    {
+        if (m_known.contains(typeInfo, RK_TD))
+            return TRUE;
+
+        typedef typename W::td_t TD;
+        if (m_image.isLoaded(typeInfo) && m_image.isLoaded(getEa(typeInfo + offsetof(TD, vfptr))))
+        {
+            // _M_data should be NULL statically
+            if (m_image.isLoaded(typeInfo + offsetof(TD, _M_data)) && (getEa(typeInfo + offsetof(TD, _M_data)) == 0))
+                return isTypeName(typeInfo + offsetof(TD, _M_d_name));
+        }
+        return FALSE;
+    }
+
+    BOOL isBcd(ea_t bcd, INT64 colBase64) const
+    {
+        if (m_known.contains(bcd, RK_BCD))
+            return TRUE;
+
+        // Valid flags are the lower byte only
+        UINT32 attributes;
+        if (getVerify32((bcd + offsetof(RTTI::_RTTIBaseClassDescriptor, attributes)), attributes) && !(attributes & 0xFFFFFF00))
+            return isTd(getRef((bcd + offsetof(RTTI::_RTTIBaseClassDescriptor, typeDescriptor)), colBase64));
+        return FALSE;
+    }
+
+    BOOL isChd(ea_t chd, INT64 colBase64) const
+    {
+        if (m_known.contains(chd, RK_CHD))
+            return TRUE;
+
+        // Zero signature, the lower nibble attribute flags, and at least one base class
+        UINT32 signature, attributes, numBaseClasses;
+        if (getVerify32((chd + offsetof(RTTI::_RTTIClassHierarchyDescriptor, signature)), signature) && (signature == 0) &&
+            getVerify32((chd + offsetof(RTTI::_RTTIClassHierarchyDescriptor, attributes)), attributes) && !(attributes & 0xFFFFFFF0) &&
+            getVerify32((chd + offsetof(RTTI::_RTTIClassHierarchyDescriptor, numBaseClasses)), numBaseClasses) && (numBaseClasses >= 1))
+        {
+            // Check the first BCD entry
+            ea_t baseClassArray = getRef((chd + offsetof(RTTI::_RTTIClassHierarchyDescriptor, baseClassArray)), colBase64);
+            if (m_image.isLoaded(baseClassArray))
+                return isBcd(getRef(baseClassArray, colBase64), colBase64);
+        }
+        return FALSE;
+    }
+
+    BOOL isCol(ea_t col) const
+    {
+        if (m_known.contains(col, RK_COL))
+            return TRUE;
+
+        typedef typename W::col_t COL;
+        UINT32 signature;
+        if (getVerify32((col + offsetof(COL, signature)), signature) && (signature == W::colSignature))
+        {
+            if constexpr (W::is64)
+            {
+                if (!m_image.get32(col + offsetof(COL, objectBase)) || !m_image.get32(col + offsetof(COL, typeDescriptor)) || !m_image.get32(col + offsetof(COL, classDescriptor)))
+                    return FALSE;
+            }
+
+            INT64 colBase64 = getColBase(col);
+            if (isTd(getRef((col + offsetof(COL, typeDescriptor)), colBase64)))
+                return isChd(getRef((col + offsetof(COL, classDescriptor)), colBase64), colBase64);
+        }
+        return FALSE;
+    }
+
+    // 32bit COL from an already validated type_info perspective
+    BOOL isCol2(ea_t col) const
+    {
+        if (m_known.contains(col, RK_COL))
+            return TRUE;
+
+        UINT32 signature;
+        if (getVerify32((col + offsetof(RTTI::_RTTICompleteObjectLocator_32, signature)), signature) && (signature == 0))
+        {
+            ea_t classDescriptor = getEa(col + offsetof(RTTI::_RTTICompleteObjectLocator_32, classDescriptor));
+            if (classDescriptor && (classDescriptor != BADADDR))
+                return isChd(classDescriptor, 0);
+        }
+        return FALSE;
+    }
+
+private:
+    const ImageSnapshot &m_image;
+    const RttiStore &m_known;
+};
+
+
+// ================================================================================================
+
+// A batch of items for the main thread
+class ScanWorker::BatchRequest: public exec_request_t
+{
+public:
+    BatchRequest(ScanWorker *worker, std::vector<ITEM> &items) : m_worker(worker), m_generation(worker->m_generation) { m_items.swap(items); }
+
+    virtual ssize_t idaapi execute()
+    {
+        // From a canceled scan?
+        if (m_worker->m_generation != m_generation)
+            return 0;
+
+        {
+            std::lock_guard<std::mutex> lock(m_worker->m_requestLock);
+            auto &requests = m_worker->m_requests;
+            requests.erase(std::remove(requests.begin(), requests.end(), m_id), requests.end());
+        }
+        m_worker->m_inFlight--;
+        m_worker->m_apply(m_items);
+        return 0;
+    }
+
+    int m_id = 0;
+
+private:
+    ScanWorker *m_worker;
+    UINT32 m_generation;
+    std::vector<ITEM> m_items;
+};
+
+BOOL ScanWorker::start(const std::vector<RANGE> &segs, BOOL is64, APPLY apply)
+{
+    cancel();
+
+    TIMESTAMP startTime = GetTimeStamp();
+    m_image.take();
+    g_rttiStore.commit();
+    m_known = g_rttiStore;
+    m_segs = segs;
+    m_is64 = is64;
+    m_apply = apply;
+    m_batch.clear();
+    m_lastSend = GetTimeStamp();
+    m_cancel = FALSE;
+    m_inFlight = 0;
+
+    msg("Image snapshot: %s in %s.\n", byteSizeString(m_image.memoryUsage()), TimeString(GetTimeStamp() - startTime));
+
+    if (!(m_thread = qthread_create(threadProc, this)))
+    {
+        m_image.clear();
+        m_known.clear();
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void ScanWorker::cancel()
+{
+    if (!m_thread)
+        return;
+
+    m_cancel = TRUE;
+    qthread_join(m_thread);
+    qthread_free(m_thread);
+    m_thread = NULL;
+
+    // Drop the batches still queued
+    for (int id: m_requests)
+        cancel_exec_request(id);
+    m_requests.clear();
+    finish();
+}
+
+void ScanWorker::finish()
+{
+    if (m_thread)
+    {
+        qthread_join(m_thread);
+        qthread_free(m_thread);
+        m_thread = NULL;
+    }
+
+    m_generation++;
+    m_image.clear();
+    m_known.clear();
+    m_segs.clear();
+    m_batch.clear();
+}
+
+int idaapi ScanWorker::threadProc(PVOID ud)
+{
+    ScanWorker *worker = (ScanWorker *) ud;
+    if (worker->m_is64)
+        worker->scan<RTTI::PTR64>();
+    else
+        worker->scan<RTTI::PTR32>();
+    return 0;
+}
+
+// Queue an item, sending the batch when it's due
+void ScanWorker::send(ea_t ea, ea_t col, UINT32 count, BYTE kind)
+{
+    m_batch.push_back({ ea, col, count, kind });
+    if ((m_batch.size() >= BATCH_SIZE) || (kind == SI_SEGMENT_END) || ((GetTimeStamp() - m_lastSend) >= BATCH_TIME))
+        flush();
+}
+
+// Send the batch to the main thread. Returns FALSE if canceled while waiting for it to catch up.
+BOOL ScanWorker::flush()
+{
+    if (m_batch.empty())
+        return TRUE;
+
+    while (m_inFlight.load() >= MAX_IN_FLIGHT)
+    {
+        if (isCanceled())
+            return FALSE;
+        qsleep(5);
+    }
+
+    // Queued without waiting, the kernel frees the request once it's executed or canceled.
+    // The lock keeps the request from running before its ID is recorded.
+    BatchRequest *request = new BatchRequest(this, m_batch);
+    m_inFlight++;
+    {
+        std::lock_guard<std::mutex> lock(m_requestLock);
+        request->m_id = execute_sync(*request, (MFF_WRITE | MFF_NOWAIT));
+        m_requests.push_back(request->m_id);
+    }
+    m_lastSend = GetTimeStamp();
+    return TRUE;
+}
+
+template <class W> void ScanWorker::scan()
+{
+    try
+    {
+        for (const RANGE &seg: m_segs)
+        {
+            if (scanCols<W>(seg))
+                return;
+        }
+        m_known.commit();
+        send(0, 0, SP_COLS, SI_PHASE_END);
+
+        for (const RANGE &seg: m_segs)
+        {
+            if (scanVftables<W>(seg))
+                return;
+        }
+        send(0, 0, SP_VFTABLES, SI_PHASE_END);
+    }
+    CATCH()
+
+    // Always ends with done so the main thread wraps up the scan
+    if (!isCanceled())
+    {
+        m_batch.push_back({ 0, 0, 0, SI_DONE });
+        flush();
+    }
+}
+
+// Scan segment for COLs. Returns TRUE if canceled.
+template <class W> BOOL ScanWorker::scanCols(const RANGE &seg)
+{
+    typedef typename W::col_t COL;
+    Validator<W> validator(m_image, m_known);
+    UINT32 existingCount = 0;
+    send(seg.start, seg.end, SP_COLS, SI_SEGMENT);
+
+    if ((seg.end - seg.start) >= sizeof(COL))
+    {
+        ea_t startEA = ((seg.start + W::ptrSize) & ~((ea_t) W::ptrSize - 1));
+        ea_t endEA   = (seg.end - sizeof(COL));
+
+        for (ea_t ptr = startEA; ptr < endEA;)
+        {
+            // Skip over already known RTTI objects
+            ea_t objStart;
+            UINT32 objSize;
+            if (m_known.findCovering(ptr, objStart, objSize))
+            {
+                if ((objStart == ptr) && m_known.contains(ptr, RK_COL))
+                    existingCount++;
+
+                ea_t next = ((objStart + objSize + (W::ptrSize - 1)) & ~((ea_t) W::ptrSize - 1));
+                ptr = ((next > ptr) ? next : (ptr + (ea_t) W::ptrSize));
+                continue;
+            }
+
+            // 32bit from the type_info pointer, 64bit from the signature
+            ea_t col = BADADDR;
+            if constexpr (!W::is64)
+            {
+                if (validator.isTd(validator.getEa(ptr)) && validator.isCol2(ptr - offsetof(COL, typeDescriptor)))
+                    col = (ptr - offsetof(COL, typeDescriptor));
+            }
+            else
+            {
+                if ((m_image.get32(ptr + offsetof(COL, signature)) == W::colSignature) && validator.isCol(ptr))
+                    col = ptr;
+            }
+
+            if (col != BADADDR)
+            {
+                m_known.insert(col, RK_COL, sizeof(COL));
+                send(col, 0, 0, SI_COL);
+                ptr += sizeof(COL);
+                continue;
+            }
+
+            if (!(ptr & 0xFFFF) && isCanceled())
+                return TRUE;
+            ptr += (ea_t) W::ptrSize;
+        }
+    }
+
+    send(0, 0, existingCount, SI_SEGMENT_END);
+    return isCanceled();
+}
+
+// Scan segment for vftables, a COL pointer followed by a method pointer or a known vftable. Returns TRUE if canceled.
+template <class W> BOOL ScanWorker::scanVftables(const RANGE &seg)
+{
+    Validator<W> validator(m_image, m_known);
+    send(seg.start, seg.end, SP_VFTABLES, SI_SEGMENT);
+
+    if ((seg.end - seg.start) >= W::ptrSize)
+    {
+        ea_t startEA = ((seg.start + W::ptrSize) & ~((ea_t) W::ptrSize - 1));
+        ea_t endEA   = (seg.end - W::ptrSize);
+
+        for (ea_t ptr = startEA; ptr < endEA; ptr += (ea_t) W::ptrSize)
+        {
+            ea_t colEa = validator.getEa(ptr);
+            if (m_known.contains(colEa, RK_COL))
+            {
+                ea_t vfptr = (ptr + (ea_t) W::ptrSize);
+                if (m_known.contains(vfptr, RK_VFT))
+                    send(vfptr, colEa, TRUE, SI_VFTABLE);
+                else
+                if (m_image.isCode(validator.getEa(vfptr)))
+                    send(vfptr, colEa, FALSE, SI_VFTABLE);
+            }
+
+            if (!(ptr & 0xFFFF) && isCanceled())
+                return TRUE;
+        }
+    }
+
+    send(0, 0, 0, SI_SEGMENT_END);
+    return isCanceled();
+}
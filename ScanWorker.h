@@ -0,0 +1,116 @@
+// Background RTTI scan
+#pragma once
+#include "RttiStore.h"
+#include <atomic>
+#include <mutex>
+
+// Read only copy of the IDB segment bytes for the scan worker, taken on the main thread since the IDA API is not
+// thread safe. Bytes read as IDA's get_bytes(GMB_READALL) would return them. Code segments keep just their loaded
+// byte mask as the scan only needs to know that a pointer goes to code.
+class ImageSnapshot
+{
+public:
+    void take();
+    void clear() { m_regions.clear(); }
+    size_t memoryUsage() const;
+
+    BOOL isLoaded(ea_t ea) const;
+    BOOL isCode(ea_t ea) const;
+
+    // Value at address, all bits set like IDA for bytes not in the snapshot
+    UINT32 get32(ea_t ea) const;
+    UINT64 get64(ea_t ea) const;
+
+    // Copy of the C string at address. Returns it's length, zero if there is none.
+    int getString(ea_t ea, __out LPSTR buffer, int bufferSize) const;
+
+private:
+    struct REGION
+    {
+        ea_t start, end;
+        UINT32 type;                // _CODE_SEG, _DATA_SEG
+        std::vector<BYTE> bytes;    // Empty for code segments
+        std::vector<BYTE> mask;     // Loaded bit per byte
+    };
+    const REGION *find(ea_t ea) const;
+    BOOL read(ea_t ea, __out_bcount(size) PVOID buffer, UINT32 size) const;
+
+    std::vector<REGION> m_regions;  // Sorted by address
+};
+
+// Scans the segments for COLs, then for the vftables that use them, on a worker thread.
+// The found candidates go to the main thread in batches with execute_sync() to be placed and named there, so the
+// user can keep working in the IDB while the scan runs.
+class ScanWorker
+{
+public:
+    // Scan phases
+    enum: UINT32
+    {
+        SP_COLS,
+        SP_VFTABLES
+    };
+
+    // Items sent to the main thread
+    enum: BYTE
+    {
+        SI_SEGMENT,         // Phase segment start, 'ea' to 'col' is the segment range
+        SI_SEGMENT_END,     // 'count' is the already known COLs skipped in the segment
+        SI_COL,             // COL at 'ea'
+        SI_VFTABLE,         // Vftable candidate at 'ea' of the COL, 'count' is TRUE if already known
+        SI_PHASE_END,       // 'count' is the phase
+        SI_DONE
+    };
+    struct ITEM
+    {
+        ea_t ea, col;
+        UINT32 count;
+        BYTE kind;
+    };
+    typedef void (*APPLY)(const std::vector<ITEM> &items);
+
+    struct RANGE
+    {
+        ea_t start, end;
+    };
+
+    ~ScanWorker() { cancel(); }
+
+    // Start scanning the segment ranges. Main thread only.
+    // The known RTTI objects are copied from 'g_rttiStore', and 'apply' is called on the main thread with each batch.
+    BOOL start(const std::vector<RANGE> &segs, BOOL is64, APPLY apply);
+
+    // Stop the worker and drop the batches not applied yet. Main thread only.
+    void cancel();
+
+    // Join the worker once the SI_DONE item has been applied
+    void finish();
+
+    BOOL isRunning() const { return(m_thread != NULL); }
+
+private:
+    class BatchRequest;
+    template <class W> class Validator;
+
+    static int idaapi threadProc(PVOID ud);
+    template <class W> void scan();
+    template <class W> BOOL scanCols(const RANGE &seg);
+    template <class W> BOOL scanVftables(const RANGE &seg);
+    void send(ea_t ea, ea_t col, UINT32 count, BYTE kind);
+    BOOL flush();
+    BOOL isCanceled() const { return(m_cancel.load(std::memory_order_relaxed)); }
+
+    ImageSnapshot m_image;
+    RttiStore m_known;              // Worker copy, plus the COLs it finds
+    std::vector<RANGE> m_segs;
+    std::vector<ITEM> m_batch;
+    TIMESTAMP m_lastSend = 0;
+    APPLY m_apply = NULL;
+    qthread_t m_thread = NULL;
+    UINT32 m_generation = 0;        // Batches of a canceled scan are ignored
+    std::mutex m_requestLock;
+    std::vector<int> m_requests;    // Queued batch request IDs
+    BOOL m_is64 = FALSE;
+    std::atomic<BOOL> m_cancel { FALSE };
+    std::atomic<UINT32> m_inFlight { 0 };
+};
@@ -30,6 +30,8 @@
 #include <typeinf.hpp>
 #include <nalt.hpp>
 #include <demangle.hpp>
+#include <ua.hpp>
+#include <allins.hpp>
 #pragma warning(pop)
 
 // Qt SDK
@@ -8,13 +8,13 @@
 
 // Attempt to get information of and fix vftable at address.
 // Return TRUE along with info if valid vftable parsed at address
-BOOL vftable::getTableInfo(ea_t ea, vtinfo &info)
+template <class W> BOOL vftable::getTableInfo(ea_t ea, vtinfo &info)
 {
 	// Start of a vft should have an xref and a name (auto, or user, etc).
     // Ideal flags 32bit: FF_DWRD, FF_0OFF, FF_REF, FF_NAME, FF_DATA, FF_IVL
     //dumpFlags(ea);
     flags_t flags = get_flags(ea);
-	if(has_xref(flags) && has_any_name(flags) && (plat.isEa(flags) || is_unknown(flags)))
+	if(has_xref(flags) && has_any_name(flags) && (W::isEa(flags) || is_unknown(flags)))
     {
 		ZeroMemory(&info, sizeof(info));
 
@@ -31,19 +31,19 @@ BOOL vftable::getTableInfo(ea_t ea, vtinfo &info)
             // Ideal flags for 32bit: FF_DWRD, FF_0OFF, FF_REF, FF_NAME, FF_DATA, FF_IVL
             //dumpFlags(ea);
             flags_t indexFlags = get_flags(ea);
-            if (!(plat.isEa(indexFlags) || is_unknown(indexFlags)))
+            if (!(W::isEa(indexFlags) || is_unknown(indexFlags)))
             {
                 //msg(" ******* 1\n");
                 break;
             }
 
             // Look at what this (assumed vftable index) points too
-            ea_t memberPtr = plat.getEa(ea);
+            ea_t memberPtr = W::getEa(ea);
             if (!(memberPtr && (memberPtr != BADADDR)))
             {
                 // vft's some times have a trailing zero pointer (alignment, or?), fix it
                 if (memberPtr == 0)
-                    fixEa(ea);
+                    fixEa<W>(ea);
 
                 //msg(" ******* 2\n");
                 break;
@@ -80,7 +80,7 @@ BOOL vftable::getTableInfo(ea_t ea, vtinfo &info)
                 }
 
                 // If we see a COL here it must be the start of another vftable
-                if (RTTI::_RTTICompleteObjectLocator::isValid(memberPtr))
+                if (RTTI::_RTTICompleteObjectLocator::isValid<W>(memberPtr))
                 {
                     //msg(" ******* 5\n");
                     break;
@@ -88,13 +88,13 @@ BOOL vftable::getTableInfo(ea_t ea, vtinfo &info)
             }
 
             // As needed fix ea_t pointer, and, or, missing code and function def here
-            fixEa(ea);
+            fixEa<W>(ea);
             fixFunction(memberPtr);
-            ea += (ea_t) plat.ptrSize;
+            ea += (ea_t) W::ptrSize;
         };
 
         // Reached the presumed end of it
-        if ((info.methodCount = ((ea - start) / plat.ptrSize)) > 0)
+        if ((info.methodCount = ((ea - start) / W::ptrSize)) > 0)
         {
             info.end = ea;
             //msg(" vftable: %llX-%llX, methods: %d\n", rtInfo.eaStart, rtInfo.eaEnd, rtInfo.uMethods);
@@ -105,3 +105,7 @@ BOOL vftable::getTableInfo(ea_t ea, vtinfo &info)
     //dumpFlags(ea);
     return FALSE;
 }
+
+// Pointer width instantiations
+template BOOL vftable::getTableInfo<RTTI::PTR32>(ea_t ea, vtinfo &info);
+template BOOL vftable::getTableInfo<RTTI::PTR64>(ea_t ea, vtinfo &info);
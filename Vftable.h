@@ -11,7 +11,7 @@ namespace vftable
 		int  methodCount;
 		//char name[MAXSTR];
 	};
-	BOOL getTableInfo(ea_t ea, vtinfo &info);
+	template <class W> BOOL getTableInfo(ea_t ea, vtinfo &info);
 
 	// Returns TRUE if mangled name prefix indicates a vftable
 	inline BOOL isValid(LPCSTR name){ return(*((PDWORD) name) == 0x375F3F3F /*"??_7"*/); }
@@ -0,0 +1,48 @@
+// Class Informer RTTI type definitions, 32bit
+// Built into "classinformer32.til" by tilib, or parsed directly when the library isn't available.
+// Pointer sizes are explicit so the definitions don't depend on the compiler model they are parsed with.
+
+// RTTI std::type_info class (#classinformer)
+struct type_info
+{
+    const void *__ptr32 vfptr;
+    void *__ptr32 _M_data;
+    char _M_d_name[];
+};
+
+// RTTI Base class descriptor displacement container (#classinformer)
+struct PMD
+{
+    int mdisp;
+    int pdisp;
+    int vdisp;
+};
+
+// RTTI Class Hierarchy Descriptor (#classinformer)
+struct _RTTIClassHierarchyDescriptor
+{
+    unsigned int signature;
+    unsigned int attributes;
+    unsigned int numBaseClasses;
+    void *__ptr32 baseClassArray; // _RTTIBaseClassArray*
+};
+
+// RTTI Base Class Descriptor (#classinformer)
+struct _RTTIBaseClassDescriptor
+{
+    int typeDescriptor;
+    unsigned int numContainedBases;
+    PMD pmd;
+    unsigned int attributes;
+    void *__ptr32 classDescriptor;  // _RTTIClassHierarchyDescriptor*
+};
+
+// RTTI Complete Object Locator (#classinformer)
+struct _RTTICompleteObjectLocator
+{
+    unsigned int signature;
+    unsigned int offset;
+    unsigned int cdOffset;
+    void *__ptr32 typeDescriptor;   // type_info*
+    void *__ptr32 classDescriptor;  // _RTTIClassHierarchyDescriptor*
+};
@@ -0,0 +1,49 @@
+// Class Informer RTTI type definitions, 64bit
+// Built into "classinformer64.til" by tilib, or parsed directly when the library isn't available.
+// References are signed 32bit offsets from the image base in 64bit RTTI, so only type_info has pointers.
+
+// RTTI std::type_info class (#classinformer)
+struct type_info
+{
+    const void *__ptr64 vfptr;
+    void *__ptr64 _M_data;
+    char _M_d_name[];
+};
+
+// RTTI Base class descriptor displacement container (#classinformer)
+struct PMD
+{
+    int mdisp;
+    int pdisp;
+    int vdisp;
+};
+
+// RTTI Class Hierarchy Descriptor (#classinformer)
+struct _RTTIClassHierarchyDescriptor
+{
+    unsigned int signature;
+    unsigned int attributes;
+    unsigned int numBaseClasses;
+    int baseClassArray;
+};
+
+// RTTI Base Class Descriptor (#classinformer)
+struct _RTTIBaseClassDescriptor
+{
+    int typeDescriptor;
+    unsigned int numContainedBases;
+    PMD pmd;
+    unsigned int attributes;
+    int classDescriptor;
+};
+
+// RTTI Complete Object Locator (#classinformer)
+struct _RTTICompleteObjectLocator
+{
+    unsigned int signature;
+    unsigned int offset;
+    unsigned int cdOffset;
+    int typeDescriptor;
+    int classDescriptor;
+    int objectBase;
+};
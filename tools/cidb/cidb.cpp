@@ -0,0 +1,170 @@
+// Class Informer class database query tool
+#include "ClassDb.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <ctime>
+#include <vector>
+#ifdef _WIN32
+#define strncasecmp _strnicmp
+#else
+#include <strings.h>
+#endif
+
+// Result table row flags, as in RTTI.h
+static const uint32_t CHD_MULTINH   = 0x01;
+static const uint32_t CHD_VIRTINH   = 0x02;
+static const uint32_t CHD_AMBIGUOUS = 0x04;
+static const uint32_t IS_TOP_LEVEL  = 0x8000;
+
+static void usage()
+{
+    fputs("Usage: cidb <database> <command> [argument]\n"
+          "  find <class>       Binaries with the class and its vftables\n"
+          "  classes <binary>   Classes of a binary, by file name or hash prefix\n"
+          "  binaries           Added binaries, newest first\n"
+          "  stats              Counts and hash index chain lengths\n", stderr);
+}
+
+static const char *flagText(uint32_t flags, char text[8])
+{
+    int pos = 0;
+    if (flags & CHD_MULTINH)   text[pos++] = 'M';
+    if (flags & CHD_VIRTINH)   text[pos++] = 'V';
+    if (flags & CHD_AMBIGUOUS) text[pos++] = 'A';
+    if (!(flags & IS_TOP_LEVEL)) text[pos++] = '-';
+    text[pos] = 0;
+    return text;
+}
+
+static const char *hashText(const uint8_t sha256[32], char text[65])
+{
+    for (int i = 0; i < 32; i++)
+        sprintf(&text[i * 2], "%02X", sha256[i]);
+    return text;
+}
+
+static const char *timeText(uint64_t timeStamp, char text[32])
+{
+    time_t t = (time_t) timeStamp;
+    if (struct tm *local = localtime(&t))
+        strftime(text, 32, "%Y-%m-%d %H:%M:%S", local);
+    else
+        strcpy(text, "?");
+    return text;
+}
+
+static int find(ClassDb &db, const char *className)
+{
+    auto start = std::chrono::steady_clock::now();
+    struct RESULT { const CDB_HIT *hit; const CDB_BINARY *bin; };
+    std::vector<RESULT> hits;
+    if (const CDB_NAME *name = db.findName(className))
+        db.forEachHit(name, [&](const CDB_HIT *hit, const CDB_BINARY *bin) { hits.push_back({ hit, bin }); });
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    char sha[65], flags[8];
+    for (const RESULT &result: hits)
+    {
+        printf("%.16s  %-32s  %016llX  %5u  %-4s\n", hashText(result.bin->sha256, sha), db.fileName(result.bin), (unsigned long long) result.hit->vft,
+               result.hit->methods, flagText(result.hit->flags, flags));
+    }
+    fprintf(stderr, "%zu vftables, lookup %.1f us\n", hits.size(), us);
+    return (hits.empty() ? 1 : 0);
+}
+
+static int classes(ClassDb &db, const char *key)
+{
+    const CDB_BINARY *found = NULL;
+    size_t keyLength = strlen(key);
+    db.forEachBinary([&](uint32_t, const CDB_BINARY *bin)
+    {
+        char sha[65];
+        if (!found && !(bin->flags & CDB_BF_REPLACED) &&
+            ((strcmp(db.fileName(bin), key) == 0) || ((keyLength >= 4) && (strncasecmp(hashText(bin->sha256, sha), key, keyLength) == 0))))
+            found = bin;
+    });
+    const CDB_RECORD *rec = (found ? db.records(found) : NULL);
+    if (!rec)
+    {
+        fprintf(stderr, "Binary \"%s\" not found\n", key);
+        return 1;
+    }
+
+    char flags[8];
+    for (uint32_t i = 0; i < found->recordCount; i++, rec++)
+    {
+        const CDB_NAME *name = db.name(rec->name);
+        printf("%016llX  %5u  %-4s  %s\n", (unsigned long long) rec->vft, rec->methods, flagText(rec->flags, flags), (name ? db.nameText(name) : ""));
+    }
+    return 0;
+}
+
+static int binaries(ClassDb &db)
+{
+    char sha[65], added[32];
+    db.forEachBinary([&](uint32_t, const CDB_BINARY *bin)
+    {
+        printf("%s  %s  %016llX  %6u  %s%s\n", hashText(bin->sha256, sha), timeText(bin->timeStamp, added), (unsigned long long) bin->imageBase,
+               bin->recordCount, db.fileName(bin), ((bin->flags & CDB_BF_REPLACED) ? "  (replaced)" : ""));
+    });
+    return 0;
+}
+
+static int stats(ClassDb &db)
+{
+    const CDB_HEADER *hdr = db.header();
+    printf("Binaries: %llu\nClass names: %llu\nVftables: %llu\nBytes used: %llu\n", (unsigned long long) hdr->binaryCount,
+           (unsigned long long) hdr->nameCount, (unsigned long long) hdr->recordCount, (unsigned long long) hdr->used);
+
+    // Bucket chain lengths, from the name records
+    const uint64_t *buckets = (const uint64_t *) (hdr + 1);
+    uint32_t used = 0, longest = 0;
+    for (uint32_t i = 0; i < hdr->bucketCount; i++)
+    {
+        uint32_t length = 0;
+        for (uint64_t offset = buckets[i]; const CDB_NAME *name = db.name(offset); offset = name->next)
+        {
+            length++;
+            if (name->next >= offset)
+                break;
+        }
+        used += (length != 0);
+        longest = std::max(longest, length);
+    }
+    printf("Index buckets: %u, %u used, longest chain %u\n", hdr->bucketCount, used, longest);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        usage();
+        return 2;
+    }
+
+    ClassDb db;
+    if (!db.open(argv[1], false))
+    {
+        fprintf(stderr, "%s: %s\n", argv[1], db.error().c_str());
+        return 2;
+    }
+
+    const char *command = argv[2];
+    if ((strcmp(command, "find") == 0) && (argc == 4))
+        return find(db, argv[3]);
+    else
+    if ((strcmp(command, "classes") == 0) && (argc == 4))
+        return classes(db, argv[3]);
+    else
+    if (strcmp(command, "binaries") == 0)
+        return binaries(db);
+    else
+    if (strcmp(command, "stats") == 0)
+        return stats(db);
+
+    usage();
+    return 2;
+}